@@ -0,0 +1,277 @@
+
+#include "BenchHarness.hpp"
+#include "src/Allocations.hpp"
+#include "src/Statistics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include <thread>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	float MillisecondsSince( const Clock::time_point& start )
+	{
+		const std::chrono::duration<float, std::milli> elapsed = Clock::now() - start;
+		return elapsed.count();
+	}
+}
+
+BenchHarness::BenchHarness( const BenchSettings& benchSettings )
+	: settings( benchSettings )
+{
+	// Before any benchmark starts threads, so theirs get counted too
+	if ( settings.perfCounters && !perfCounters.Open() )
+	{
+		std::cout << "BenchHarness: carrying on with timings only" << std::endl;
+	}
+}
+
+bool BenchHarness::IsSelected( const std::string& name ) const
+{
+	return settings.filter.empty() || name.find( settings.filter ) != std::string::npos;
+}
+
+void BenchHarness::Run( const std::string& name, const double& items, const std::function<void()>& work, const int& threads )
+{
+	if ( !IsSelected( name ) )
+	{
+		return;
+	}
+
+	BenchResult result;
+	result.name = name;
+	result.threads = threads;
+	result.items = items;
+
+	// The quickest warm-up call says how many calls it takes to fill a sample
+	float quickestMs = 0.0f;
+	for ( int i = 0; i < std::max( 1, settings.warmup ); i++ )
+	{
+		const auto start = Clock::now();
+		work();
+		const float elapsed = MillisecondsSince( start );
+		quickestMs = i == 0 ? elapsed : std::min( quickestMs, elapsed );
+	}
+
+	if ( quickestMs < settings.minSampleMs )
+	{
+		result.callsPerSample = int( std::ceil( settings.minSampleMs / std::max( quickestMs, 0.0001f ) ) );
+	}
+
+	result.samplesMs.reserve( settings.repetitions );
+	// Every thread's, the job system's workers do most of the work in some of these
+	const uint64_t allocationsAtStart = Allocations::GetCount();
+	// Around all of the samples, starting and stopping them is a few syscalls each
+	if ( perfCounters.IsOpen() )
+	{
+		perfCounters.Start();
+	}
+
+	for ( int i = 0; i < settings.repetitions; i++ )
+	{
+		const auto start = Clock::now();
+		for ( int call = 0; call < result.callsPerSample; call++ )
+		{
+			work();
+		}
+		result.samplesMs.push_back( MillisecondsSince( start ) / result.callsPerSample );
+	}
+
+	const double calls = double( settings.repetitions ) * result.callsPerSample;
+	if ( perfCounters.IsOpen() )
+	{
+		result.counters = perfCounters.Stop();
+		for ( double& value : result.counters.values )
+		{
+			value = value >= 0.0 ? value / calls : value;
+		}
+	}
+
+	if ( Allocations::Enabled )
+	{
+		// reserve above made sure the samples themselves don't count
+		result.allocations = double( Allocations::GetCount() - allocationsAtStart ) / calls;
+	}
+
+	Summarise( result );
+	Print( result );
+	results.push_back( std::move( result ) );
+}
+
+void BenchHarness::AddSamples( const std::string& name, const double& items, const std::vector<float>& samplesMs, const double& allocations )
+{
+	BenchResult result;
+	result.name = name;
+	result.items = items;
+	result.samplesMs = samplesMs;
+	result.allocations = allocations;
+
+	Summarise( result );
+	Print( result );
+	results.push_back( std::move( result ) );
+}
+
+void BenchHarness::Summarise( BenchResult& result ) const
+{
+	const size_t count = result.samplesMs.size();
+	if ( count == 0 )
+	{
+		return;
+	}
+
+	const double sum = std::accumulate( result.samplesMs.begin(), result.samplesMs.end(), 0.0 );
+	const double mean = sum / count;
+	double squares = 0.0;
+	for ( const float& sample : result.samplesMs )
+	{
+		squares += (sample - mean) * (sample - mean);
+	}
+
+	result.meanMs = float( mean );
+	// Sample standard deviation, there's rarely more than a few dozen of them
+	result.stddevMs = count > 1 ? float( std::sqrt( squares / (count - 1) ) ) : 0.0f;
+
+	// Percentile reorders them, so it gets a copy and the samples stay in the order they were taken
+	std::vector<float> sorted = result.samplesMs;
+	result.p50Ms = Percentile( sorted.data(), count, 50.0f );
+	result.p95Ms = Percentile( sorted.data(), count, 95.0f );
+	result.minMs = *std::min_element( sorted.begin(), sorted.end() );
+	result.maxMs = *std::max_element( sorted.begin(), sorted.end() );
+}
+
+void BenchHarness::Print( const BenchResult& result ) const
+{
+	// Throughput from the median, one slow sample shouldn't drag it around
+	const double itemsPerSecond = result.p50Ms > 0.0f ? result.items / (result.p50Ms / 1000.0) : 0.0;
+	printf( "%-40s p50 %10.4f ms  mean %10.4f ms  +- %5.1f%%  %9.2f M/s\n",
+		result.name.c_str(), result.p50Ms, result.meanMs,
+		result.meanMs > 0.0f ? 100.0f * result.stddevMs / result.meanMs : 0.0f, itemsPerSecond / 1.0e6 );
+
+	// Misses per item, i.e. per pixel for most of them, so different sizes compare
+	const PerfCounters::Readings& counters = result.counters;
+	if ( counters.Has( PerfCounters::Cycles ) && counters.Has( PerfCounters::Instructions ) )
+	{
+		printf( "%-40s IPC %.2f", "", counters.values[PerfCounters::Instructions] / counters.values[PerfCounters::Cycles] );
+		for ( const PerfCounters::Counter& counter : { PerfCounters::L1Misses, PerfCounters::LlcMisses, PerfCounters::BranchMisses } )
+		{
+			if ( counters.Has( counter ) && result.items > 0.0 )
+			{
+				printf( "  %s %.4f/item", PerfCounters::GetName( counter ), counters.values[counter] / result.items );
+			}
+		}
+		printf( "\n" );
+	}
+}
+
+bool BenchHarness::Report() const
+{
+	std::string json;
+	for ( const BenchResult& result : results )
+	{
+		const double itemsPerSecond = result.p50Ms > 0.0f ? result.items / (result.p50Ms / 1000.0) : 0.0;
+
+		// null when they weren't counted, so zero always means zero
+		char allocationsJson[32] = "null";
+		if ( result.allocations >= 0.0 )
+		{
+			snprintf( allocationsJson, sizeof( allocationsJson ), "%.3f", result.allocations );
+		}
+
+		// Per call, plus IPC and everything per item, with null for whatever the machine doesn't have
+		std::string countersJson = "null";
+		const PerfCounters::Readings& counters = result.counters;
+		if ( counters.Has( PerfCounters::Cycles ) || counters.Has( PerfCounters::Instructions ) )
+		{
+			countersJson = "{";
+			char value[64];
+			for ( int i = 0; i < PerfCounters::NumCounters; i++ )
+			{
+				const PerfCounters::Counter counter = PerfCounters::Counter( i );
+				const double perItem = result.items > 0.0 ? counters.values[i] / result.items : 0.0;
+				if ( counters.Has( counter ) )
+				{
+					snprintf( value, sizeof( value ), "\"%s\":%.1f,\"%sPerItem\":%.6f,",
+						PerfCounters::GetName( counter ), counters.values[i], PerfCounters::GetName( counter ), perItem );
+				}
+				else
+				{
+					snprintf( value, sizeof( value ), "\"%s\":null,\"%sPerItem\":null,",
+						PerfCounters::GetName( counter ), PerfCounters::GetName( counter ) );
+				}
+				countersJson += value;
+			}
+
+			if ( counters.Has( PerfCounters::Cycles ) && counters.Has( PerfCounters::Instructions ) )
+			{
+				snprintf( value, sizeof( value ), "\"ipc\":%.4f}",
+					counters.values[PerfCounters::Instructions] / counters.values[PerfCounters::Cycles] );
+				countersJson += value;
+			}
+			else
+			{
+				countersJson += "\"ipc\":null}";
+			}
+		}
+
+		char entry[512];
+		snprintf( entry, sizeof( entry ),
+			"%s{\"name\":\"%s\",\"threads\":%i,\"items\":%.0f,\"samples\":%zu,\"callsPerSample\":%i,"
+			"\"ms\":{\"mean\":%.6f,\"stddev\":%.6f,\"min\":%.6f,\"p50\":%.6f,\"p95\":%.6f,\"max\":%.6f},"
+			"\"itemsPerSecond\":%.1f,\"allocations\":%s,\"counters\":",
+			json.empty() ? "" : ",", result.name.c_str(), result.threads, result.items,
+			result.samplesMs.size(), result.callsPerSample,
+			result.meanMs, result.stddevMs, result.minMs, result.p50Ms, result.p95Ms, result.maxMs,
+			itemsPerSecond, allocationsJson );
+		json += entry;
+		json += countersJson + "}";
+	}
+
+	char summary[128];
+	snprintf( summary, sizeof( summary ), "{\"hardwareThreads\":%i,\"warmup\":%i,\"repetitions\":%i,\"minSampleMs\":%.2f,",
+		std::max( 1, int( std::thread::hardware_concurrency() ) ), settings.warmup, settings.repetitions, settings.minSampleMs );
+
+	// On a line of its own, like SWater's reports
+	const std::string report = std::string( summary ) + "\"results\":[" + json + "]}";
+	std::cout << report << std::endl;
+
+	if ( settings.reportPath.empty() )
+	{
+		return true;
+	}
+
+	FILE* file = fopen( settings.reportPath.c_str(), "wb" );
+	if ( file == nullptr )
+	{
+		std::cout << "BenchHarness::Report: could not write '" << settings.reportPath << "'" << std::endl;
+		return false;
+	}
+
+	fprintf( file, "%s\n", report.c_str() );
+	fclose( file );
+	return true;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
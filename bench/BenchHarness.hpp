@@ -0,0 +1,105 @@
+
+#pragma once
+
+#include "PerfCounters.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct BenchSettings
+{
+    // Untimed runs first, so caches, the job system's threads and the allocator are warmed up
+    int warmup{ 3 };
+    // Timed samples per benchmark, the statistics are over these
+    int repetitions{ 15 };
+    // Anything quicker than this gets called several times per sample, so the clock's resolution doesn't matter
+    float minSampleMs{ 2.0f };
+    // Only runs benchmarks with this in their name, if it's set
+    std::string filter{};
+    // The JSON always goes to stdout, this writes a copy too
+    std::string reportPath{};
+    // Read hardware counters around the timed calls too, where the machine has them
+    bool perfCounters{ false };
+};
+
+// What one benchmark came out as, all the times are per call
+struct BenchResult
+{
+    std::string name;
+    // 0 if it doesn't run on the job system
+    int threads{ 0 };
+    // Pixels, bytes or whatever one call goes through, for the throughput
+    double items{ 0.0 };
+    int callsPerSample{ 1 };
+    std::vector<float> samplesMs;
+
+    float meanMs{ 0.0f };
+    float stddevMs{ 0.0f };
+    float minMs{ 0.0f };
+    float p50Ms{ 0.0f };
+    float p95Ms{ 0.0f };
+    float maxMs{ 0.0f };
+    // Heap allocations per call on any thread, -1 if they weren't counted
+    double allocations{ -1.0 };
+    // Hardware counters per call, all -1 if they weren't read
+    PerfCounters::Readings counters{ { -1.0, -1.0, -1.0, -1.0, -1.0 } };
+};
+
+// A tiny benchmark harness, warm-up, repetitions and statistics, and a JSON report at the end
+//
+// Benchmarks are timed one sample at a time with a steady clock, and short ones are called
+// several times per sample, as many as the warm-up says it takes to reach minSampleMs
+// Things that time themselves, like frames, can hand their samples over instead
+class BenchHarness final
+{
+public:
+    explicit BenchHarness( const BenchSettings& settings );
+
+    bool IsSelected( const std::string& name ) const;
+
+    // Times work, which goes through items things per call
+    void Run( const std::string& name, const double& items, const std::function<void()>& work, const int& threads = 0 );
+
+    // For benchmarks that measured themselves, e.g. a run of frames
+    // allocations is per sample, -1 if they weren't counted
+    void AddSamples( const std::string& name, const double& items, const std::vector<float>& samplesMs, const double& allocations = -1.0 );
+
+    const std::vector<BenchResult>& GetResults() const
+    {
+        return results;
+    }
+
+    // Prints the whole lot as one line of JSON, and writes it to reportPath if there is one
+    // Returns false if that couldn't be written
+    bool Report() const;
+
+private:
+    void Summarise( BenchResult& result ) const;
+    void Print( const BenchResult& result ) const;
+
+private:
+    BenchSettings settings;
+    PerfCounters perfCounters;
+    std::vector<BenchResult> results;
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
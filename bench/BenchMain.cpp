@@ -0,0 +1,385 @@
+
+#include "BenchHarness.hpp"
+// App.hpp expects these to be in already, same as in App.cpp
+#include "SDL.h"
+#include "imgui.h"
+#include "src/App.hpp"
+#include "src/JobSystem.hpp"
+#include "src/SoftwareWater.hpp"
+#include "src/TextureProvider.hpp"
+#include "src/TextureSwizzle.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// swater_bench: times the CPU kernels one by one, and whole frames through SWater's own --headless --benchmark
+// Run it from bin/ like SWater, it needs water.bmp and the shaders
+namespace
+{
+	struct Settings
+	{
+		BenchSettings harness;
+		// Thread sweeps go 1, 2, 4... up to this; 0 means one per hardware thread
+		int maxThreads{ 0 };
+		// Measured frames per headless run, after as many warm-up frames as the harness has repetitions
+		int frames{ 120 };
+	};
+
+	bool ParseArguments( int argc, char** argv, Settings& settings )
+	{
+		for ( int i = 1; i < argc; i++ )
+		{
+			const char* arg = argv[i];
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+			const auto readInt = [&]( int& out, const int& minimum )
+			{
+				char* end = nullptr;
+				const long result = value ? strtol( value, &end, 10 ) : 0;
+				if ( value == nullptr || *end != '\0' || result < minimum )
+				{
+					std::cout << "swater_bench: '" << arg << "' expects a whole number of at least " << minimum << std::endl;
+					return false;
+				}
+
+				out = int( result );
+				i++;
+				return true;
+			};
+
+			bool okay = true;
+			if ( !strcmp( arg, "--warmup" ) )
+			{
+				okay = readInt( settings.harness.warmup, 0 );
+			}
+			else if ( !strcmp( arg, "--repetitions" ) )
+			{
+				okay = readInt( settings.harness.repetitions, 1 );
+			}
+			else if ( !strcmp( arg, "--min-sample-ms" ) )
+			{
+				int milliseconds = 0;
+				okay = readInt( milliseconds, 0 );
+				settings.harness.minSampleMs = float( milliseconds );
+			}
+			else if ( !strcmp( arg, "--max-threads" ) )
+			{
+				okay = readInt( settings.maxThreads, 0 );
+			}
+			else if ( !strcmp( arg, "--frames" ) )
+			{
+				okay = readInt( settings.frames, 0 );
+			}
+			else if ( !strcmp( arg, "--filter" ) && value != nullptr )
+			{
+				settings.harness.filter = value;
+				i++;
+			}
+			else if ( !strcmp( arg, "--perf" ) )
+			{
+				settings.harness.perfCounters = true;
+			}
+			else if ( !strcmp( arg, "--report" ) && value != nullptr )
+			{
+				settings.harness.reportPath = value;
+				i++;
+			}
+			else
+			{
+				if ( strcmp( arg, "--help" ) )
+				{
+					std::cout << "swater_bench: unknown option '" << arg << "'" << std::endl;
+				}
+
+				std::cout
+					<< "Usage: swater_bench [options]" << std::endl
+					<< "  --warmup <n>        Untimed runs before measuring (default 3)" << std::endl
+					<< "  --repetitions <n>   Timed samples per benchmark (default 15)" << std::endl
+					<< "  --min-sample-ms <ms> Call quick benchmarks enough times to fill this (default 2)" << std::endl
+					<< "  --max-threads <n>   Thread sweeps go up to this many (default: one per core)" << std::endl
+					<< "  --frames <n>        Measured frames per headless run, 0 skips them (default 120)" << std::endl
+					<< "  --filter <text>     Only run benchmarks with this in their name" << std::endl
+					<< "  --perf              Read cycles, instructions, cache and branch misses too (Linux)" << std::endl
+					<< "  --report <file>     Write the JSON report here too" << std::endl;
+				return false;
+			}
+
+			if ( !okay )
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	std::string Size( const int& width, const int& height )
+	{
+		return std::to_string( width ) + "x" + std::to_string( height );
+	}
+
+	// water.bmp repeated over a bigger or smaller square, so the kernels can be tried on other sizes
+	Texture TileTexture( const Texture& source, const uint32_t& size )
+	{
+		const uint32_t sourceWidth = source.GetWidth();
+		const uint32_t sourceHeight = source.GetHeight();
+
+		TextureBuffer buffer( size_t( size ) * size );
+		for ( uint32_t y = 0; y < size; y++ )
+		{
+			for ( uint32_t x = 0; x < size; x++ )
+			{
+				buffer[size_t( y ) * size + x] = source.GetBuffer()[(y % sourceHeight) * sourceWidth + x % sourceWidth];
+			}
+		}
+
+		return Texture( size, size, buffer, source.GetPalette() );
+	}
+
+	// A whole SWater run, timed by its own benchmark mode, so shader compiles and such stay out of it
+	void RunHeadlessFrames( BenchHarness& harness, const Settings& settings, const std::string& name,
+		const int& width, const int& height, const std::vector<std::string>& extraArguments )
+	{
+		if ( settings.frames == 0 || !harness.IsSelected( name ) )
+		{
+			return;
+		}
+
+		if ( !HeadlessContext::IsAvailable() )
+		{
+			std::cout << "swater_bench: built without EGL, skipping " << name << std::endl;
+			return;
+		}
+
+		std::vector<std::string> arguments = { "SWater", "--headless", "--benchmark",
+			"--size", Size( width, height ), "--frames", std::to_string( settings.frames ),
+			"--warmup", std::to_string( std::max( 1, settings.harness.repetitions ) ) };
+		arguments.insert( arguments.end(), extraArguments.begin(), extraArguments.end() );
+
+		std::vector<char*> argv;
+		for ( std::string& argument : arguments )
+		{
+			argv.push_back( &argument[0] );
+		}
+
+		// It's big, and every run wants a fresh one
+		auto app = std::make_unique<App>();
+		if ( app->Run( int( argv.size() ), argv.data() ) != IApp::Success )
+		{
+			std::cout << "swater_bench: " << name << " failed" << std::endl;
+			return;
+		}
+
+		const Benchmark& benchmark = app->GetBenchmark();
+		const double allocations = double( benchmark.GetAllocations() ) / std::max<uint64_t>( 1, benchmark.GetNumFrames() );
+		harness.AddSamples( name, double( width ) * height, benchmark.GetFrameTimes(), allocations );
+	}
+}
+
+int main( int argc, char** argv )
+{
+	Settings settings;
+	if ( !ParseArguments( argc, argv, settings ) )
+	{
+		return 1;
+	}
+
+	BenchHarness harness( settings.harness );
+
+	const Texture water = TextureProvider::LoadTextureFromFile( "water.bmp" );
+	if ( !water )
+	{
+		std::cout << "swater_bench: Could not load image water.bmp, run it from bin/" << std::endl;
+		return 1;
+	}
+
+	const int hardwareThreads = std::max( 1, int( std::thread::hardware_concurrency() ) );
+	const int maxThreads = settings.maxThreads > 0 ? settings.maxThreads : hardwareThreads;
+
+	constexpr int ScreenSize = 1024;
+	// Big enough for the layout benchmarks, which go up to a 4096x4096 screen
+	std::vector<uint8_t> indices( size_t( 4096 ) * 4096 );
+	std::vector<uint8_t> rgb( size_t( ScreenSize ) * ScreenSize * 3 );
+
+	WaterParameters parameters;
+	parameters.time = 1.0f;
+
+	harness.Run( "bmp-decode/water.bmp", double( water.GetWidth() ) * water.GetHeight(), [&]()
+	{
+		TextureProvider::LoadTextureFromFile( "water.bmp" );
+	} );
+
+	harness.Run( "palette-expand/" + Size( ScreenSize, ScreenSize ), double( ScreenSize ) * ScreenSize, [&]()
+	{
+		SoftwareWater::ExpandPalette( water.GetPalette(), indices.data(), size_t( ScreenSize ) * ScreenSize, rgb.data() );
+	} );
+
+	// One thread, so it's the kernel itself and not the job system
+	// Bigger textures are about cache misses, the screen stays the same
+	JobSystem oneThread( 1 );
+	for ( const uint32_t& textureSize : { 64u, 128u, 256u, 512u, 1024u, 2048u } )
+	{
+		const Texture texture = TileTexture( water, textureSize );
+		harness.Run( "ripple/texture-" + Size( textureSize, textureSize ), double( ScreenSize ) * ScreenSize, [&]()
+		{
+			SoftwareWater::RenderIndices( texture, parameters, ScreenSize, ScreenSize, indices.data(), &oneThread );
+		}, 1 );
+	}
+
+	// The same texture in each TextureLayout: converting to it and back, the ripples at a texel
+	// per pixel, and going down the columns one after the other, which is row-major's worst case
+	constexpr TextureLayout Layouts[] = { TextureLayout::RowMajor, TextureLayout::Tiled, TextureLayout::Morton };
+	std::vector<uint8_t> swizzled( indices.size() );
+	for ( const uint32_t& textureSize : { 1024u, 2048u, 4096u } )
+	{
+		const Texture rowMajor = TileTexture( water, textureSize );
+		const std::string size = Size( textureSize, textureSize );
+		const double texels = double( textureSize ) * textureSize;
+
+		for ( const TextureLayout& layout : Layouts )
+		{
+			const std::string layoutName = TextureSwizzle::GetName( layout );
+			if ( layout != TextureLayout::RowMajor )
+			{
+				harness.Run( "swizzle/" + layoutName + "/" + size, texels, [&]()
+				{
+					TextureSwizzle::Swizzle( rowMajor.GetBuffer().data(), textureSize, textureSize, layout, swizzled.data() );
+				} );
+				harness.Run( "unswizzle/" + layoutName + "/" + size, texels, [&]()
+				{
+					TextureSwizzle::Unswizzle( swizzled.data(), textureSize, textureSize, layout, indices.data() );
+				} );
+			}
+
+			const Texture texture = TextureSwizzle::Convert( rowMajor, layout );
+			const TextureSampler sampler( texture );
+			harness.Run( "ripple-layout/" + layoutName + "/texture-" + size, texels, [&]()
+			{
+				SoftwareWater::RenderIndices( texture, parameters, int( textureSize ), int( textureSize ), indices.data(), &oneThread );
+			}, 1 );
+
+			std::vector<uint32_t> rowOffsets( textureSize );
+			for ( uint32_t y = 0; y < textureSize; y++ )
+			{
+				rowOffsets[y] = sampler.GetRowOffset( int( y ) );
+			}
+
+			harness.Run( "column-walk/" + layoutName + "/" + size, texels, [&]()
+			{
+				const uint8_t* texelData = texture.GetBuffer().data();
+				uint32_t sum = 0;
+				for ( uint32_t x = 0; x < textureSize; x++ )
+				{
+					const uint8_t* column = texelData + sampler.GetColumnOffset( int( x ) );
+					for ( const uint32_t& rowOffset : rowOffsets )
+					{
+						sum += column[rowOffset];
+					}
+				}
+				// So the loop can't be thrown away
+				indices[0] = uint8_t( sum );
+			} );
+		}
+	}
+
+	// The ripples again at a texel per pixel, through a guard band this time, so they can be
+	// compared with ripple-layout/row-major; and what keeping the guard band up to date costs
+	std::vector<uint8_t> patch( 64 * 64, 7 );
+	for ( const uint32_t& textureSize : { 1024u, 2048u, 4096u } )
+	{
+		const std::string size = Size( textureSize, textureSize );
+		const double texels = double( textureSize ) * textureSize;
+		if ( !harness.IsSelected( "ripple-guard-band/texture-" + size ) && !harness.IsSelected( "guard-band/build/" + size )
+			&& !harness.IsSelected( "guard-band/update-64x64/" + size ) )
+		{
+			continue;
+		}
+
+		Texture texture = TileTexture( water, textureSize );
+		texture.SetGuardBand( GuardBand::DefaultGuard );
+		printf( "swater_bench: a guard band of %i round %s is %.1f KB, +%.1f%%\n", GuardBand::DefaultGuard, size.c_str(),
+			texture.GetGuardBand().GetOverheadBytes() / 1024.0, 100.0 * texture.GetGuardBand().GetOverheadBytes() / texels );
+
+		harness.Run( "ripple-guard-band/texture-" + size, texels, [&]()
+		{
+			SoftwareWater::RenderIndices( texture, parameters, int( textureSize ), int( textureSize ), indices.data(), &oneThread );
+		}, 1 );
+		harness.Run( "guard-band/build/" + size, texels, [&]()
+		{
+			texture.SetGuardBand( GuardBand::DefaultGuard );
+		} );
+		// Near a corner, so the rows it redoes are in the border too
+		harness.Run( "guard-band/update-64x64/" + size, double( patch.size() ), [&]()
+		{
+			texture.Update( 0, 0, 64, 64, patch.data() );
+		} );
+	}
+
+	// Then the other way round: the 128x128 texture blown up to bigger and bigger screens
+	for ( const int& screenSize : { 256, 512, 1024, 2048 } )
+	{
+		harness.Run( "upscale/128x128-to-" + Size( screenSize, screenSize ), double( screenSize ) * screenSize, [&]()
+		{
+			SoftwareWater::RenderIndices( water, parameters, screenSize, screenSize, indices.data(), &oneThread );
+		}, 1 );
+	}
+
+	// Same thread counts as --benchmark-jobs
+	std::vector<int> threadCounts;
+	for ( int threads = 1; threads < maxThreads; threads *= 2 )
+	{
+		threadCounts.push_back( threads );
+	}
+	threadCounts.push_back( maxThreads );
+
+	for ( const int& threads : threadCounts )
+	{
+		const std::string name = "ripple-threads/" + Size( ScreenSize, ScreenSize ) + "/threads-" + std::to_string( threads );
+		if ( !harness.IsSelected( name ) )
+		{
+			continue;
+		}
+
+		JobSystem jobs( threads );
+		harness.Run( name, double( ScreenSize ) * ScreenSize, [&]()
+		{
+			SoftwareWater::RenderIndices( water, parameters, ScreenSize, ScreenSize, indices.data(), &jobs );
+		}, threads );
+	}
+
+	// End to end, shaders and all
+	for ( const int& screenSize : { 512, 1024 } )
+	{
+		RunHeadlessFrames( harness, settings, "frames/2d/" + Size( screenSize, screenSize ), screenSize, screenSize, {} );
+		RunHeadlessFrames( harness, settings, "frames/2d-cpu-water/" + Size( screenSize, screenSize ), screenSize, screenSize, { "--cpu-water" } );
+		RunHeadlessFrames( harness, settings, "frames/scene/" + Size( screenSize, screenSize ), screenSize, screenSize, { "--scene" } );
+	}
+
+	return harness.Report() ? 0 : 1;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
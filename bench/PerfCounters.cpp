@@ -0,0 +1,170 @@
+
+#include "PerfCounters.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#if defined( __linux__ )
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#if defined( __linux__ )
+	// glibc doesn't wrap this one
+	int OpenCounter( const uint32_t& type, const uint64_t& config )
+	{
+		perf_event_attr attributes;
+		memset( &attributes, 0, sizeof( attributes ) );
+		attributes.size = sizeof( attributes );
+		attributes.type = type;
+		attributes.config = config;
+		attributes.disabled = 1;
+		attributes.inherit = 1;
+		// Kernel counting needs more than perf_event_paranoid usually allows, and isn't ours anyway
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		return int( syscall( __NR_perf_event_open, &attributes, 0, -1, -1, 0 ) );
+	}
+
+	uint64_t CacheConfig( const uint64_t& cache, const uint64_t& operation, const uint64_t& result )
+	{
+		return cache | (operation << 8) | (result << 16);
+	}
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+	Close();
+}
+
+bool PerfCounters::Open()
+{
+	Close();
+
+#if defined( __linux__ )
+	descriptors[Cycles] = OpenCounter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES );
+	// Whatever went wrong with the first one is usually what goes wrong with all of them
+	const int error = errno;
+	descriptors[Instructions] = OpenCounter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS );
+	descriptors[L1Misses] = OpenCounter( PERF_TYPE_HW_CACHE,
+		CacheConfig( PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS ) );
+	descriptors[LlcMisses] = OpenCounter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES );
+	descriptors[BranchMisses] = OpenCounter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES );
+
+	if ( IsOpen() )
+	{
+		return true;
+	}
+
+	std::cout << "PerfCounters::Open: no hardware counters (" << strerror( error )
+		<< "), check /proc/sys/kernel/perf_event_paranoid, or it's a VM or container without them" << std::endl;
+	return false;
+#else
+	std::cout << "PerfCounters::Open: hardware counters are only read on Linux" << std::endl;
+	return false;
+#endif
+}
+
+void PerfCounters::Close()
+{
+	for ( int& descriptor : descriptors )
+	{
+#if defined( __linux__ )
+		if ( descriptor >= 0 )
+		{
+			close( descriptor );
+		}
+#endif
+		descriptor = -1;
+	}
+}
+
+bool PerfCounters::IsOpen() const
+{
+	for ( const int& descriptor : descriptors )
+	{
+		if ( descriptor >= 0 )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void PerfCounters::Start()
+{
+#if defined( __linux__ )
+	for ( const int& descriptor : descriptors )
+	{
+		if ( descriptor >= 0 )
+		{
+			ioctl( descriptor, PERF_EVENT_IOC_RESET, 0 );
+			ioctl( descriptor, PERF_EVENT_IOC_ENABLE, 0 );
+		}
+	}
+#endif
+}
+
+PerfCounters::Readings PerfCounters::Stop()
+{
+	Readings readings;
+	for ( int i = 0; i < NumCounters; i++ )
+	{
+		readings.values[i] = -1.0;
+
+#if defined( __linux__ )
+		if ( descriptors[i] < 0 )
+		{
+			continue;
+		}
+
+		ioctl( descriptors[i], PERF_EVENT_IOC_DISABLE, 0 );
+
+		// The value, then how long it was enabled and how long it was actually counting
+		uint64_t values[3]{};
+		if ( read( descriptors[i], values, sizeof( values ) ) != ssize_t( sizeof( values ) ) || values[2] == 0 )
+		{
+			continue;
+		}
+
+		// With more counters than the PMU has, they take turns, so scale up to the whole time
+		readings.values[i] = double( values[0] ) * double( values[1] ) / double( values[2] );
+#endif
+	}
+
+	return readings;
+}
+
+const char* PerfCounters::GetName( const Counter& counter )
+{
+	static const char* const names[NumCounters] = { "cycles", "instructions", "l1Misses", "llcMisses", "branchMisses" };
+	return names[counter];
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
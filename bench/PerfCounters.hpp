@@ -0,0 +1,80 @@
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Hardware performance counters through Linux's perf_event_open, to tell whether a
+// benchmark is waiting on memory or on mispredicted branches rather than just how long it took
+//
+// Each counter is opened on its own, so whatever the machine has still gets counted if
+// some of them aren't there, and they're scaled up if the kernel had to take turns with them
+// They count user space only, for this thread and any thread started after Open, which
+// covers job systems created per benchmark but not ones that were running already
+//
+// Containers and VMs often have no counters at all, or perf_event_paranoid forbids them;
+// then Open says why and returns false, and the benchmarks carry on with just the timings
+class PerfCounters final
+{
+public:
+    enum Counter
+    {
+        Cycles,
+        Instructions,
+        L1Misses,       // L1 data cache read misses
+        LlcMisses,      // Last-level cache misses
+        BranchMisses,
+        NumCounters
+    };
+
+    // Totals between Start and Stop, -1 for counters that couldn't be opened
+    struct Readings
+    {
+        double values[NumCounters];
+
+        bool Has( const Counter& counter ) const
+        {
+            return values[counter] >= 0.0;
+        }
+    };
+
+    PerfCounters() = default;
+    ~PerfCounters();
+
+    PerfCounters( const PerfCounters& ) = delete;
+    PerfCounters& operator=( const PerfCounters& ) = delete;
+
+    // True if at least one counter could be opened
+    bool Open();
+    void Close();
+
+    bool IsOpen() const;
+
+    void Start();
+    Readings Stop();
+
+    // Names for reports, e.g. "llcMisses"
+    static const char* GetName( const Counter& counter );
+
+private:
+    int descriptors[NumCounters]{ -1, -1, -1, -1, -1 };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,37 @@
+
+#version 330 core
+
+in vec3 fragmentPosition;
+in vec2 fragmentCoord;
+
+out vec4 outColor;
+
+// Brushes in the 3D scene, they're just there to hold the water
+void main()
+{
+    // Flat shading; brushes have no normals, but the screen-space derivatives of the position
+    // lie in the face's plane, so their cross product points along the normal
+    vec3 normal = normalize( cross( dFdx( fragmentPosition ), dFdy( fragmentPosition ) ) );
+    float light = 0.55 + 0.45 * abs( dot( normal, normalize( vec3( 0.4, 0.8, 0.3 ) ) ) );
+
+    outColor = vec4( vec3( 0.42, 0.38, 0.33 ) * light, 1.0 );
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
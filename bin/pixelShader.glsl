@@ -9,63 +9,27 @@ uniform sampler2D paletteMap;
 uniform float gTime;
 uniform int gUpperIndex;
 uniform int gLowerIndex;
-uniform int gTextureWidth;
-uniform int gTextureHeight;
 
 out vec4 outColor;
 
-// Index conversion utilities
-int Index_F2I( float index )
-{
-    return int( index * 255.0 );
-}
-
-float Index_I2F( int index )
-{
-    return index / 255.0;
-}
-
-// Coordinate conversion utilities
-// Must know texture dimensions beforehand! (todo: change this with a simple uniform)
-ivec2 Coord_F2I( vec2 coord )
-{
-    return ivec2( int(coord.x * float(gTextureWidth)), int(coord.y * float(gTextureHeight)) );
-}
-
-vec2 Coord_I2F( ivec2 coord )
-{
-    return vec2( float(coord.x / float(gTextureWidth)), float(coord.y / float(gTextureHeight)) );
-}
+#include "waterCommon.glsl"
 
-// Sample an index from this integer coordinate
-int SampleIndex( ivec2 coords )
-{
-    vec2 fcoords = Coord_I2F( coords );
-    return Index_F2I( texture( diffuseMap, fcoords ).r );
-}
-
-// Samples a colour from the palette
-vec3 SampleColor( int index )
-{
-    // Multiplying by 255/256 prevents the 'palette overflow' issue
-    return texture( paletteMap, vec2( Index_I2F( index ) * (255.0/256.0), 0.5 ) ).rgb;
-}
-
-// Final sample
-// paletteOffset is used to shift the colour in the palette
-vec3 SamplePrimary( ivec2 coords, int paletteOffset )
-{
-    return SampleColor( SampleIndex( coords ) + paletteOffset );
-}
+// Effect options, the defaults match what this shader always did
+// How many times per second the waves move by one pixel
+#ifndef RIPPLE_RATE
+#define RIPPLE_RATE 20.0
+#endif
 
 int FixIndex( int index )
 {
     index = abs( index % 256 );
 
+#ifdef FIX_FOG_INDEX
     // Index 4 is reserved for underwater fog colour and is sometimes
     // drastically different from the rest of the texture's hue
     if ( index == 4 )
         return 5;
+#endif
 
     return index;
 }
@@ -83,11 +47,39 @@ int TimeFraction( const float time, const float updateRate )
 
 void main()
 {
+#ifdef PALETTE_MIPS
+    SelectMipLevel( fragmentCoord );
+#endif
+
+#if defined( CPU_INDICES )
+    // WaterSimulation has done the lot on the CPU, an index for every pixel of the screen
+    int finalIndex = Index_F2I( texelFetch( diffuseMap, ivec2( gl_FragCoord.xy ), 0 ).r );
+    int avgIndex = finalIndex;
+#elif defined( VERTEX_WARP )
+    // The vertex shader has done all the moving already
+    // The warp can push coordinates below zero, where int() would round the wrong way
+    int finalIndex = SampleIndex( ivec2( floor( fragmentCoord * vec2( TextureWidth, TextureHeight ) ) ) );
+    int avgIndex = finalIndex;
+#else
     // We move the wave on an integer grid
+#ifdef VIRTUAL_TEXTURE
+    // A texel per pixel, the texture's far too big to stretch over the screen
+    ivec2 currentIntCoord = ivec2( gl_FragCoord.xy ) * gVirtualScale + gVirtualOrigin;
+#else
     ivec2 currentIntCoord = Coord_F2I( fragmentCoord );
+#endif
     // timeOffset has a range between 0 and 127, and it updates through time like a sawtooth
     // 128 is currently hardcoded but will be replaced with the texture's width
-    int timeOffset = TimeFraction( gTime, 20.0 );
+    int timeOffset = TimeFraction( gTime, RIPPLE_RATE );
+
+#ifdef VIRTUAL_FEEDBACK
+    // Just the page this pixel reads, 16 bits of x and 16 of y, for VirtualTexture to stream in
+    // There are three samples, so neighbouring pixels and frames take turns between them
+    ivec2 samples[3] = ivec2[3]( currentIntCoord, currentIntCoord + ivec2(timeOffset, 32), currentIntCoord + ivec2(-48, timeOffset) );
+    ivec2 page = VirtualPage( samples[(int( gl_FragCoord.x ) + int( gl_FragCoord.y ) + gFeedbackFrame) % 3] );
+    outColor = vec4( page.x & 255, page.x >> 8, page.y & 255, page.y >> 8 ) / 255.0;
+    return;
+#endif
 
     // Static water
     int mainIndex = SampleIndex( currentIntCoord );
@@ -99,15 +91,25 @@ void main()
     int avgIndex = FixIndex( (primaryIndex + secondaryIndex) / 2 );
 
     // Draw the static texture as-is
-    outColor.rgb = SamplePrimary( currentIntCoord, 0 );
+    int finalIndex = mainIndex;
     
     // This is the "fake ripple" algorithm
     // Without reverse-engineering GoldSRC's software renderer, I can't do much else here!
     if ( bool(avgIndex & 48) && avgIndex > gLowerIndex && avgIndex < gUpperIndex )
-        outColor.rgb = SampleColor( avgIndex );
+        finalIndex = avgIndex;
+#endif
+
+    outColor.rgb = SampleColor( finalIndex );
+
+#ifdef OUTPUT_INDICES
+    // The palette index itself, for comparing against SoftwareWater
+    outColor.rgb = vec3( Index_I2F(finalIndex) );
+#endif
 
-    // Uncomment this to debug the mixing indices
-    //outColor.rgb = vec3( Index_I2F(avgIndex) );
+#ifdef DEBUG_INDICES
+    // Shows the mixing indices instead
+    outColor.rgb = vec3( Index_I2F(avgIndex) );
+#endif
     
     outColor.a = 1.0;
 }
@@ -9,11 +9,39 @@ layout ( location = 1 ) in vec2 vertexCoord;
 out vec3 fragmentPosition;
 out vec2 fragmentCoord;
 
+#ifdef SCENE_3D
+// World space to clip space, from the free-fly camera
+uniform mat4 gViewProjection;
+#endif
+
+#ifdef VERTEX_WARP
+// GLQuake's water: the surface is chopped into 64-unit pieces and the texture
+// coordinates get pushed around per vertex, so the pixel shader only does one lookup
+uniform float gTime;
+
+vec2 WarpCoord( vec2 coord )
+{
+    // GLQuake works in texels, s + 8 * sin( t / 8 + time ) and the other way around
+    // The full size from the defines; textureSize() is relative to the base level, which streaming moves
+    vec2 textureSize = vec2( TEXTURE_WIDTH, TEXTURE_HEIGHT );
+    vec2 texels = coord * textureSize;
+    return (texels + 8.0 * sin( texels.yx * 0.125 + gTime )) / textureSize;
+}
+#endif
+
 void main()
 {
+#ifdef SCENE_3D
+	gl_Position = gViewProjection * vec4( vertexPosition, 1.0 );
+#else
 	gl_Position = vec4( vertexPosition, 1.0 );
+#endif
 	fragmentPosition = vertexPosition;
+#ifdef VERTEX_WARP
+	fragmentCoord = WarpCoord( vertexCoord );
+#else
 	fragmentCoord = vertexCoord;
+#endif
 }
 
 /*
@@ -0,0 +1,163 @@
+
+// Shared by everything that samples indexed textures
+// Expects diffuseMap and paletteMap samplers to be declared by the includer
+
+// Texture dimensions are compile-time constants when the variant defines them,
+// so all the coordinate maths below folds down to a few multiplies or masks
+#ifdef TEXTURE_WIDTH
+const int TextureWidth = TEXTURE_WIDTH;
+const int TextureHeight = TEXTURE_HEIGHT;
+#else
+uniform int gTextureWidth;
+uniform int gTextureHeight;
+#define TextureWidth gTextureWidth
+#define TextureHeight gTextureHeight
+#endif
+
+// Index conversion utilities
+int Index_F2I( float index )
+{
+    return int( index * 255.0 );
+}
+
+float Index_I2F( int index )
+{
+    return index / 255.0;
+}
+
+// Coordinate conversion utilities
+ivec2 Coord_F2I( vec2 coord )
+{
+    return ivec2( int(coord.x * float(TextureWidth)), int(coord.y * float(TextureHeight)) );
+}
+
+vec2 Coord_I2F( ivec2 coord )
+{
+    return vec2( float(coord.x / float(TextureWidth)), float(coord.y / float(TextureHeight)) );
+}
+
+#ifdef ATLAS
+// Every surface's texture is a region of one of the pages, see TextureAtlas
+uniform sampler2DArray atlasMap;
+uniform sampler2D atlasPaletteMap;
+// x, y, width and height of the region in its page, in texels
+uniform ivec4 gAtlasRegion;
+uniform int gAtlasPage;
+// Row of the palette table
+uniform int gAtlasPalette;
+#endif
+
+#ifdef VIRTUAL_TEXTURE
+// diffuseMap is the page cache and pageTableMap has a texel per page, see VirtualTexture:
+// where the page is in the cache (r and g, in pages), whether it's there at all (b),
+// and its average index (a) to draw it with until it is
+uniform sampler2D pageTableMap;
+// The view's bottom left corner, in texels, and how many texels a pixel is across
+uniform ivec2 gVirtualOrigin;
+uniform int gVirtualScale;
+// Counts frames, the feedback pass goes through a pixel's samples with it
+uniform int gFeedbackFrame;
+
+// The origin is always wrapped already, so coordinates are never more than the ripples'
+// offsets below zero, and one add is enough to keep % away from negative numbers
+ivec2 WrapVirtual( ivec2 coords )
+{
+    ivec2 size = ivec2( TextureWidth, TextureHeight );
+    return (coords + size) % size;
+}
+
+ivec2 VirtualPage( ivec2 coords )
+{
+    return WrapVirtual( coords ) / VIRTUAL_PAGE_SIZE;
+}
+#endif
+
+#ifdef PALETTE_MIPS
+// Which level SampleIndex reads, picked once per pixel by SelectMipLevel
+// PALETTE_MIPS is how many levels there are below level 0
+int mipLevel = 0;
+// The finest level that's on the GPU, see TextureResidency
+// texelFetch counts levels from there, not from level 0
+uniform int gBaseLevel;
+
+void SelectMipLevel( vec2 coord )
+{
+    vec2 texels = coord * vec2( float(TextureWidth), float(TextureHeight) );
+    vec2 dx = dFdx( texels );
+    vec2 dy = dFdy( texels );
+    // Same pick as GL_NEAREST_MIPMAP_NEAREST, the rounded log2 of the pixel's footprint
+    float footprint = max( dot( dx, dx ), dot( dy, dy ) );
+    mipLevel = clamp( int( 0.5 * log2( footprint ) + 0.5 ), gBaseLevel, PALETTE_MIPS );
+}
+#endif
+
+// Sample an index from this integer coordinate
+int SampleIndex( ivec2 coords )
+{
+#if defined( ATLAS )
+    // GL_REPEAT would wrap around the whole page, so wrap inside the region instead
+    // Coordinates stay in world texels, a smaller texture just repeats more often
+    ivec2 size = gAtlasRegion.zw;
+    ivec2 wrapped = coords - size * ivec2( floor( vec2( coords ) / vec2( size ) ) );
+    return Index_F2I( texelFetch( atlasMap, ivec3( gAtlasRegion.xy + wrapped, gAtlasPage ), 0 ).r );
+#elif defined( VIRTUAL_TEXTURE )
+    ivec2 wrapped = WrapVirtual( coords );
+    vec4 entry = texelFetch( pageTableMap, wrapped / VIRTUAL_PAGE_SIZE, 0 );
+    // Not streamed in yet
+    if ( entry.b < 0.5 )
+        return Index_F2I( entry.a );
+
+    ivec2 slot = ivec2( entry.rg * 255.0 + 0.5 );
+    return Index_F2I( texelFetch( diffuseMap, slot * VIRTUAL_PAGE_SIZE + wrapped % VIRTUAL_PAGE_SIZE, 0 ).r );
+#elif defined( POW2_WRAP )
+    // Power-of-two textures can wrap with a mask and skip the float round trip
+    // that GL_REPEAT would otherwise need
+#ifdef PALETTE_MIPS
+    // Offsets stay in level 0 texels, so the ripples don't speed up further away
+    return Index_F2I( texelFetch( diffuseMap, (coords & ivec2( TextureWidth - 1, TextureHeight - 1 )) >> mipLevel, mipLevel - gBaseLevel ).r );
+#else
+    return Index_F2I( texelFetch( diffuseMap, coords & ivec2( TextureWidth - 1, TextureHeight - 1 ), 0 ).r );
+#endif
+#else
+    vec2 fcoords = Coord_I2F( coords );
+    return Index_F2I( texture( diffuseMap, fcoords ).r );
+#endif
+}
+
+// Samples a colour from the palette
+vec3 SampleColor( int index )
+{
+#ifdef ATLAS
+    return texelFetch( atlasPaletteMap, ivec2( index & 255, gAtlasPalette ), 0 ).rgb;
+#else
+    // Multiplying by 255/256 prevents the 'palette overflow' issue
+    return texture( paletteMap, vec2( Index_I2F( index ) * (255.0/256.0), 0.5 ) ).rgb;
+#endif
+}
+
+// Final sample
+// paletteOffset is used to shift the colour in the palette
+vec3 SamplePrimary( ivec2 coords, int paletteOffset )
+{
+    return SampleColor( SampleIndex( coords ) + paletteOffset );
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
@@ -0,0 +1,121 @@
+
+#include "Allocations.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<uint64_t> count{ 0 };
+	std::atomic<uint64_t> bytes{ 0 };
+	// Plain old data, so it's there before anything gets constructed, even during static init
+	thread_local uint64_t threadCount = 0;
+}
+
+uint64_t Allocations::GetCount()
+{
+	return count.load( std::memory_order_relaxed );
+}
+
+uint64_t Allocations::GetBytes()
+{
+	return bytes.load( std::memory_order_relaxed );
+}
+
+uint64_t Allocations::GetThreadCount()
+{
+	return threadCount;
+}
+
+#if SWATER_COUNT_ALLOCATIONS
+
+namespace
+{
+	void* CountedAllocate( std::size_t size )
+	{
+		count.fetch_add( 1, std::memory_order_relaxed );
+		bytes.fetch_add( size, std::memory_order_relaxed );
+		threadCount++;
+
+		// malloc( 0 ) is allowed to return null, new isn't
+		return std::malloc( size > 0 ? size : 1 );
+	}
+}
+
+void* operator new( std::size_t size )
+{
+	void* memory = CountedAllocate( size );
+	if ( memory == nullptr )
+	{
+		throw std::bad_alloc();
+	}
+
+	return memory;
+}
+
+void* operator new[]( std::size_t size )
+{
+	return operator new( size );
+}
+
+void* operator new( std::size_t size, const std::nothrow_t& ) noexcept
+{
+	return CountedAllocate( size );
+}
+
+void* operator new[]( std::size_t size, const std::nothrow_t& ) noexcept
+{
+	return CountedAllocate( size );
+}
+
+void operator delete( void* memory ) noexcept
+{
+	std::free( memory );
+}
+
+void operator delete[]( void* memory ) noexcept
+{
+	std::free( memory );
+}
+
+void operator delete( void* memory, std::size_t ) noexcept
+{
+	std::free( memory );
+}
+
+void operator delete[]( void* memory, std::size_t ) noexcept
+{
+	std::free( memory );
+}
+
+void operator delete( void* memory, const std::nothrow_t& ) noexcept
+{
+	std::free( memory );
+}
+
+void operator delete[]( void* memory, const std::nothrow_t& ) noexcept
+{
+	std::free( memory );
+}
+
+#endif
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
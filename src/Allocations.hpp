@@ -0,0 +1,46 @@
+
+#pragma once
+
+#include <cstdint>
+
+// Counts every trip to the heap, by replacing the global operator new and delete
+// Build with SWATER_COUNT_ALLOCATIONS=1 to turn it on (Debug builds and swater_bench do),
+// otherwise nothing gets replaced and the counts stay at zero
+//
+// Benchmark mode uses it to check that frames don't allocate once they've warmed up,
+// see --no-allocations
+#ifndef SWATER_COUNT_ALLOCATIONS
+#define SWATER_COUNT_ALLOCATIONS 0
+#endif
+
+namespace Allocations
+{
+    // Whether anything's being counted at all
+    constexpr bool Enabled = SWATER_COUNT_ALLOCATIONS != 0;
+
+    // Every thread together, since the start
+    uint64_t GetCount();
+    uint64_t GetBytes();
+
+    // Just the calling thread, so what other threads are up to doesn't get mixed in
+    uint64_t GetThreadCount();
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -1,13 +1,26 @@
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <thread>
 
 #include "SDL.h"
 #include "imgui.h"
 #include "backends/imgui_impl_opengl3.h"
 #include "backends/imgui_impl_sdl.h"
 #include "TextureProvider.hpp"
+#include "Trace.hpp"
+#include "ImageWriter.hpp"
+#include "ImageCompare.hpp"
+#include "SoftwareWater.hpp"
+#include "GifWriter.hpp"
+#include "PaletteMips.hpp"
+#include "TextureSwizzle.hpp"
+#include "JobSystem.hpp"
+#include "Allocations.hpp"
 #include "App.hpp"
 
 IApp& GetApp()
@@ -16,6 +29,10 @@ IApp& GetApp()
 	return app;
 }
 
+constexpr int App::GuiSettleFrames;
+constexpr int App::VirtualDriftX;
+constexpr int App::VirtualDriftY;
+
 // Taken from FoxGLBox:
 // https://github.com/Admer456/FoxGLBox/blob/master/renderer/src/Backends/OpenGL45/Renderer.cpp#L25
 const char* glTranslateError( GLenum error )
@@ -64,129 +81,1263 @@ bool GLError( const char* why = nullptr )
 	return false;
 }
 
-int App::Run()
+int App::Run( int argc, char** argv )
+{
+	TRACE_THREAD_NAME( "Main" );
+
+	if ( !options.Parse( argc, argv ) )
+	{
+		return Failure;
+	}
+
+	JobSystem::Configure( options.jobThreads, options.pinThreads );
+
+	// Entirely on the CPU, so there's no need for a window or a context
+	if ( options.benchmarkJobs )
+	{
+		return BenchmarkJobs();
+	}
+
+	if ( !options.gifPath.empty() )
+	{
+		return ExportGif();
+	}
+
+	// Doesn't need GL, so it's done before there's a context
+	if ( !options.makeVirtualPath.empty()
+		&& !VirtualTexture::Convert( options.makeVirtualPath.c_str(), options.virtualTexturePath.c_str() ) )
+	{
+		return Failure;
+	}
+
+	if ( !CreateContext() )
+		return Shutdown( Failure );
+
+	scene3D = options.scene;
+	vertexWarp = options.vertexWarp;
+	useAtlas = options.atlas;
+	onDemand = options.onDemand;
+	cpuWater = options.cpuWater;
+	useVirtualTexture = !options.virtualTexturePath.empty();
+
+	// GUI is optional, you can reload shaders with R
+	if ( options.gui )
+	{
+		TRACE_SCOPE( "CreateGui" );
+		CreateGui();
+	}
+
+	// The texture goes first, its dimensions are baked into the shaders
+	{
+		TRACE_SCOPE( "CreateTexture" );
+		if ( !CreateTexture() )
+			return Shutdown( Failure );
+	}
+
+	{
+		TRACE_SCOPE( "CreateShaders" );
+		if ( !CreateShaders() )
+			return Shutdown( Failure );
+	}
+
+	{
+		TRACE_SCOPE( "CreateGeometry" );
+		if ( !CreateGeometry() )
+			return Shutdown( Failure );
+	}
+
+	if ( options.golden )
+	{
+		return Shutdown( RunGolden() );
+	}
+
+	// Not fatal, the overlay just won't have GPU times
+	frameStats.Init();
+
+	if ( !options.capturePath.empty() )
+	{
+		ToggleCapture();
+	}
+
+	if ( cpuWater )
+	{
+		StartSimulation();
+	}
+
+	// Benchmarks shouldn't have a reload land in the middle of them
+	if ( options.watchShaders && window != nullptr && !options.benchmark )
+	{
+		StartWatchingShaders();
+	}
+
+	if ( options.benchmark )
+	{
+		benchmark.Start( options );
+	}
+
+	runStart = FrameStats::Clock::now();
+	lastAnimationUpdate = runStart;
+	while ( run )
+	{
+		if ( onDemand && window != nullptr )
+		{
+			WaitForChanges();
+		}
+
+		RunFrame();
+		frameCount++;
+
+		// Benchmarks only count frames after the warm-up
+		if ( options.benchmark ? benchmark.EndFrame() : ReachedRunLimit() )
+		{
+			run = false;
+		}
+	}
+
+	if ( options.benchmark )
+	{
+		return Shutdown( FinishBenchmark() );
+	}
+
+	return Shutdown( Success );
+}
+
+int App::FinishBenchmark()
+{
+	// Frames still queued up on the GPU count too
+	glFinish();
+
+	BenchmarkContext context;
+	context.renderer = reinterpret_cast<const char*>( glGetString( GL_RENDERER ) );
+	context.version = reinterpret_cast<const char*>( glGetString( GL_VERSION ) );
+	context.width = renderWidth;
+	context.height = renderHeight;
+	context.textureWidth = texture.GetWidth();
+	context.textureHeight = texture.GetHeight();
+
+	return benchmark.Report( context ) ? Success : Failure;
+}
+
+// Renders exactly one loop of the ripples with SoftwareWater and saves it as a GIF
+int App::ExportGif()
+{
+	TRACE_SCOPE( "ExportGif" );
+
+	texture = TextureProvider::LoadTextureFromFile( "water.bmp" );
+	if ( !texture )
+	{
+		std::cout << "App::ExportGif: Could not load image water.bmp" << std::endl;
+		return Failure;
+	}
+
+	if ( !CreateCpuTexture() )
+	{
+		return Failure;
+	}
+
+	WaterParameters parameters;
+	parameters.upperIndex = upperIndex;
+	parameters.lowerIndex = lowerIndex;
+	parameters.fixFogIndex = fixFogIndex;
+
+	// The waves move one texel per tick, horizontally and vertically,
+	// so they line up again after lcm( width, height ) ticks
+	const auto greatestCommonDivisor = []( int a, int b )
+	{
+		while ( b != 0 )
+		{
+			const int remainder = a % b;
+			a = b;
+			b = remainder;
+		}
+		return a;
+	};
+
+	const int textureWidth = int( texture.GetWidth() );
+	const int textureHeight = int( texture.GetHeight() );
+	const int numFrames = textureWidth / greatestCommonDivisor( textureWidth, textureHeight ) * textureHeight;
+	const int delayCentiseconds = int( 100.0f / parameters.rippleRate + 0.5f );
+
+	const auto renderFrame = [&]( const int& frame, uint8_t* outIndices )
+	{
+		// Halfway into each tick, so float rounding can't land on the wrong one
+		WaterParameters frameParameters = parameters;
+		frameParameters.time = (float( frame ) + 0.5f) / parameters.rippleRate;
+
+		SoftwareWater::RenderIndices( cpuTexture, frameParameters, options.width, options.height, outIndices );
+	};
+
+	const auto start = FrameStats::Clock::now();
+	if ( !GifWriter::Write( options.gifPath.c_str(), options.width, options.height, texture.GetPalette(),
+		numFrames, delayCentiseconds, renderFrame, true ) )
+	{
+		return Failure;
+	}
+
+	const std::chrono::duration<double> elapsed = FrameStats::Clock::now() - start;
+	printf( "App::ExportGif: wrote %i frames of %ix%i to '%s' in %.3f seconds\n",
+		numFrames, options.width, options.height, options.gifPath.c_str(), elapsed.count() );
+
+	return Success;
+}
+
+// Times the job system on its own and with the CPU ripples, for 1 thread, 2, 4 and so on,
+// each with a job system of its own. Spawning is empty jobs, so that's all overhead,
+// and the ripples at 1 thread are the baseline the others get compared to
+int App::BenchmarkJobs()
+{
+	texture = TextureProvider::LoadTextureFromFile( "water.bmp" );
+	if ( !texture )
+	{
+		std::cout << "App::BenchmarkJobs: Could not load image water.bmp" << std::endl;
+		return Failure;
+	}
+
+	if ( !CreateCpuTexture() )
+	{
+		return Failure;
+	}
+
+	constexpr int SpawnJobs = 100000;
+	constexpr int Repetitions = 10;
+
+	const int hardwareThreads = std::max( 1, int( std::thread::hardware_concurrency() ) );
+	const int maxThreads = options.jobThreads > 0 ? options.jobThreads : hardwareThreads;
+
+	std::vector<int> threadCounts;
+	for ( int threads = 1; threads < maxThreads; threads *= 2 )
+	{
+		threadCounts.push_back( threads );
+	}
+	threadCounts.push_back( maxThreads );
+
+	std::vector<uint8_t> indices( size_t( options.width ) * options.height );
+	WaterParameters parameters;
+	parameters.time = 1.0f;
+
+	std::string results;
+	double baselineMs = 0.0;
+	for ( const int& threads : threadCounts )
+	{
+		JobSystem jobs( threads, options.pinThreads );
+
+		double spawnNs = 1.0e9;
+		for ( int i = 0; i < Repetitions; i++ )
+		{
+			const auto start = FrameStats::Clock::now();
+			JobSystem::Counter counter;
+			for ( int job = 0; job < SpawnJobs; job++ )
+			{
+				jobs.Run( counter, []() {} );
+			}
+			jobs.Wait( counter );
+			const std::chrono::duration<double, std::nano> elapsed = FrameStats::Clock::now() - start;
+			spawnNs = std::min( spawnNs, elapsed.count() / SpawnJobs );
+		}
+
+		double rippleMs = 1.0e9;
+		for ( int i = 0; i < Repetitions; i++ )
+		{
+			const auto start = FrameStats::Clock::now();
+			SoftwareWater::RenderIndices( cpuTexture, parameters, options.width, options.height, indices.data(), &jobs );
+			const std::chrono::duration<double, std::milli> elapsed = FrameStats::Clock::now() - start;
+			rippleMs = std::min( rippleMs, elapsed.count() );
+		}
+
+		if ( threads == 1 )
+		{
+			baselineMs = rippleMs;
+		}
+
+		const double speedup = baselineMs / rippleMs;
+		printf( "App::BenchmarkJobs: %i threads: %.1f ns per empty job, ripples %.3f ms (%.2fx), %llu of %llu jobs stolen\n",
+			threads, spawnNs, rippleMs, speedup,
+			(unsigned long long)jobs.GetNumJobsStolen(), (unsigned long long)jobs.GetNumJobsRun() );
+
+		char result[256];
+		snprintf( result, sizeof( result ),
+			"%s{\"threads\":%i,\"spawnNs\":%.2f,\"rippleMs\":%.4f,\"speedup\":%.3f,\"jobsRun\":%llu,\"jobsStolen\":%llu}",
+			results.empty() ? "" : ",", threads, spawnNs, rippleMs, speedup,
+			(unsigned long long)jobs.GetNumJobsRun(), (unsigned long long)jobs.GetNumJobsStolen() );
+		results += result;
+	}
+
+	char summary[128];
+	snprintf( summary, sizeof( summary ), "\"hardwareThreads\":%i,\"pinned\":%s,\"width\":%i,\"height\":%i",
+		hardwareThreads, options.pinThreads ? "true" : "false", options.width, options.height );
+
+	// On a line of its own, like the other reports
+	const std::string report = std::string( "{" ) + summary + ",\"results\":[" + results + "]}";
+	std::cout << report << std::endl;
+
+	if ( !options.reportPath.empty() )
+	{
+		std::ofstream file( options.reportPath, std::ios::binary );
+		file << report << std::endl;
+		if ( !file )
+		{
+			std::cout << "App::BenchmarkJobs: could not write '" << options.reportPath << "'" << std::endl;
+			return Failure;
+		}
+	}
+
+	return Success;
+}
+
+// Draws a fixed set of frames through the shaders and through SoftwareWater,
+// checks that they agree and times both, so a change to either one gets noticed
+// Meant to run with --headless on llvmpipe, but a window works too
+int App::RunGolden()
 {
-	SDL_Init( SDL_INIT_VIDEO | SDL_INIT_EVENTS );
+	struct GoldenCase
+	{
+		float time;
+		int upperIndex;
+		int lowerIndex;
+		bool fixFogIndex;
+	};
+
+	// The start, some awkward times, exactly one ripple cycle (128 ticks), a long run,
+	// and thresholds that let everything or nothing through
+	const GoldenCase cases[] =
+	{
+		{ 0.0f, 192, 20, true },
+		{ 0.37f, 192, 20, true },
+		{ 1.0f, 192, 20, false },
+		{ 6.4f, 192, 20, true },
+		{ 13.55f, 255, 0, true },
+		{ 27.1f, 128, 64, false },
+		{ 100.0f, 64, 32, true },
+		{ 250.05f, 0, 255, true }
+	};
+
+	// Both sides take the fastest of these, which is the least noisy
+	constexpr int Repetitions = 5;
+
+	const size_t numPixels = size_t( renderWidth ) * renderHeight;
+	std::vector<uint8_t> gpuIndices( numPixels );
+	std::vector<uint8_t> cpuIndices( numPixels );
+	std::vector<uint8_t> gpuColours( numPixels * 3U );
+	std::vector<uint8_t> cpuColours( numPixels * 3U );
+	const PaletteBuffer palette = texture.GetPalette();
+
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+
+	std::string caseReports;
+	int numFailed = 0;
+	double totalGpuMs = 0.0;
+	double totalCpuMs = 0.0;
+
+	for ( const GoldenCase& golden : cases )
 	{
+		TRACE_SCOPE( "GoldenCase" );
+
+		animationTime = golden.time;
+		scene3D = false;
+		upperIndex = golden.upperIndex;
+		lowerIndex = golden.lowerIndex;
+		fixFogIndex = golden.fixFogIndex;
+		debugIndices = false;
+
+		// Indices first, they're what gets compared exactly, and what's timed
+		outputIndices = true;
+		if ( !UseShaderVariant() )
+		{
+			return Failure;
+		}
+
+		// Wall-clock time up to glFinish rather than a timer query; llvmpipe rasterises
+		// after the query has already ended, so its queries come out far too short
+		glFinish();
+		double gpuMs = 1.0e9;
+		for ( int i = 0; i < Repetitions; i++ )
+		{
+			const auto start = FrameStats::Clock::now();
+			BindWater();
+			DrawWater();
+			glFinish();
+			const std::chrono::duration<double, std::milli> elapsed = FrameStats::Clock::now() - start;
+			gpuMs = std::min( gpuMs, elapsed.count() );
+		}
+		glReadPixels( 0, 0, renderWidth, renderHeight, GL_RED, GL_UNSIGNED_BYTE, gpuIndices.data() );
+
+		// Then the colours, which checks the palette lookup as well
+		outputIndices = false;
+		if ( !UseShaderVariant() )
+		{
+			return Failure;
+		}
+
+		BindWater();
+		DrawWater();
+		glReadPixels( 0, 0, renderWidth, renderHeight, GL_RGB, GL_UNSIGNED_BYTE, gpuColours.data() );
+
+		WaterParameters parameters;
+		parameters.time = golden.time;
+		parameters.upperIndex = golden.upperIndex;
+		parameters.lowerIndex = golden.lowerIndex;
+		parameters.fixFogIndex = golden.fixFogIndex;
+
+		double cpuMs = 1.0e9;
+		for ( int i = 0; i < Repetitions; i++ )
+		{
+			const auto start = FrameStats::Clock::now();
+			SoftwareWater::RenderIndices( cpuTexture, parameters, renderWidth, renderHeight, cpuIndices.data() );
+			const std::chrono::duration<double, std::milli> elapsed = FrameStats::Clock::now() - start;
+			cpuMs = std::min( cpuMs, elapsed.count() );
+		}
+		SoftwareWater::ExpandPalette( palette, cpuIndices.data(), numPixels, cpuColours.data() );
+
+		const size_t mismatches = ImageCompare::CountMismatches( gpuIndices.data(), cpuIndices.data(), numPixels );
+		const double mismatchFraction = double( mismatches ) / double( numPixels );
+		const double psnr = ImageCompare::Psnr( gpuColours.data(), cpuColours.data(), numPixels * 3U );
+		const bool passed = mismatchFraction <= options.maxMismatch && psnr >= options.minPsnr;
+
+		numFailed += passed ? 0 : 1;
+		totalGpuMs += gpuMs;
+		totalCpuMs += cpuMs;
+
+		printf( "Golden: time %.2f, indices %i-%i, fog fix %s: %zu of %zu indices differ, PSNR %.2f dB, GPU %.3f ms, CPU %.3f ms -> %s\n",
+			golden.time, golden.lowerIndex, golden.upperIndex, golden.fixFogIndex ? "on" : "off",
+			mismatches, numPixels, psnr, gpuMs, cpuMs, passed ? "OK" : "FAILED" );
+
+		char caseReport[256];
+		snprintf( caseReport, sizeof( caseReport ),
+			"%s{\"time\":%.4f,\"upperIndex\":%i,\"lowerIndex\":%i,\"fixFogIndex\":%s,"
+			"\"mismatches\":%zu,\"psnr\":%.3f,\"gpuMs\":%.4f,\"cpuMs\":%.4f,\"passed\":%s}",
+			caseReports.empty() ? "" : ",",
+			golden.time, golden.upperIndex, golden.lowerIndex, golden.fixFogIndex ? "true" : "false",
+			mismatches, psnr, gpuMs, cpuMs, passed ? "true" : "false" );
+		caseReports += caseReport;
+	}
+
+	// Texture is passed around by value, so its guard band has to come through copies intact
+	// A few at once, so they don't all land at the same offset from a 64-byte boundary
+	if ( !cpuTexture.GetGuardBand().IsEmpty() )
+	{
+		std::vector<Texture> copies( 8, cpuTexture );
+		copies.push_back( TextureSwizzle::Convert( cpuTexture, TextureLayout::RowMajor ) );
+		copies.front() = copies.back();
+
+		int badCopies = 0;
+		for ( const Texture& copy : copies )
+		{
+			badCopies += copy.GetGuardBand().HasSameTexels( cpuTexture.GetGuardBand() ) ? 0 : 1;
+		}
+
+		numFailed += badCopies == 0 ? 0 : 1;
+		printf( "Golden: %i of %zu guard band copies read differently -> %s\n",
+			badCopies, copies.size(), badCopies == 0 ? "OK" : "FAILED" );
+	}
+
+	char summary[256];
+	snprintf( summary, sizeof( summary ),
+		"\"failed\":%i,\"width\":%i,\"height\":%i,\"maxMismatch\":%.6f,\"minPsnr\":%.2f,\"gpuMs\":%.4f,\"cpuMs\":%.4f",
+		numFailed, renderWidth, renderHeight, options.maxMismatch, options.minPsnr, totalGpuMs, totalCpuMs );
+
+	// On a line of its own, like the benchmark report
+	const std::string report = std::string( "{" ) + summary + ",\"cases\":[" + caseReports + "]}";
+	std::cout << report << std::endl;
+
+	if ( !options.reportPath.empty() )
+	{
+		std::ofstream file( options.reportPath, std::ios::binary );
+		file << report << std::endl;
+		if ( !file )
+		{
+			std::cout << "App::RunGolden: could not write '" << options.reportPath << "'" << std::endl;
+			return Failure;
+		}
+	}
+
+	return numFailed == 0 ? Success : Failure;
+}
+
+bool App::CreateContext()
+{
+	if ( options.headless )
+	{
+		TRACE_SCOPE( "CreateHeadlessContext" );
+
+		if ( !headlessContext.Create() )
+		{
+			return false;
+		}
+	}
+	else
+	{
+		{
+			TRACE_SCOPE( "SDL_Init" );
+			SDL_Init( SDL_INIT_VIDEO | SDL_INIT_EVENTS );
+		}
+
+		TRACE_SCOPE( "CreateWindow" );
+
 		SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
 		SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 3 );
 		SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE );
 
-		SDL_GL_SetSwapInterval( 1 );
-
 		window = SDL_CreateWindow( "SWater", 
 			SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-			1024, 1024, SDL_WINDOW_OPENGL );
+			options.width, options.height, SDL_WINDOW_OPENGL );
+
+		glContext = SDL_GL_CreateContext( window );
+		if ( glContext == nullptr )
+		{
+			std::cout << "App::CreateContext: " << SDL_GetError() << std::endl;
+			return false;
+		}
+
+		// This only does anything once there's a context
+		SDL_GL_SetSwapInterval( options.vsync ? 1 : 0 );
+	}
+
+	{
+		TRACE_SCOPE( "glewInit" );
+
+		auto errorCode = glewInit();
+		// GLEW loads the GL functions just fine, then goes looking for GLX, which an EGL context doesn't have
+		if ( options.headless && errorCode == GLEW_ERROR_NO_GLX_DISPLAY )
+		{
+			errorCode = GLEW_OK;
+		}
+
+		if ( errorCode != GLEW_OK )
+		{
+			const unsigned char* errorString = glewGetErrorString( errorCode );
+			std::cout << "GLEW Error: " << errorString << std::endl;
+			return false;
+		}
+	}
+
+	if ( options.headless )
+	{
+		if ( !headlessContext.CreateFramebuffer( options.width, options.height ) )
+		{
+			return false;
+		}
+
+		headlessContext.BindFramebuffer();
+		renderWidth = options.width;
+		renderHeight = options.height;
+	}
+	else
+	{
+		// Might differ from the window size on high-DPI screens
+		SDL_GL_GetDrawableSize( window, &renderWidth, &renderHeight );
+	}
+
+	glViewport( 0, 0, renderWidth, renderHeight );
+
+	std::cout << "App::CreateContext: " << glGetString( GL_RENDERER ) << ", " << glGetString( GL_VERSION ) << std::endl;
+	return true;
+}
+
+bool App::ReachedRunLimit() const
+{
+	if ( options.frames > 0 && frameCount >= options.frames )
+	{
+		return true;
+	}
+
+	const std::chrono::duration<float> elapsed = FrameStats::Clock::now() - runStart;
+	return options.seconds > 0.0f && elapsed.count() >= options.seconds;
+}
+
+// Benchmarks and anything else that wants to be reproducible use a fixed timestep,
+// everything else follows the wall clock so the animation speed doesn't depend on the frame rate
+void App::AdvanceTime()
+{
+	if ( options.timestep > 0.0f )
+	{
+		frameDeltaTime = options.timestep;
+		animationTime += options.timestep;
+		return;
+	}
+
+	const auto now = FrameStats::Clock::now();
+	const std::chrono::duration<float> delta = now - lastAnimationUpdate;
+	lastAnimationUpdate = now;
+
+	frameDeltaTime = delta.count();
+	animationTime += delta.count();
+}
+
+// WASD and mouse look while the right mouse button is held, Space and Ctrl go up and down
+void App::UpdateCamera( const CameraInput& mouseInput )
+{
+	if ( !scene3D )
+	{
+		return;
+	}
+
+	CameraInput input = mouseInput;
+
+	// Typing into the GUI shouldn't fly the camera around
+	const bool guiWantsKeyboard = initialisedGui && ImGui::GetIO().WantCaptureKeyboard;
+	if ( window != nullptr && !guiWantsKeyboard )
+	{
+		const Uint8* keys = SDL_GetKeyboardState( nullptr );
+		input.forward = float( keys[SDL_SCANCODE_W] ) - float( keys[SDL_SCANCODE_S] );
+		input.right = float( keys[SDL_SCANCODE_D] ) - float( keys[SDL_SCANCODE_A] );
+		input.up = float( keys[SDL_SCANCODE_SPACE] ) - float( keys[SDL_SCANCODE_LCTRL] );
+		input.fast = keys[SDL_SCANCODE_LSHIFT] != 0;
+	}
+
+	camera.Update( frameDeltaTime, input );
+}
+
+// Something has to keep drawing frames, or nothing would look any different without them
+bool App::NeedsContinuousFrames() const
+{
+	// A fixed timestep moves the animation per frame rather than per second, and recordings want every frame
+	if ( options.timestep > 0.0f || capture.IsCapturing() )
+	{
+		return true;
+	}
+
+	// New variants only get swapped in by a frame that polls for them
+	if ( shaderProvider.IsBuilding() || brushShaderProvider.IsBuilding() || feedbackShaderProvider.IsBuilding() )
+	{
+		return true;
+	}
+
+	// The view drifts, and there's feedback to read back every frame
+	if ( useVirtualTexture )
+	{
+		return true;
+	}
+
+	if ( scene3D )
+	{
+		// The warp is a sine of time, it never stands still
+		if ( vertexWarp || (!useAtlas && textureResidency.HasPendingUploads()) )
+		{
+			return true;
+		}
+
+		// Flying around, the keys are read every frame rather than through events
+		const Uint8* keys = SDL_GetKeyboardState( nullptr );
+		if ( SDL_GetRelativeMouseMode() || keys[SDL_SCANCODE_W] || keys[SDL_SCANCODE_A] || keys[SDL_SCANCODE_S]
+			|| keys[SDL_SCANCODE_D] || keys[SDL_SCANCODE_SPACE] || keys[SDL_SCANCODE_LCTRL] )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// For --on-demand: sleeps until the next frame would look any different from the last one,
+// which is when the ripples next move or an event comes in, or just the event while the window's hidden
+void App::WaitForChanges()
+{
+	TRACE_SCOPE( "WaitForChanges" );
+
+	// Events are left in the queue for ProcessEvents to pick up
+	if ( !windowVisible )
+	{
+		SDL_WaitEvent( nullptr );
+		return;
+	}
+
+	if ( pendingFrames > 0 )
+	{
+		pendingFrames--;
+		return;
+	}
+
+	if ( NeedsContinuousFrames() )
+	{
+		return;
+	}
+
+	// The ripples move in whole steps, rippleRate of them a second, so in between nothing does
+	const float rippleRate = WaterParameters().rippleRate;
+	const std::chrono::duration<float> sinceUpdate = FrameStats::Clock::now() - lastAnimationUpdate;
+	const float time = animationTime + sinceUpdate.count();
+
+	float untilStep = 0.0f;
+	if ( scene3D )
+	{
+		untilStep = scene.GetTimeUntilRippleStep( time, rippleRate );
+	}
+	else
+	{
+		untilStep = (std::floor( time * rippleRate ) + 1.0f) / rippleRate - time;
+	}
+
+	// Rounded up, waking a millisecond early would only draw the same frame again
+	const int timeout = int( std::ceil( untilStep * 1000.0f ) );
+	if ( timeout > 0 )
+	{
+		SDL_WaitEventTimeout( nullptr, timeout );
+	}
+}
+
+void App::ProcessEvents( CameraInput& mouseInput )
+{
+	SDL_Event ev;
+	while ( SDL_PollEvent( &ev ) )
+	{
+		// Anything at all could change what's on screen, if only because the GUI reacts to it
+		// A finished simulation step only needs the one frame to show it
+		if ( ev.type != simulationEventType )
+		{
+			pendingFrames = GuiSettleFrames;
+		}
+
+		if ( ev.type == SDL_QUIT )
+		{
+			run = false;
+			break;
+		}
+		// SDL2 doesn't say when a window is covered up, only minimised or hidden
+		else if ( ev.type == SDL_WINDOWEVENT )
+		{
+			if ( ev.window.event == SDL_WINDOWEVENT_MINIMIZED || ev.window.event == SDL_WINDOWEVENT_HIDDEN )
+			{
+				windowVisible = false;
+			}
+			else if ( ev.window.event == SDL_WINDOWEVENT_RESTORED || ev.window.event == SDL_WINDOWEVENT_SHOWN
+				|| ev.window.event == SDL_WINDOWEVENT_MAXIMIZED || ev.window.event == SDL_WINDOWEVENT_EXPOSED )
+			{
+				windowVisible = true;
+			}
+		}
+		// Hold the right mouse button to look around in 3D
+		else if ( (ev.type == SDL_MOUSEBUTTONDOWN || ev.type == SDL_MOUSEBUTTONUP)
+			&& ev.button.button == SDL_BUTTON_RIGHT && scene3D )
+		{
+			SDL_SetRelativeMouseMode( ev.type == SDL_MOUSEBUTTONDOWN ? SDL_TRUE : SDL_FALSE );
+		}
+		else if ( ev.type == SDL_MOUSEMOTION && SDL_GetRelativeMouseMode() )
+		{
+			mouseInput.lookX += float( ev.motion.xrel );
+			mouseInput.lookY += float( ev.motion.yrel );
+		}
+		// Drags the virtual texture along with the mouse, GL's y goes up
+		else if ( ev.type == SDL_MOUSEMOTION && useVirtualTexture && (ev.motion.state & SDL_BUTTON_LMASK)
+			&& !(initialisedGui && ImGui::GetIO().WantCaptureMouse) )
+		{
+			virtualPanX -= ev.motion.xrel;
+			virtualPanY += ev.motion.yrel;
+		}
+		// TODO: ImGui buttons'n'stuff so we can select other shaders
+		else if ( ev.type == SDL_KEYDOWN )
+		{
+			if ( ev.key.keysym.scancode == SDL_SCANCODE_R )
+			{
+				ReloadShaders();
+			}
+			else if ( ev.key.keysym.scancode == SDL_SCANCODE_T )
+			{
+				Trace::Export( "trace.json" );
+			}
+			else if ( ev.key.keysym.scancode == SDL_SCANCODE_C )
+			{
+				ToggleCapture();
+			}
+		}
+		else if ( ev.type == shaderChangeEventType )
+		{
+			std::cout << "App: shader files changed, reloading" << std::endl;
+			ReloadShaders();
+		}
+
+		if ( initialisedGui )
+		{
+			ImGui_ImplSDL2_ProcessEvent( &ev );
+		}
+	}
+}
+
+void App::RunFrame()
+{
+	TRACE_SCOPE( "RunFrame" );
+
+	frameStats.BeginFrame();
+
+	CameraInput mouseInput;
+
+	// No window, no events
+	if ( window != nullptr )
+	{
+		TRACE_SCOPE( "Events" );
+		ScopedCpuTimer timer( frameStats, FrameStats::CpuEvents );
+
+		ProcessEvents( mouseInput );
+	}
+
+	// Nothing to draw into, the events were all that needed doing
+	if ( onDemand && !windowVisible && !capture.IsCapturing() )
+	{
+		frameStats.EndFrame();
+		frameArena.Reset();
+		return;
+	}
+
+	AdvanceTime();
+	UpdateCamera( mouseInput );
+
+	{
+		TRACE_SCOPE( "Upload" );
+		ScopedCpuTimer timer( frameStats, FrameStats::CpuUpload );
+
+		// Swap in the reloaded shaders if they're done compiling
+		UpdateShaders();
+
+		// Streams in whatever the feedback from a frame or two ago asked for
+		if ( useVirtualTexture )
+		{
+			virtualTexture.Update();
+		}
+
+		BindWater();
+	}
+
+	{
+		TRACE_SCOPE( "Draw" );
+		ScopedGpuTimer timer( frameStats, FrameStats::GpuWater );
+
+		DrawWater();
+	}
+
+	// Before the GUI, so the overlay doesn't end up in the video
+	if ( capture.IsCapturing() )
+	{
+		ScopedCpuTimer timer( frameStats, FrameStats::CpuCapture );
+		capture.CaptureFrame();
+	}
+
+	RunGui();
+
+	{
+		TRACE_SCOPE( "Swap" );
+		ScopedCpuTimer timer( frameStats, FrameStats::CpuSwap );
+		ScopedGpuTimer gpuTimer( frameStats, FrameStats::GpuSwap );
+
+		PresentFrame();
+	}
+
+	frameStats.EndFrame();
+	frameArena.Reset();
+}
+
+void App::BindWater()
+{
+	// Use the shader
+	glUseProgram( program.handle );
+
+	// Update the time and other things
+	glUniform1f( program.timeHandle, animationTime );
+	glUniform1i( program.upperIndexHandle, upperIndex );
+	glUniform1i( program.lowerIndexHandle, lowerIndex );
+	glUniform1i( program.textureWidthHandle, texture.GetWidth() );
+	glUniform1i( program.textureHeightHandle, texture.GetHeight() );
+
+	if ( useVirtualTexture )
+	{
+		int originX = 0;
+		int originY = 0;
+		GetVirtualOrigin( originX, originY );
+		glUniform2i( program.virtualOriginHandle, originX, originY );
+		glUniform1i( program.virtualScaleHandle, 1 );
+
+		virtualTexture.Bind( GL_TEXTURE0, GL_TEXTURE1, GL_TEXTURE4 );
+		return;
+	}
+
+	// Bind the textures
+	glActiveTexture( GL_TEXTURE0 );
+	if ( cpuWater && !scene3D )
+	{
+		UpdateSimulation();
+		glBindTexture( GL_TEXTURE_2D, cpuFrameTextureHandle );
+	}
+	else
+	{
+		glBindTexture( GL_TEXTURE_2D, textureHandle );
+	}
+	glActiveTexture( GL_TEXTURE1 );
+	glBindTexture( GL_TEXTURE_2D, paletteTextureHandle );
+}
+
+void App::DrawWater()
+{
+	glClearColor( 0.05f, 0.15f, 0.15f, 1.0f );
+	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+
+	if ( scene3D )
+	{
+		DrawScene();
+		return;
+	}
+
+	// Render go brr
+	glBindVertexArray( vertexArrayHandle );
+	glDrawElements( GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr );
+
+	if ( useVirtualTexture )
+	{
+		DrawVirtualFeedback();
+	}
+}
+
+// The same quad again, tiny, with the variant that draws which page each pixel reads
+// Expects the quad's vertex array to be bound already
+void App::DrawVirtualFeedback()
+{
+	TRACE_SCOPE( "DrawVirtualFeedback" );
+
+	int originX = 0;
+	int originY = 0;
+	GetVirtualOrigin( originX, originY );
+	// A feedback pixel covers FeedbackScale texels each way, so it samples somewhere
+	// else in them every frame, or thin slivers of pages at the edges could be missed
+	const int jitterX = (frameCount * 5) % VirtualTexture::FeedbackScale;
+	const int jitterY = (frameCount * 3) % VirtualTexture::FeedbackScale;
+
+	virtualTexture.BeginFeedback();
+
+	glUseProgram( feedbackProgram.handle );
+	glUniform1f( feedbackProgram.timeHandle, animationTime );
+	glUniform2i( feedbackProgram.virtualOriginHandle, originX + jitterX, originY + jitterY );
+	glUniform1i( feedbackProgram.virtualScaleHandle, VirtualTexture::FeedbackScale );
+	glUniform1i( feedbackProgram.feedbackFrameHandle, frameCount );
+	glDrawElements( GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr );
+
+	virtualTexture.EndFeedback();
+}
+
+// Wrapped into the texture here, so the shader only has to wrap what the ripples push below zero
+void App::GetVirtualOrigin( int& outX, int& outY ) const
+{
+	const int width = int( virtualTexture.GetWidth() );
+	const int height = int( virtualTexture.GetHeight() );
+	const int x = int( animationTime * float( VirtualDriftX ) ) + virtualPanX;
+	const int y = int( animationTime * float( VirtualDriftY ) ) + virtualPanY;
+
+	outX = (x % width + width) % width;
+	outY = (y % height + height) % height;
+}
+
+// Expects the water program to be bound already, like DrawWater
+void App::DrawScene()
+{
+	TRACE_SCOPE( "DrawScene" );
+
+	const Mat4 viewProjection = camera.GetViewProjection( float( renderWidth ) / float( renderHeight ) );
+	Scene::WaterDetail waterDetail = Scene::WaterDetail::Flat;
+	if ( vertexWarp )
+	{
+		waterDetail = adaptiveSubdivision ? Scene::WaterDetail::Adaptive : Scene::WaterDetail::Subdivided;
+	}
+	scene.Cull( Frustum( viewProjection ), camera.position, waterDetail );
+
+	glEnable( GL_DEPTH_TEST );
+
+	glUniformMatrix4fv( program.viewProjectionHandle, 1, GL_FALSE, viewProjection.m );
+	if ( useAtlas )
+	{
+		atlas.Bind( GL_TEXTURE2, GL_TEXTURE3 );
+		scene.DrawWater( program, animationTime, &atlas );
+	}
+	else
+	{
+		// What a pixel covers 1 unit away, the top of the view is tan( fov / 2 ) units up
+		const float texelsPerPixel = 2.0f * std::tan( camera.fieldOfView * 0.5f * 3.14159265f / 180.0f ) / float( renderHeight );
+		scene.RequestWaterTextures( textureResidency, texelsPerPixel );
+		textureResidency.Update( frameArena );
+		scene.DrawWater( program, animationTime, nullptr, &textureResidency );
+	}
+
+	glUseProgram( brushProgram.handle );
+	glUniformMatrix4fv( brushProgram.viewProjectionHandle, 1, GL_FALSE, viewProjection.m );
+	scene.DrawBrushes();
+
+	glDisable( GL_DEPTH_TEST );
+}
+
+void App::PresentFrame()
+{
+	if ( !options.outputPrefix.empty() && frameCount % options.outputEvery == 0 )
+	{
+		WriteFrame();
+	}
+
+	if ( window != nullptr )
+	{
+		SDL_GL_SwapWindow( window );
+	}
+	else
+	{
+		// There's no swap to kick the GPU along, so do it here
+		glFlush();
+	}
+}
+
+// Reads back whatever was just drawn, from the back buffer or the headless FBO
+void App::WriteFrame()
+{
+	TRACE_SCOPE( "WriteFrame" );
+
+	outputPixels.resize( size_t( renderWidth ) * renderHeight * 3U );
+
+	// Rows of RGB aren't 4-byte aligned unless the width happens to line up
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+	glReadPixels( 0, 0, renderWidth, renderHeight, GL_RGB, GL_UNSIGNED_BYTE, outputPixels.data() );
+
+	char path[512];
+	snprintf( path, sizeof( path ), "%s%05i.ppm", options.outputPrefix.c_str(), outputFrameCount );
+	outputFrameCount++;
+
+	ImageWriter::WritePpm( path, renderWidth, renderHeight, outputPixels.data(), true );
+}
+
+// The ripples are worked out by SoftwareWater on its own thread, and frames just show the newest result
+void App::StartSimulation()
+{
+	if ( !cpuFrameTextureHandle )
+	{
+		glGenTextures( 1, &cpuFrameTextureHandle );
+		glBindTexture( GL_TEXTURE_2D, cpuFrameTextureHandle );
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_R8, renderWidth, renderHeight, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+	}
+
+	// Wakes up --on-demand as soon as there's something new to show
+	std::function<void()> onFrameReady;
+	if ( window != nullptr )
+	{
+		if ( simulationEventType == 0 )
+		{
+			simulationEventType = SDL_RegisterEvents( 1 );
+		}
+
+		const Uint32 eventType = simulationEventType;
+		onFrameReady = [eventType]()
+		{
+			SDL_Event ev{};
+			ev.type = eventType;
+			SDL_PushEvent( &ev );
+		};
+	}
+
+	simulation.Start( cpuTexture, renderWidth, renderHeight, onFrameReady );
+}
+
+void App::UpdateSimulation()
+{
+	WaterParameters parameters;
+	parameters.time = animationTime;
+	parameters.upperIndex = upperIndex;
+	parameters.lowerIndex = lowerIndex;
+	parameters.fixFogIndex = fixFogIndex;
+	simulation.SetParameters( parameters );
+
+	bool newFrame = simulation.Update();
+
+	// Headless frames get compared against each other, so there it waits for the exact frame,
+	// with a window it keeps showing the last one until the next is done
+	while ( window == nullptr && !(simulation.HasFrame() && WaterSimulation::ShowSameFrame( simulation.GetFrame().parameters, parameters )) )
+	{
+		std::this_thread::yield();
+		newFrame |= simulation.Update();
+	}
+
+	if ( newFrame )
+	{
+		TRACE_SCOPE( "UploadSimulationFrame" );
+
+		glBindTexture( GL_TEXTURE_2D, cpuFrameTextureHandle );
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, renderWidth, renderHeight, GL_RED, GL_UNSIGNED_BYTE, simulation.GetFrame().indices.data() );
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	}
+}
+
+void App::ToggleCapture()
+{
+	if ( capture.IsCapturing() )
+	{
+		capture.Stop();
+		return;
+	}
+
+	// A fixed timestep plays back at the speed it was simulated at
+	// Rounds to 0 past a 2 s timestep, and F0:1 isn't a valid Y4M header
+	const int framesPerSecond = options.timestep > 0.0f ? std::max( 1, int( 1.0f / options.timestep + 0.5f ) ) : 60;
+	const char* path = options.capturePath.empty() ? "capture.y4m" : options.capturePath.c_str();
+
+	capture.Start( path, renderWidth, renderHeight, framesPerSecond );
+}
+
+void App::RunGui()
+{
+	if ( !initialisedGui )
+	{
+		return;
+	}
+
+	{
+		TRACE_SCOPE( "BuildGui" );
+		ScopedCpuTimer timer( frameStats, FrameStats::CpuGui );
+
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplSDL2_NewFrame();
+		ImGui::NewFrame();
+
+		BuildGui();
+
+		ImGui::Render();
+	}
+
+	TRACE_SCOPE( "RenderGui" );
+	ScopedGpuTimer timer( frameStats, FrameStats::GpuGui );
+	ImGui_ImplOpenGL3_RenderDrawData( ImGui::GetDrawData() );
+}
+
+void App::BuildGui()
+{
+
+	ImGui::Begin( "Settings" );
 
-		glContext = SDL_GL_CreateContext( window );
+	if ( ImGui::Button( "Reload shaders" ) )
+	{
+		ReloadShaders();
+	}
 
-		auto errorCode = glewInit();
-		if ( errorCode != GLEW_OK )
-		{
-			const unsigned char* errorString = glewGetErrorString( errorCode );
-			std::cout << "GLEW Error: " << errorString << std::endl;
-			return Shutdown( Failure );
-		}
+	if ( shaderProvider.IsBuilding() )
+	{
+		ImGui::SameLine();
+		ImGui::TextUnformatted( "Compiling..." );
 	}
 
-	// GUI is optional, you can reload shaders with R
-	CreateGui();
+	ImGui::Checkbox( "Draw only when something changes", &onDemand );
 
-	if ( !CreateShaders() )
-		return Shutdown( Failure );
+	ImGui::SliderInt( "Upper index", &upperIndex, 0, 255 );
+	ImGui::SliderInt( "Lower index", &lowerIndex, 0, 255 );
 
-	if ( !CreateTexture() )
-		return Shutdown( Failure );
+	// Each of these picks a different shader variant
+	bool variantChanged = false;
+	variantChanged |= ImGui::Checkbox( "Fix fog index", &fixFogIndex );
+	variantChanged |= ImGui::Checkbox( "Debug indices", &debugIndices );
+	if ( variantChanged )
+	{
+		SelectShaderVariant();
+	}
 
-	if ( !CreateGeometry() )
-		return Shutdown( Failure );
+	ImGui::Text( "Shader variants: %i, shader objects: %i", int( shaderProvider.GetNumVariants() ), int( shaderProvider.GetNumShaderObjects() ) );
 
-	while ( run )
+	if ( useVirtualTexture )
 	{
-		RunFrame();
+		ImGui::TextUnformatted( "Drag with the left mouse button to move around" );
+		ImGui::Text( "Virtual texture: %ux%u, %i of %i pages resident, %i missing", virtualTexture.GetWidth(), virtualTexture.GetHeight(),
+			virtualTexture.GetNumResidentPages(), virtualTexture.GetNumPages(), virtualTexture.GetNumMissingPages() );
+		ImGui::Text( "Pages streamed in: %i, evicted: %i, %i KB on the GPU", virtualTexture.GetNumUploads(),
+			virtualTexture.GetNumEvictions(), int( virtualTexture.GetResidentBytes() / 1024 ) );
+		ImGui::Text( "Feedback frames dropped: %i", virtualTexture.GetNumDroppedFeedbacks() );
+	}
+	else if ( ImGui::Checkbox( "3D scene", &scene3D ) )
+	{
+		SelectShaderVariant();
 	}
 
-	return Shutdown( Success );
-}
-
-void App::RunFrame()
-{
-	SDL_Event ev;
-	while ( SDL_PollEvent( &ev ) )
+	if ( scene3D )
 	{
-		if ( ev.type == SDL_QUIT )
+		ImGui::TextUnformatted( "Hold right mouse to look, WASD to fly" );
+		ImGui::Text( "Water surfaces: %i of %i visible", int( scene.GetNumVisibleWaterSurfaces() ), int( scene.GetNumWaterSurfaces() ) );
+		ImGui::Text( "Brushes: %i of %i visible", int( scene.GetNumVisibleBrushes() ), int( scene.GetNumBrushes() ) );
+		ImGui::Text( "BVH nodes tested: %i", scene.GetNumNodesTested() );
+
+		if ( ImGui::Checkbox( "Warp per vertex (GLQuake)", &vertexWarp ) )
 		{
-			run = false;
-			break;
+			SelectShaderVariant();
 		}
-		// TODO: ImGui buttons'n'stuff so we can select other shaders
-		else if ( ev.type == SDL_KEYDOWN )
+
+		if ( vertexWarp )
 		{
-			if ( ev.key.keysym.scancode == SDL_SCANCODE_R )
-			{
-				ReloadShaders();
-			}
+			ImGui::Checkbox( "Coarser when far away", &adaptiveSubdivision );
 		}
 
-		ImGui_ImplSDL2_ProcessEvent( &ev );
-	}
+		ImGui::Text( "Water vertices drawn: %i", scene.GetNumWaterVerticesDrawn() );
+		ImGui::Text( "Water ACMR: %.3f, %.3f unoptimised", scene.GetWaterCacheMissRatio( true ), scene.GetWaterCacheMissRatio( false ) );
 
-	static float time = 0.0f;
-	time += 0.016f;
+		if ( atlas.IsUploaded() )
+		{
+			if ( ImGui::Checkbox( "Texture atlas", &useAtlas ) )
+			{
+				SelectShaderVariant();
+			}
 
-	glClearColor( 0.05f, 0.15f, 0.15f, 1.0f );
-	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+			ImGui::Text( "Atlas: %i textures, %i page(s), %i palette(s), %.0f%% occupied", int( atlas.GetNumRegions() ),
+				atlas.GetNumPages(), atlas.GetNumPalettes(), atlas.GetOccupancy() * 100.0f );
+		}
 
-	// Use the shader
-	glUseProgram( gpuProgramHandle );
-	
-	// Update the time and other things
-	glUniform1f( shaderTimeHandle, time );
-	glUniform1i( upperIndexHandle, upperIndex );
-	glUniform1i( lowerIndexHandle, lowerIndex );
-	glUniform1i( textureWidthHandle, texture.GetWidth() );
-	glUniform1i( textureHeightHandle, texture.GetHeight() );
+		if ( !useAtlas )
+		{
+			int budget = int( textureResidency.GetBudget() / 1024 );
+			if ( ImGui::SliderInt( "Texture budget (KB)", &budget, 16, int( textureResidency.GetTotalBytes() / 1024 ) + 1 ) )
+			{
+				textureResidency.SetBudget( size_t( budget ) * 1024 );
+			}
 
-	// Bind the textures
-	glActiveTexture( GL_TEXTURE0 );
-	glBindTexture( GL_TEXTURE_2D, textureHandle );
-	glActiveTexture( GL_TEXTURE1 );
-	glBindTexture( GL_TEXTURE_2D, paletteTextureHandle );
+			ImGui::Text( "Resident: %i of %i KB, %i of %i textures sharp enough", int( textureResidency.GetResidentBytes() / 1024 ),
+				int( textureResidency.GetTotalBytes() / 1024 ), textureResidency.GetNumSatisfied(), int( textureResidency.GetNumTextures() ) );
+			ImGui::Text( "Levels streamed in: %i, evicted: %i", textureResidency.GetNumUploads(), textureResidency.GetNumEvictions() );
+		}
+	}
 
-	// Render go brr
-	glBindVertexArray( vertexArrayHandle );
-	glDrawElements( GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr );
+	if ( !scene3D && !useVirtualTexture )
+	{
+		if ( ImGui::Checkbox( "Ripples on the CPU", &cpuWater ) )
+		{
+			if ( cpuWater )
+			{
+				StartSimulation();
+			}
+			else
+			{
+				simulation.Stop();
+			}
+			SelectShaderVariant();
+		}
 
-	RunGui();
+		if ( cpuWater )
+		{
+			ImGui::Text( "Simulation: %.2f ms a step, %i steps, %i never shown", simulation.GetStepMilliseconds(),
+				simulation.GetNumFramesSimulated(), simulation.GetNumFramesDropped() );
+		}
+	}
 
-	SDL_GL_SwapWindow( window );
-}
+	frameStats.DrawGui();
 
-void App::RunGui()
-{
-	if ( !initialisedGui )
+	ImGui::Text( "Frame arena: %i of %i KB at most, %i spills", int( frameArena.GetPeak() / 1024 ),
+		int( frameArena.GetCapacity() / 1024 ), frameArena.GetNumSpills() );
+	if ( Allocations::Enabled )
 	{
-		return;
+		ImGui::Text( "Heap allocations: %llu on this thread, %llu in all", (unsigned long long)Allocations::GetThreadCount(),
+			(unsigned long long)Allocations::GetCount() );
 	}
 
-	ImGui_ImplOpenGL3_NewFrame();
-	ImGui_ImplSDL2_NewFrame();
-	ImGui::NewFrame();
-
-	ImGui::Begin( "Settings" );
-
-	if ( ImGui::Button( "Reload shaders" ) )
+	// Same as pressing C
+	if ( ImGui::Button( capture.IsCapturing() ? "Stop recording" : "Start recording" ) )
 	{
-		ReloadShaders();
+		ToggleCapture();
 	}
 
-	ImGui::SliderInt( "Upper index", &upperIndex, 0, 255 );
-	ImGui::SliderInt( "Lower index", &lowerIndex, 0, 255 );
+#if SWATER_TRACING
+	// Same as pressing T
+	if ( ImGui::Button( "Export trace" ) )
+	{
+		Trace::Export( "trace.json" );
+	}
+#endif
 
 	ImGui::End();
-
-	ImGui::Render();
-	ImGui_ImplOpenGL3_RenderDrawData( ImGui::GetDrawData() );
 }
 
 bool App::CreateGui()
@@ -195,8 +1346,8 @@ bool App::CreateGui()
 
 	auto& io = ImGui::GetIO();
 
-	io.DisplaySize.x = 1024.0f;
-	io.DisplaySize.y = 1024.0f;
+	io.DisplaySize.x = float( renderWidth );
+	io.DisplaySize.y = float( renderHeight );
 
 	if ( !ImGui_ImplOpenGL3_Init( "#version 330 core" ) )
 	{
@@ -215,103 +1366,268 @@ bool App::CreateGui()
 }
 
 // Just a vertex and fragment shader, nothing special
+// The first build has nothing to fall back to, so it waits for the driver
 bool App::CreateShaders()
 {
-	const auto loadShaderFromFile = []( const char* filePath, std::string& str )
+	StartShaderCompileThread();
+
+	shaderProvider.Init( "vertexShader.glsl", "pixelShader.glsl", &shaderCompileThread );
+	brushShaderProvider.Init( "vertexShader.glsl", "brushShader.glsl", &shaderCompileThread );
+
+	// Brushes only have the one variant, so it's built up front
+	if ( !brushShaderProvider.Request( GetBrushShaderDefines(), brushProgram )
+		&& brushShaderProvider.Poll( brushProgram, true ) != ShaderProvider::BuildStatus::Succeeded )
 	{
-		std::ifstream file( filePath );
+		return false;
+	}
 
-		if ( !file )
+	// So does the virtual texture's feedback pass
+	if ( useVirtualTexture )
+	{
+		feedbackShaderProvider.Init( "vertexShader.glsl", "pixelShader.glsl", &shaderCompileThread );
+		if ( !feedbackShaderProvider.Request( GetFeedbackShaderDefines(), feedbackProgram )
+			&& feedbackShaderProvider.Poll( feedbackProgram, true ) != ShaderProvider::BuildStatus::Succeeded )
 		{
-			std::cout << "CreateShaders: '" << filePath << "' does not exist" << std::endl;
 			return false;
 		}
+	}
 
-		std::string temp;
-		while ( std::getline( file, temp ) )
-		{
-			str += temp + "\n";
-		}
+	return UseShaderVariant();
+}
 
-		return true;
-	};
+// Without parallel compile, the driver does its work in whichever thread calls it, so
+// give it one that isn't drawing frames, with a second context that sees the same objects
+// If that doesn't work out, the providers do it all here like before
+void App::StartShaderCompileThread()
+{
+	if ( GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile )
+	{
+		return;
+	}
 
-	std::string vertexShaderCode;
-	if ( !loadShaderFromFile( "vertexShader.glsl", vertexShaderCode ) )
+	if ( options.headless )
 	{
-		return false;
+		compileContext = headlessContext.CreateSharedContext();
+		if ( compileContext == nullptr )
+		{
+			return;
+		}
+
+		void* context = compileContext;
+		shaderCompileThread.Start(
+			[this, context]() { return headlessContext.MakeCurrent( context ); },
+			[this]() { headlessContext.MakeCurrent( nullptr ); } );
+		return;
 	}
 
-	std::string fragmentShaderCode;
-	if ( !loadShaderFromFile( "pixelShader.glsl", fragmentShaderCode ) )
+	// SDL makes the new context current, so the main one has to be put back afterwards
+	SDL_GL_SetAttribute( SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1 );
+	SDL_GLContext context = SDL_GL_CreateContext( window );
+	SDL_GL_SetAttribute( SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0 );
+	SDL_GL_MakeCurrent( window, glContext );
+	if ( context == nullptr )
 	{
-		return false;
+		std::cout << "App::StartShaderCompileThread: couldn't create a shared context: " << SDL_GetError() << std::endl;
+		return;
 	}
 
-	const char* vertexShaderString = vertexShaderCode.c_str();
-	const char* fragmentShaderString = fragmentShaderCode.c_str();
+	compileContext = context;
+	shaderCompileThread.Start(
+		[this, context]() { return SDL_GL_MakeCurrent( window, context ) == 0; },
+		[this]() { SDL_GL_MakeCurrent( window, nullptr ); } );
+}
+
+// Kicks off a build in the background, the current program
+// keeps drawing until UpdateShaders swaps the new one in
+bool App::ReloadShaders()
+{
+	const bool brushesOkay = brushShaderProvider.Reload( GetBrushShaderDefines() );
+	const bool feedbackOkay = !useVirtualTexture || feedbackShaderProvider.Reload( GetFeedbackShaderDefines() );
+	return shaderProvider.Reload( GetShaderDefines() ) && brushesOkay && feedbackOkay;
+}
 
-	gpuProgramHandle = glCreateProgram();
-	GLuint vertexShaderHandle = glCreateShader( GL_VERTEX_SHADER );
-	GLuint fragmentShaderHandle = glCreateShader( GL_FRAGMENT_SHADER );
+void App::UpdateShaders()
+{
+	using BuildStatus = ShaderProvider::BuildStatus;
 
-	glShaderSource( vertexShaderHandle, 1, &vertexShaderString, nullptr );
-	glShaderSource( fragmentShaderHandle, 1, &fragmentShaderString, nullptr );
+	ShaderProgram newBrushProgram;
+	const BuildStatus brushStatus = brushShaderProvider.Poll( newBrushProgram );
+	if ( brushStatus == BuildStatus::Succeeded )
+	{
+		brushProgram = newBrushProgram;
+	}
 
-	// Compile le shadeurs
-	glCompileShader( vertexShaderHandle );
-	glCompileShader( fragmentShaderHandle );
+	ShaderProgram newFeedbackProgram;
+	const BuildStatus feedbackStatus = feedbackShaderProvider.Poll( newFeedbackProgram );
+	if ( feedbackStatus == BuildStatus::Succeeded )
+	{
+		feedbackProgram = newFeedbackProgram;
+	}
 
-	const char* errorMessage = GetShaderError( vertexShaderHandle, fragmentShaderHandle );
-	if ( nullptr != errorMessage )
+	ShaderProgram newProgram;
+	const BuildStatus status = shaderProvider.Poll( newProgram );
+	if ( status == BuildStatus::Succeeded )
 	{
-		std::cout << "Error while compiling: " << errorMessage << std::endl;
-		return false;
+		program = newProgram;
 	}
+	// Failed builds have already printed their error, the old program stays
 
-	glAttachShader( gpuProgramHandle, vertexShaderHandle );
-	glAttachShader( gpuProgramHandle, fragmentShaderHandle );
-	glLinkProgram( gpuProgramHandle );
+	// A finished build might have found new includes, failed ones too, since that's
+	// where the fix is going to be saved
+	// The feedback pass has the same files as the water, so it doesn't need watching on its own
+	if ( brushStatus == BuildStatus::Succeeded || brushStatus == BuildStatus::Failed
+		|| status == BuildStatus::Succeeded || status == BuildStatus::Failed )
+	{
+		WatchShaderFiles();
+	}
+}
 
-	glDeleteShader( vertexShaderHandle );
-	glDeleteShader( fragmentShaderHandle );
+// The watcher thread only posts an event, the reload itself happens on this thread in ProcessEvents
+void App::StartWatchingShaders()
+{
+	if ( shaderChangeEventType == 0 )
+	{
+		shaderChangeEventType = SDL_RegisterEvents( 1 );
+	}
 
-	shaderTimeHandle = glGetUniformLocation( gpuProgramHandle, "gTime" );
+	const Uint32 eventType = shaderChangeEventType;
+	const bool started = shaderWatcher.Start( [eventType]()
+	{
+		SDL_Event ev{};
+		ev.type = eventType;
+		SDL_PushEvent( &ev );
+	} );
 
-	glUseProgram( gpuProgramHandle );
+	if ( started )
+	{
+		WatchShaderFiles();
+	}
+}
 
-	GLuint diffuseMapHandle = glGetUniformLocation( gpuProgramHandle, "diffuseMap" );
-	GLuint paletteMapHandle = glGetUniformLocation( gpuProgramHandle, "paletteMap" );
+void App::WatchShaderFiles()
+{
+	if ( !shaderWatcher.IsRunning() )
+	{
+		return;
+	}
 
-	glUniform1i( diffuseMapHandle, 0 );
-	glUniform1i( paletteMapHandle, 1 );
+	std::vector<std::string> paths;
+	shaderProvider.GetSourceFiles( paths );
+	brushShaderProvider.GetSourceFiles( paths );
+	shaderWatcher.SetFiles( paths );
+}
 
-	upperIndexHandle = glGetUniformLocation( gpuProgramHandle, "gUpperIndex" );
-	lowerIndexHandle = glGetUniformLocation( gpuProgramHandle, "gLowerIndex" );
+// Switches right away if the variant was compiled before,
+// otherwise the current program stays until UpdateShaders gets the new one
+void App::SelectShaderVariant()
+{
+	shaderProvider.Request( GetShaderDefines(), program );
+}
 
-	textureWidthHandle = glGetUniformLocation( gpuProgramHandle, "gTextureWidth" );
-	textureHeightHandle = glGetUniformLocation( gpuProgramHandle, "gTextureHeight" );
+// Same, except it waits for the build so the variant is in use when this returns
+bool App::UseShaderVariant()
+{
+	if ( shaderProvider.Request( GetShaderDefines(), program ) )
+	{
+		return true;
+	}
 
-	return true;
+	return shaderProvider.Poll( program, true ) == ShaderProvider::BuildStatus::Succeeded;
 }
 
-bool App::ReloadShaders()
+ShaderDefines App::GetShaderDefines() const
 {
-	if ( gpuProgramHandle )
+	ShaderDefines defines;
+
+	const auto isPowerOfTwo = []( const uint32_t& value )
+	{
+		return value != 0 && (value & (value - 1)) == 0;
+	};
+
+	const bool atlasVariant = scene3D && useAtlas;
+	if ( useVirtualTexture )
 	{
-		glDeleteProgram( gpuProgramHandle );
-		gpuProgramHandle = 0;
+		// Streamed in a page at a time, it's wrapped by hand whatever the size
+		defines.Set( "TEXTURE_WIDTH", int( virtualTexture.GetWidth() ) );
+		defines.Set( "TEXTURE_HEIGHT", int( virtualTexture.GetHeight() ) );
+		defines.Set( "VIRTUAL_TEXTURE" );
+		defines.Set( "VIRTUAL_PAGE_SIZE", VirtualTexture::PageSize );
 	}
-	
-	// Let's get a black (or white on some GPUs) quad
-	// if the shader is wrong
-	if ( !CreateShaders() )
+	else
 	{
-		gpuProgramHandle = 0;
-		return false;
+		defines.Set( "TEXTURE_WIDTH", int( texture.GetWidth() ) );
+		defines.Set( "TEXTURE_HEIGHT", int( texture.GetHeight() ) );
+		// The atlas wraps inside each region by itself, the texture's own size doesn't matter there
+		if ( !atlasVariant && isPowerOfTwo( texture.GetWidth() ) && isPowerOfTwo( texture.GetHeight() ) )
+		{
+			defines.Set( "POW2_WRAP" );
+		}
 	}
 
-	return true;
+	if ( fixFogIndex )
+	{
+		defines.Set( "FIX_FOG_INDEX" );
+	}
+
+	if ( debugIndices )
+	{
+		defines.Set( "DEBUG_INDICES" );
+	}
+
+	if ( outputIndices )
+	{
+		defines.Set( "OUTPUT_INDICES" );
+	}
+
+	// SoftwareWater did all the rippling already, the shader only looks up colours
+	if ( cpuWater && !scene3D )
+	{
+		defines.Set( "CPU_INDICES" );
+	}
+
+	if ( scene3D )
+	{
+		defines.Set( "SCENE_3D" );
+
+		// Further away, the index texture's mips get sampled. The 2D view stays on level 0,
+		// which is what SoftwareWater draws too
+		// The atlas only has level 0 of everything, so it's one or the other
+		if ( atlasVariant )
+		{
+			defines.Set( "ATLAS" );
+		}
+		else
+		{
+			defines.Set( "PALETTE_MIPS", int( textureMips.size() ) );
+		}
+
+		// The screen-space quad only has 4 vertices, there'd be nothing to warp
+		if ( vertexWarp )
+		{
+			defines.Set( "VERTEX_WARP" );
+		}
+	}
+
+	return defines;
+}
+
+ShaderDefines App::GetBrushShaderDefines() const
+{
+	ShaderDefines defines;
+	defines.Set( "SCENE_3D" );
+	return defines;
+}
+
+// None of the effect options matter to which pages get read, so there's only the one variant
+ShaderDefines App::GetFeedbackShaderDefines() const
+{
+	ShaderDefines defines;
+	defines.Set( "TEXTURE_WIDTH", int( virtualTexture.GetWidth() ) );
+	defines.Set( "TEXTURE_HEIGHT", int( virtualTexture.GetHeight() ) );
+	defines.Set( "VIRTUAL_TEXTURE" );
+	defines.Set( "VIRTUAL_PAGE_SIZE", VirtualTexture::PageSize );
+	defines.Set( "VIRTUAL_FEEDBACK" );
+	return defines;
 }
 
 // Also taken from FoxGLBox
@@ -361,7 +1677,8 @@ void PrintTextureInfo( int textureDataType, int textureFormat )
 // 2. Upload to GPU as indices and a palette
 bool App::CreateTexture()
 {
-	const auto initialiseTexture = []( const char* textureName, GLuint& handle, const Texture& texture, const GLenum& target, bool indexed = false, bool mipmapping = true )
+	const auto initialiseTexture = []( const char* textureName, GLuint& handle, const Texture& texture, const GLenum& target, bool indexed = false, bool mipmapping = true,
+		const std::vector<Texture>* mips = nullptr )
 	{
 		std::cout << "CreateTexture: Uploading '" << textureName << "'..." << std::endl;
 
@@ -397,7 +1714,25 @@ bool App::CreateTexture()
 			return false;
 		}
 
-		if ( target != GL_TEXTURE_1D || !mipmapping )
+		if ( mips != nullptr )
+		{
+			// Rows of the small levels aren't 4-byte multiples
+			glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+			for ( size_t level = 0; level < mips->size(); level++ )
+			{
+				const Texture& mip = (*mips)[level];
+				glTexImage2D( target, GLint( level + 1 ), GL_R8, mip.GetWidth(), mip.GetHeight(), 0,
+					GL_RED, GL_UNSIGNED_BYTE, mip.GetBuffer().data() );
+			}
+			glTexParameteri( target, GL_TEXTURE_MAX_LEVEL, GLint( mips->size() ) );
+			glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+			if ( GLError( "CreateTexture: Uploaded palette mips" ) )
+			{
+				return false;
+			}
+		}
+		else if ( target != GL_TEXTURE_1D || !mipmapping )
 		{
 			glGenerateMipmap( target );
 		
@@ -414,7 +1749,7 @@ bool App::CreateTexture()
 		// not the actual pixel values :>
 		// Also pay special attention to GL_NEAREST_MIPMAP_NEAREST, it must not be 
 		// *_MIPMAP_LINEAR cuz' it'll have wacky consequences like with GL_LINEAR
-		// This could be worked around by rendering the result to a texture, but oh well
+		// The levels themselves are fine though, PaletteMips averages them in RGB
 		glTexParameteri( target, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
 		glTexParameteri( target, GL_TEXTURE_MIN_FILTER, mipmapping ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST );
 	
@@ -423,6 +1758,7 @@ bool App::CreateTexture()
 	};
 
 	{
+		TRACE_SCOPE( "LoadTexture" );
 		texture = TextureProvider::LoadTextureFromFile( "water.bmp" );
 		if ( !texture )
 		{
@@ -431,6 +1767,7 @@ bool App::CreateTexture()
 		}
 
 		TextureBuffer paletteTextureBuffer;
+		paletteTextureBuffer.reserve( 256 * 3 );
 		for ( const auto& paletteEntry : texture.GetPalette() )
 		{
 			paletteTextureBuffer.push_back( paletteEntry[0] );
@@ -440,7 +1777,15 @@ bool App::CreateTexture()
 		paletteTexture = Texture( 256, 1, paletteTextureBuffer, {} );
 	}
 
-	if ( !initialiseTexture( "diffuse image", textureHandle, texture, GL_TEXTURE_2D, true ) )
+	textureMips = PaletteMips::Build( texture );
+	if ( !CreateCpuTexture() )
+	{
+		return false;
+	}
+
+	TRACE_SCOPE( "UploadTextures" );
+
+	if ( !initialiseTexture( "diffuse image", textureHandle, texture, GL_TEXTURE_2D, true, true, &textureMips ) )
 	{
 		return false;
 	}
@@ -450,9 +1795,106 @@ bool App::CreateTexture()
 		return false;
 	}
 
+	if ( !CreateSceneTextures() )
+	{
+		return false;
+	}
+
+	// water.bmp still goes up too, it's small and everything else expects it
+	return !useVirtualTexture || virtualTexture.Open( options.virtualTexturePath.c_str(), renderWidth, renderHeight );
+}
+
+// The GPU always gets water.bmp row by row, SoftwareWater gets it however --texture-layout says
+bool App::CreateCpuTexture()
+{
+	cpuTexture = TextureSwizzle::Convert( texture, options.textureLayout );
+	if ( !cpuTexture )
+	{
+		std::cout << "App::CreateCpuTexture: can't use that --texture-layout with water.bmp" << std::endl;
+		return false;
+	}
+
+	if ( options.guardBand > 0 )
+	{
+		if ( !cpuTexture.SetGuardBand( options.guardBand ) )
+		{
+			return false;
+		}
+
+		const size_t textureBytes = cpuTexture.GetBuffer().size();
+		const size_t overheadBytes = cpuTexture.GetGuardBand().GetOverheadBytes();
+		printf( "App::CreateCpuTexture: guard band of %i texels, %.1f KB on top of the texture's %.1f KB (+%.0f%%)\n",
+			options.guardBand, overheadBytes / 1024.0, textureBytes / 1024.0, 100.0 * overheadBytes / textureBytes );
+	}
+
 	return true;
 }
 
+// There's only water.bmp to go around, so the scene's textures are all made from it:
+// rolled so they don't line up, and two thirds of them with the palette's channels
+// rotated to give 3 palettes. The atlas gets its mips for smaller sizes too, the
+// residency manager's all need to be the size the shader was compiled for
+Texture App::MakeSceneTexture( const int& index, const int& level ) const
+{
+	const Texture& source = level == 0 ? texture : textureMips[level - 1];
+	const int width = int( source.GetWidth() );
+	const int height = int( source.GetHeight() );
+	const int rollX = (index * 37) % width;
+	const int rollY = (index * 23) % height;
+
+	TextureBuffer buffer( size_t( width ) * height );
+	for ( int y = 0; y < height; y++ )
+	{
+		for ( int x = 0; x < width; x++ )
+		{
+			buffer[y * width + x] = source.GetBuffer()[((y + rollY) % height) * width + (x + rollX) % width];
+		}
+	}
+
+	PaletteBuffer palette = source.GetPalette();
+	const int rotation = (index / 3) % 3;
+	for ( PaletteEntry& entry : palette )
+	{
+		const uint8_t original[3] = { entry[0], entry[1], entry[2] };
+		for ( int channel = 0; channel < 3; channel++ )
+		{
+			entry[channel] = original[(channel + rotation) % 3];
+		}
+	}
+
+	return Texture( uint32_t( width ), uint32_t( height ), buffer, palette );
+}
+
+bool App::CreateSceneTextures()
+{
+	TRACE_SCOPE( "CreateSceneTextures" );
+
+	// Making them and their mips is all CPU work, so every texture gets a job,
+	// then they're added in order so the atlas and residency indices still line up
+	const int count = options.sceneTextures;
+	std::vector<Texture> atlasTextures( count );
+	std::vector<Texture> sceneTextures( count );
+	std::vector<std::vector<Texture>> sceneMips( count );
+
+	JobSystem::Get().ParallelFor( count, 1, [&]( const int& begin, const int& end )
+	{
+		for ( int i = begin; i < end; i++ )
+		{
+			atlasTextures[i] = MakeSceneTexture( i, std::min( i % 3, int( textureMips.size() ) ) );
+			sceneTextures[i] = MakeSceneTexture( i, 0 );
+			sceneMips[i] = PaletteMips::Build( sceneTextures[i] );
+		}
+	} );
+
+	for ( int i = 0; i < count; i++ )
+	{
+		atlas.Add( atlasTextures[i] );
+		textureResidency.Add( sceneTextures[i], std::move( sceneMips[i] ) );
+	}
+
+	return atlas.Build() && atlas.Upload() && textureResidency.Upload( size_t( options.textureBudget ) * 1024 );
+}
+
 // Just a quad
 bool App::CreateGeometry()
 {
@@ -509,34 +1951,50 @@ bool App::CreateGeometry()
 	glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof( quadIndices ), quadIndices, GL_STATIC_DRAW );
 	GLError( "CreateGeometry: Set up index buffer" );
 
+	// The 3D scene is small enough that it's always built, so switching to it is instant
+	scene.BuildExample( options.scenePools, texture.GetWidth(), texture.GetHeight(), float( options.subdivideSize ),
+		int( atlas.GetNumRegions() ) );
+	if ( !scene.CreateGeometry() )
+	{
+		return false;
+	}
+
+	// Over one corner, looking across the pools
+	camera.position = scene.GetStartPosition();
+	camera.yaw = -135.0f;
+	camera.pitch = -30.0f;
+
 	return true;
 }
 
-const char* App::GetShaderError( GLuint vs, GLuint fs ) const
+int App::Shutdown( const int& errorCode )
 {
-	int success;
-	static char infoLog[512];
-
-	// Check the vertex shader
-	glGetShaderiv( vs, GL_COMPILE_STATUS, &success );
-	if ( !success )
+	// Needs the context for the frames that are still in flight
+	capture.Stop();
+	simulation.Stop();
+	// Before SDL goes, the watcher posts events through it
+	shaderWatcher.Stop();
+	frameStats.Shutdown();
+	scene.Destroy();
+	atlas.Destroy();
+	textureResidency.Destroy();
+	virtualTexture.Destroy();
+	feedbackShaderProvider.Shutdown();
+	brushShaderProvider.Shutdown();
+	shaderProvider.Shutdown();
+	// After the providers, they hand their unfinished builds over to it
+	shaderCompileThread.Stop();
+	if ( compileContext != nullptr && options.headless )
 	{
-		glGetShaderInfoLog( vs, 512, nullptr, infoLog );
-		return infoLog;
+		headlessContext.DestroySharedContext( compileContext );
 	}
-	// Then the fragment shader
-	glGetShaderiv( fs, GL_COMPILE_STATUS, &success );
-	if ( !success )
+	else if ( compileContext != nullptr )
 	{
-		glGetShaderInfoLog( fs, 512, nullptr, infoLog );
-		return infoLog;
+		SDL_GL_DeleteContext( compileContext );
 	}
+	compileContext = nullptr;
+	headlessContext.Destroy();
 
-	return nullptr;
-}
-
-int App::Shutdown( const int& errorCode )
-{
 	SDL_Quit();
 
 	if ( initialisedGui )
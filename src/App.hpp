@@ -6,57 +6,195 @@
 #define GLEW_STATIC 1
 #include <GL/glew.h>
 
+#include "ShaderProvider.hpp"
+#include "FrameStats.hpp"
+#include "Options.hpp"
+#include "Benchmark.hpp"
+#include "HeadlessContext.hpp"
+#include "FrameCapture.hpp"
+#include "Scene.hpp"
+#include "TextureAtlas.hpp"
+#include "TextureResidency.hpp"
+#include "Arena.hpp"
+#include "WaterSimulation.hpp"
+#include "FileWatcher.hpp"
+#include "VirtualTexture.hpp"
+#include "Camera.hpp"
+
+#include <vector>
+
 class App final : public IApp
 {
 public:
-    int Run() override;
+    int Run( int argc, char** argv ) override;
+
+    // For swater_bench, which runs whole benchmarks through here
+    const Benchmark& GetBenchmark() const
+    {
+        return benchmark;
+    }
 
 private:
+    bool CreateContext();
+    bool ReachedRunLimit() const;
+
     void RunFrame();
+    void ProcessEvents( CameraInput& mouseInput );
+    bool NeedsContinuousFrames() const;
+    void WaitForChanges();
+    void BindWater();
+    void DrawWater();
+    void DrawScene();
+    void DrawVirtualFeedback();
+    void GetVirtualOrigin( int& outX, int& outY ) const;
+    void PresentFrame();
+    void WriteFrame();
+    void ToggleCapture();
+    void StartSimulation();
+    void UpdateSimulation();
+    void AdvanceTime();
+    void UpdateCamera( const CameraInput& mouseInput );
+    int FinishBenchmark();
+    int RunGolden();
+    int ExportGif();
+    int BenchmarkJobs();
     void RunGui();
+    void BuildGui();
 
     bool CreateGui();
     bool CreateShaders();
+    void StartShaderCompileThread();
     bool ReloadShaders();
+    void UpdateShaders();
+    void StartWatchingShaders();
+    void WatchShaderFiles();
+    void SelectShaderVariant();
+    bool UseShaderVariant();
+    ShaderDefines GetShaderDefines() const;
+    ShaderDefines GetBrushShaderDefines() const;
+    ShaderDefines GetFeedbackShaderDefines() const;
     bool CreateTexture();
+    bool CreateCpuTexture();
+    bool CreateSceneTextures();
+    Texture MakeSceneTexture( const int& index, const int& level ) const;
     bool CreateGeometry();
 
-    const char* GetShaderError( GLuint vs, GLuint fs ) const;
-
     int Shutdown( const int& errorCode );
 
 private:
     SDL_Window* window{ nullptr };
     SDL_GLContext glContext{ nullptr };
+    // Used instead of the window and SDL's context with --headless
+    HeadlessContext headlessContext;
+    int renderWidth{ 0 };
+    int renderHeight{ 0 };
     ImGuiContext* guiContext{ nullptr };
     bool initialisedGui{ false };
 
     bool run{ true };
 
+    AppOptions options;
+    Benchmark benchmark;
+    FrameStats frameStats;
+
+    // Seconds of animation, either real time or a fixed step per frame
+    float animationTime{ 0.0f };
+    FrameStats::Clock::time_point lastAnimationUpdate{};
+    // Seconds since the last frame, same clock as the animation
+    float frameDeltaTime{ 0.0f };
+
+    int frameCount{ 0 };
+    FrameStats::Clock::time_point runStart{};
+
+    // Scratch memory for whatever only lasts a frame, it's all dropped at the end of RunFrame
+    LinearArena frameArena{ 64 * 1024 };
+
+    // For --output
+    int outputFrameCount{ 0 };
+    std::vector<uint8_t> outputPixels;
+
+    // For --capture and the C key
+    FrameCapture capture;
+
+    // For --on-demand, frames are only drawn when they'd look different from the last one
+    bool onDemand{ false };
+    // Minimised or hidden, so there's nothing to draw for
+    bool windowVisible{ true };
+    // ImGui needs a frame or two to catch up after input, hovering and such, so every event buys a few
+    static constexpr int GuiSettleFrames = 2;
+    int pendingFrames{ 0 };
+
+    // For --cpu-water, the 2D view shows what SoftwareWater simulates on another thread
+    bool cpuWater{ false };
+    WaterSimulation simulation;
+    GLuint cpuFrameTextureHandle{ 0 };
+    Uint32 simulationEventType{ 0 };
+
+    // Saving a shader, or anything it includes, reloads it like R does; --no-watch-shaders turns it off
+    FileWatcher shaderWatcher;
+    Uint32 shaderChangeEventType{ 0 };
+
 private:
-    GLuint gpuProgramHandle{ 0 };
-    GLuint shaderTimeHandle{ 0 };
+    // What's being drawn with right now; a reload only replaces it once the new one is linked
+    ShaderProgram program;
+    ShaderProvider shaderProvider;
+    // Only started when the driver can't compile in parallel by itself; all the providers share it
+    ShaderCompileThread shaderCompileThread;
+    // The context it compiles with, an EGLContext or an SDL_GLContext
+    void* compileContext{ nullptr };
 
     // The palette is uploaded to the GPU as a 256x1 texture
     // so we don't have to abuse uniforms
     Texture paletteTexture;
     // The texture itself is uploaded as 8-bit indices into the palette
     Texture texture;
+    // Levels 1 and down, averaged through the palette since averaging indices makes no sense
+    std::vector<Texture> textureMips;
+    // What SoftwareWater reads, the same texture in --texture-layout
+    Texture cpuTexture;
 
     GLuint paletteTextureHandle{ 0 };
     GLuint textureHandle{ 0 };
 
     int upperIndex{ 192 };
     int lowerIndex{ 20 };
-    GLuint upperIndexHandle{ 0 };
-    GLuint lowerIndexHandle{ 0 };
 
-    GLuint textureWidthHandle{ 0 };
-    GLuint textureHeightHandle{ 0 };
+    // Effect options, every combination of these is its own shader variant
+    bool fixFogIndex{ true };
+    bool debugIndices{ false };
+    // Palette indices instead of colours, only used by --golden
+    bool outputIndices{ false };
 
     GLuint vertexBufferHandle{ 0 };
     GLuint vertexArrayHandle{ 0 };
     GLuint indexBufferHandle{ 0 };
+
+    // The 3D viewer; the water uses the SCENE_3D variant of its shaders there
+    bool scene3D{ false };
+    // GLQuake-style per-vertex warp on subdivided water, optionally coarser further away
+    bool vertexWarp{ false };
+    bool adaptiveSubdivision{ true };
+    // Each pool has a texture of its own, either all out of one atlas, or
+    // separate ones that are streamed in and out under a memory budget
+    TextureAtlas atlas;
+    bool useAtlas{ false };
+    TextureResidency textureResidency;
+    Scene scene;
+    Camera camera;
+    ShaderProvider brushShaderProvider;
+    ShaderProgram brushProgram;
+
+    // For --virtual-texture, the 2D view shows that instead of water.bmp, a texel per pixel
+    // The view drifts along by itself, and dragging with the left mouse button moves it too
+    static constexpr int VirtualDriftX = 40;
+    static constexpr int VirtualDriftY = 25;
+    bool useVirtualTexture{ false };
+    VirtualTexture virtualTexture;
+    int virtualPanX{ 0 };
+    int virtualPanY{ 0 };
+    // Draws which pages the frame needs, see VirtualTexture
+    ShaderProvider feedbackShaderProvider;
+    ShaderProgram feedbackProgram;
 };
 
 /*
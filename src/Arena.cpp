@@ -0,0 +1,89 @@
+
+#include "Arena.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	// Not worth going to the heap for less
+	constexpr size_t MinBlockSize = 4096;
+}
+
+LinearArena::LinearArena( const size_t& capacity )
+	: initialCapacity( capacity )
+{
+}
+
+void* LinearArena::Allocate( const size_t& size, const size_t& alignment )
+{
+	if ( !blocks.empty() )
+	{
+		Block& block = blocks.back();
+		const uintptr_t start = reinterpret_cast<uintptr_t>( block.memory.get() ) + offset;
+		const uintptr_t aligned = (start + alignment - 1) & ~uintptr_t( alignment - 1 );
+		const size_t end = offset + size_t( aligned - start ) + size;
+
+		if ( end <= block.size )
+		{
+			used += end - offset;
+			peak = std::max( peak, used );
+			offset = end;
+			return reinterpret_cast<void*>( aligned );
+		}
+	}
+
+	// Whatever's left of the last block is wasted until the Reset, so make the new one
+	// at least as big as everything so far, that way it takes a few spills at most
+	const size_t blockSize = std::max( { size + alignment, initialCapacity, GetCapacity(), MinBlockSize } );
+	if ( !blocks.empty() )
+	{
+		spills++;
+	}
+
+	blocks.push_back( Block{ std::unique_ptr<uint8_t[]>( new uint8_t[blockSize] ), blockSize } );
+	offset = 0;
+	return Allocate( size, alignment );
+}
+
+void LinearArena::Reset()
+{
+	if ( blocks.size() > 1 )
+	{
+		const size_t capacity = GetCapacity();
+		blocks.clear();
+		blocks.push_back( Block{ std::unique_ptr<uint8_t[]>( new uint8_t[capacity] ), capacity } );
+	}
+
+	offset = 0;
+	used = 0;
+}
+
+size_t LinearArena::GetCapacity() const
+{
+	size_t capacity = 0;
+	for ( const Block& block : blocks )
+	{
+		capacity += block.size;
+	}
+
+	return capacity;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,144 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Hands out memory by bumping an offset along, and takes all of it back at once with Reset
+// For things that all go away at the same time: everything a frame needs, or the scratch
+// space of a shader build
+//
+// If it runs out, it gets another block from the heap and carries on, and the next Reset
+// swaps all of them for a single block that fits the lot, so it settles on the right size
+// after a frame or two and doesn't go back to the heap after that
+class LinearArena final
+{
+public:
+    // Nothing gets allocated until the first Allocate
+    explicit LinearArena( const size_t& capacity = 0 );
+
+    LinearArena( const LinearArena& ) = delete;
+    LinearArena& operator=( const LinearArena& ) = delete;
+
+    // Never returns null, alignment has to be a power of two
+    void* Allocate( const size_t& size, const size_t& alignment = alignof( std::max_align_t ) );
+
+    // Nothing in an arena ever gets destructed, so only types that don't care can go in
+    template<typename T>
+    T* AllocateArray( const size_t& count )
+    {
+        static_assert( std::is_trivially_destructible<T>::value, "LinearArena: T would never get destructed" );
+        return static_cast<T*>( Allocate( sizeof( T ) * count, alignof( T ) ) );
+    }
+
+    void Reset();
+
+    // Bytes handed out since the last Reset, padding included
+    size_t GetUsed() const
+    {
+        return used;
+    }
+
+    // The most that was ever in use between two Resets
+    size_t GetPeak() const
+    {
+        return peak;
+    }
+
+    size_t GetCapacity() const;
+
+    // How many times it ran out and had to get another block
+    int GetNumSpills() const
+    {
+        return spills;
+    }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<uint8_t[]> memory;
+        size_t size;
+    };
+
+    // Only the last one is being allocated from
+    std::vector<Block> blocks;
+    size_t initialCapacity{ 0 };
+    size_t offset{ 0 };
+    size_t used{ 0 };
+    size_t peak{ 0 };
+    int spills{ 0 };
+};
+
+// So standard containers can live in an arena, e.g. std::vector<int, ArenaAllocator<int>>
+// Freeing does nothing, the memory comes back when the arena's Reset, so reserve up front
+// rather than letting a vector grow, or every size it grows through stays taken
+// Not final, standard containers derive from their allocators
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator( LinearArena& arena )
+        : arena( &arena )
+    {
+    }
+
+    template<typename U>
+    ArenaAllocator( const ArenaAllocator<U>& other )
+        : arena( other.arena )
+    {
+    }
+
+    T* allocate( const size_t& count )
+    {
+        return static_cast<T*>( arena->Allocate( sizeof( T ) * count, alignof( T ) ) );
+    }
+
+    void deallocate( T*, const size_t& )
+    {
+    }
+
+    template<typename U>
+    bool operator==( const ArenaAllocator<U>& other ) const
+    {
+        return arena == other.arena;
+    }
+
+    template<typename U>
+    bool operator!=( const ArenaAllocator<U>& other ) const
+    {
+        return arena != other.arena;
+    }
+
+private:
+    template<typename U>
+    friend class ArenaAllocator;
+
+    LinearArena* arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,187 @@
+
+#include "Benchmark.hpp"
+#include "Allocations.hpp"
+#include "Statistics.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+constexpr size_t Benchmark::MaxFrameSamples;
+
+void Benchmark::Start( const AppOptions& appOptions )
+{
+	options = appOptions;
+
+	// Grow it up front so the measured frames don't allocate
+	// --seconds runs don't know how many they'll get, so they get the most there'll ever be kept
+	frameTimes.clear();
+	frameTimes.reserve( options.frames > 0 ? std::min( size_t( options.frames ), MaxFrameSamples ) : MaxFrameSamples );
+	numFrames = 0;
+	frameTimeSum = 0.0;
+	minFrameTime = 0.0f;
+	maxFrameTime = 0.0f;
+	sampleSeed = 1;
+
+	warmupFramesLeft = options.warmupFrames;
+	measuring = warmupFramesLeft == 0;
+
+	measureStart = Clock::now();
+	lastFrameEnd = measureStart;
+	allocationsAtStart = Allocations::GetCount();
+	allocations = 0;
+}
+
+bool Benchmark::EndFrame()
+{
+	const auto now = Clock::now();
+
+	if ( !measuring )
+	{
+		warmupFramesLeft--;
+		if ( warmupFramesLeft <= 0 )
+		{
+			measuring = true;
+			measureStart = now;
+			allocationsAtStart = Allocations::GetCount();
+		}
+
+		lastFrameEnd = now;
+		return false;
+	}
+
+	const std::chrono::duration<float, std::milli> frameTime = now - lastFrameEnd;
+	const float milliseconds = frameTime.count();
+	minFrameTime = numFrames == 0 ? milliseconds : std::min( minFrameTime, milliseconds );
+	maxFrameTime = numFrames == 0 ? milliseconds : std::max( maxFrameTime, milliseconds );
+	frameTimeSum += milliseconds;
+	numFrames++;
+
+	// Reservoir sampling once it's full: frame n replaces a random sample with
+	// a chance of MaxFrameSamples in n, so every frame's equally likely to be kept
+	if ( frameTimes.size() < MaxFrameSamples )
+	{
+		frameTimes.push_back( milliseconds );
+	}
+	else
+	{
+		// xorshift, plenty random for this
+		sampleSeed ^= sampleSeed << 13;
+		sampleSeed ^= sampleSeed >> 17;
+		sampleSeed ^= sampleSeed << 5;
+		const uint64_t slot = sampleSeed % numFrames;
+		if ( slot < MaxFrameSamples )
+		{
+			frameTimes[size_t( slot )] = milliseconds;
+		}
+	}
+
+	lastFrameEnd = now;
+	allocations = Allocations::GetCount() - allocationsAtStart;
+
+	if ( options.frames > 0 && numFrames >= uint64_t( options.frames ) )
+	{
+		return true;
+	}
+
+	const std::chrono::duration<float> elapsed = now - measureStart;
+	return options.seconds > 0.0f && elapsed.count() >= options.seconds;
+}
+
+bool Benchmark::Report( const BenchmarkContext& context )
+{
+	const std::chrono::duration<double> totalTime = Clock::now() - measureStart;
+	const double mean = numFrames ? frameTimeSum / double( numFrames ) : 0.0;
+
+	// Percentile reorders things, but we're done with the order anyway
+	const size_t numSamples = frameTimes.size();
+	const float p50 = Percentile( frameTimes.data(), numSamples, 50.0f );
+	const float p95 = Percentile( frameTimes.data(), numSamples, 95.0f );
+	const float p99 = Percentile( frameTimes.data(), numSamples, 99.0f );
+
+	const auto escape = []( const std::string& string )
+	{
+		std::string result;
+		for ( const char& c : string )
+		{
+			if ( c == '"' || c == '\\' )
+			{
+				result += '\\';
+			}
+			result += c;
+		}
+		return result;
+	};
+
+	// null when they weren't counted, so zero always means zero
+	char allocationsJson[32] = "null";
+	if ( Allocations::Enabled )
+	{
+		snprintf( allocationsJson, sizeof( allocationsJson ), "%llu", (unsigned long long)allocations );
+	}
+
+	char report[1024];
+	snprintf( report, sizeof( report ),
+		"{\"frames\":%llu,\"warmupFrames\":%i,\"timestep\":%.6f,\"seconds\":%.4f,\"framesPerSecond\":%.2f,"
+		"\"frameTimeMs\":{\"mean\":%.4f,\"min\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f},"
+		"\"allocations\":%s,\"width\":%i,\"height\":%i,\"textureWidth\":%i,\"textureHeight\":%i,"
+		"\"renderer\":\"%s\",\"version\":\"%s\"}",
+		(unsigned long long)numFrames, options.warmupFrames, options.timestep, totalTime.count(),
+		totalTime.count() > 0.0 ? double( numFrames ) / totalTime.count() : 0.0,
+		mean, minFrameTime, p50, p95, p99, maxFrameTime, allocationsJson,
+		context.width, context.height, context.textureWidth, context.textureHeight,
+		escape( context.renderer ).c_str(), escape( context.version ).c_str() );
+
+	// On a line of its own, so it's easy to pick out from the rest of the log
+	std::cout << report << std::endl;
+
+	bool okay = true;
+	if ( options.noAllocations )
+	{
+		if ( !Allocations::Enabled )
+		{
+			std::cout << "Benchmark::Report: --no-allocations needs a build with SWATER_COUNT_ALLOCATIONS" << std::endl;
+			okay = false;
+		}
+		else if ( allocations > 0 )
+		{
+			printf( "Benchmark::Report: the measured frames allocated %llu times, they should be allocating 0 times\n",
+				(unsigned long long)allocations );
+			okay = false;
+		}
+	}
+
+	if ( options.reportPath.empty() )
+	{
+		return okay;
+	}
+
+	FILE* file = fopen( options.reportPath.c_str(), "wb" );
+	if ( file == nullptr )
+	{
+		std::cout << "Benchmark::Report: could not write '" << options.reportPath << "'" << std::endl;
+		return false;
+	}
+
+	fprintf( file, "%s\n", report );
+	fclose( file );
+	return okay;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
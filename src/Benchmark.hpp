@@ -0,0 +1,103 @@
+
+#pragma once
+
+#include "Options.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What the report says about the machine and the setup, so runs can be told apart
+struct BenchmarkContext
+{
+    std::string renderer;
+    std::string version;
+    int width{ 0 };
+    int height{ 0 };
+    int textureWidth{ 0 };
+    int textureHeight{ 0 };
+};
+
+// Measures frame times for --benchmark and prints them as a single line of JSON
+// Frame times are the wall-clock time between the ends of consecutive frames,
+// which is what the throughput ends up being once the GPU queue is full
+class Benchmark final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Frame times kept for the percentiles; longer runs keep a random sample of them this big
+    static constexpr size_t MaxFrameSamples = 1 << 18;
+
+    void Start( const AppOptions& options );
+
+    // Call at the very end of every frame, returns true once the run is over
+    bool EndFrame();
+
+    // Make sure the GPU is done (glFinish) before calling this, otherwise the last frames aren't counted
+    // Returns false if the report file couldn't be written
+    bool Report( const BenchmarkContext& context );
+
+    // Milliseconds per measured frame, or a sample of them past MaxFrameSamples
+    // After Report, they're no longer in order
+    const std::vector<float>& GetFrameTimes() const
+    {
+        return frameTimes;
+    }
+
+    // Every measured frame, sampled or not
+    uint64_t GetNumFrames() const
+    {
+        return numFrames;
+    }
+
+    // Heap allocations any thread made during the measured frames
+    uint64_t GetAllocations() const
+    {
+        return allocations;
+    }
+
+private:
+    AppOptions options;
+
+    int warmupFramesLeft{ 0 };
+    bool measuring{ false };
+
+    Clock::time_point measureStart{};
+    Clock::time_point lastFrameEnd{};
+
+    // Heap allocations over the whole process, the count when measuring started and since
+    // Workers and the simulation thread do part of every frame, so they count too
+    uint64_t allocationsAtStart{ 0 };
+    uint64_t allocations{ 0 };
+
+    // Reserved up front, so the measured frames never grow it
+    std::vector<float> frameTimes;
+    // The mean, min and max go over every frame, not just the sampled ones
+    uint64_t numFrames{ 0 };
+    double frameTimeSum{ 0.0 };
+    float minFrameTime{ 0.0f };
+    float maxFrameTime{ 0.0f };
+    // For picking which samples to replace once frameTimes is full
+    uint32_t sampleSeed{ 1 };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,143 @@
+
+#include "Bvh.hpp"
+
+#include <algorithm>
+
+void Bvh::Build( const std::vector<Aabb>& itemBounds, const int& maxLeafSize )
+{
+	nodes.clear();
+	items.resize( itemBounds.size() );
+	for ( size_t i = 0; i < items.size(); i++ )
+	{
+		items[i] = int( i );
+	}
+
+	if ( items.empty() )
+	{
+		return;
+	}
+
+	// A binary tree with leaves of at least one item never needs more than this
+	nodes.reserve( items.size() * 2 );
+	BuildNode( itemBounds, 0, int( items.size() ), std::max( 1, maxLeafSize ) );
+}
+
+int Bvh::BuildNode( const std::vector<Aabb>& itemBounds, const int& first, const int& count, const int& maxLeafSize )
+{
+	const int nodeIndex = int( nodes.size() );
+	nodes.emplace_back();
+
+	Aabb bounds;
+	Aabb centres;
+	for ( int i = first; i < first + count; i++ )
+	{
+		const Aabb& itemBox = itemBounds[items[i]];
+		bounds.Add( itemBox );
+
+		const Vec3 centre = itemBox.GetCentre();
+		centres.Add( Aabb( centre, centre ) );
+	}
+	nodes[nodeIndex].bounds = bounds;
+
+	if ( count <= maxLeafSize )
+	{
+		nodes[nodeIndex].first = first;
+		nodes[nodeIndex].count = count;
+		return nodeIndex;
+	}
+
+	// Split where the item centres are spread out the most
+	const Vec3 extent = centres.maxs - centres.mins;
+	const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+	const int half = count / 2;
+	std::nth_element( items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+		[&]( const int& a, const int& b )
+		{
+			return itemBounds[a].GetCentre()[axis] < itemBounds[b].GetCentre()[axis];
+		} );
+
+	// nodes can reallocate while building the children, so no references across these
+	BuildNode( itemBounds, first, half, maxLeafSize );
+	const int secondChild = BuildNode( itemBounds, first + half, count - half, maxLeafSize );
+
+	nodes[nodeIndex].first = secondChild;
+	nodes[nodeIndex].count = 0;
+	return nodeIndex;
+}
+
+int Bvh::Cull( const Frustum& frustum, std::vector<int>& outItems ) const
+{
+	if ( nodes.empty() )
+	{
+		return 0;
+	}
+
+	// Median splits keep the tree balanced, so 64 levels is way more than it'll ever have
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	int nodesTested = 0;
+	while ( stackSize > 0 )
+	{
+		const int nodeIndex = stack[--stackSize];
+		const Node& node = nodes[nodeIndex];
+		nodesTested++;
+
+		const Frustum::Result result = frustum.Test( node.bounds );
+		if ( result == Frustum::Outside )
+		{
+			continue;
+		}
+
+		if ( result == Frustum::Inside )
+		{
+			AddSubtree( nodeIndex, outItems );
+			continue;
+		}
+
+		if ( node.count > 0 )
+		{
+			outItems.insert( outItems.end(), items.begin() + node.first, items.begin() + node.first + node.count );
+			continue;
+		}
+
+		stack[stackSize++] = node.first;
+		stack[stackSize++] = nodeIndex + 1;
+	}
+
+	return nodesTested;
+}
+
+void Bvh::AddSubtree( const int& nodeIndex, std::vector<int>& outItems ) const
+{
+	const Node& node = nodes[nodeIndex];
+	if ( node.count > 0 )
+	{
+		outItems.insert( outItems.end(), items.begin() + node.first, items.begin() + node.first + node.count );
+		return;
+	}
+
+	AddSubtree( nodeIndex + 1, outItems );
+	AddSubtree( node.first, outItems );
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,68 @@
+
+#pragma once
+
+#include "Math.hpp"
+
+#include <vector>
+
+// Bounding volume hierarchy over a static set of boxes, for frustum culling
+// Built top-down by splitting at the median along the longest axis, which is plenty
+// for a scene that never moves. Nodes live in one array, children right after their parent
+class Bvh final
+{
+public:
+    // Items are identified by their index in itemBounds
+    void Build( const std::vector<Aabb>& itemBounds, const int& maxLeafSize = 4 );
+
+    // Appends every item whose box is at least partly inside the frustum
+    // Whole subtrees that are inside get added without testing the boxes below them,
+    // so the work depends on what's visible, not on how many items there are
+    // Returns how many nodes were tested
+    int Cull( const Frustum& frustum, std::vector<int>& outItems ) const;
+
+    size_t GetNumItems() const
+    {
+        return items.size();
+    }
+
+    size_t GetNumNodes() const
+    {
+        return nodes.size();
+    }
+
+private:
+    struct Node
+    {
+        Aabb bounds;
+        // Leaves have a range of items, inner nodes have their second child's index;
+        // the first child is always the next node
+        int first{ 0 };
+        int count{ 0 };
+    };
+
+    int BuildNode( const std::vector<Aabb>& itemBounds, const int& first, const int& count, const int& maxLeafSize );
+    void AddSubtree( const int& nodeIndex, std::vector<int>& outItems ) const;
+
+private:
+    std::vector<Node> nodes;
+    std::vector<int> items;
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,64 @@
+
+#include "Camera.hpp"
+
+namespace
+{
+	constexpr float DegreesToRadians = 3.14159265f / 180.0f;
+}
+
+void Camera::Update( const float& deltaTime, const CameraInput& input )
+{
+	yaw -= input.lookX * sensitivity;
+	pitch -= input.lookY * sensitivity;
+
+	// Looking straight up or down would flip the view over
+	pitch = std::max( -89.0f, std::min( 89.0f, pitch ) );
+
+	const Vec3 forward = GetForward();
+	const Vec3 right = Vec3::Cross( forward, Vec3( 0.0f, 1.0f, 0.0f ) ).Normalized();
+	const float distance = speed * deltaTime * (input.fast ? 4.0f : 1.0f);
+
+	position += forward * (input.forward * distance);
+	position += right * (input.right * distance);
+	position += Vec3( 0.0f, input.up * distance, 0.0f );
+}
+
+Vec3 Camera::GetForward() const
+{
+	// Yaw 0 looks down -Z, like an OpenGL camera with no rotation
+	const float yawRadians = yaw * DegreesToRadians;
+	const float pitchRadians = pitch * DegreesToRadians;
+
+	return Vec3( -std::sin( yawRadians ) * std::cos( pitchRadians ),
+		std::sin( pitchRadians ),
+		-std::cos( yawRadians ) * std::cos( pitchRadians ) );
+}
+
+Mat4 Camera::GetView() const
+{
+	return Mat4::LookAt( position, position + GetForward(), Vec3( 0.0f, 1.0f, 0.0f ) );
+}
+
+Mat4 Camera::GetViewProjection( const float& aspect ) const
+{
+	return Mat4::Perspective( fieldOfView, aspect, nearPlane, farPlane ) * GetView();
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,61 @@
+
+#pragma once
+
+#include "Math.hpp"
+
+// What the camera should do this frame, gathered from whatever input there is
+struct CameraInput
+{
+    // -1 to 1 along each axis, relative to where the camera looks
+    float forward{ 0.0f };
+    float right{ 0.0f };
+    float up{ 0.0f };
+    // Mouse movement in pixels
+    float lookX{ 0.0f };
+    float lookY{ 0.0f };
+    bool fast{ false };
+};
+
+// Free-fly camera, like noclip
+// Yaw turns around Y, pitch looks up and down, both in degrees
+class Camera final
+{
+public:
+    void Update( const float& deltaTime, const CameraInput& input );
+
+    Vec3 GetForward() const;
+    Mat4 GetView() const;
+    Mat4 GetViewProjection( const float& aspect ) const;
+
+public:
+    Vec3 position{ 0.0f, 0.0f, 0.0f };
+    float yaw{ 0.0f };
+    float pitch{ 0.0f };
+
+    float fieldOfView{ 75.0f };
+    float nearPlane{ 1.0f };
+    float farPlane{ 16384.0f };
+
+    // Units per second, and degrees per pixel of mouse movement
+    float speed{ 320.0f };
+    float sensitivity{ 0.15f };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,223 @@
+
+#include "FileWatcher.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#if defined( __linux__ )
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+constexpr int FileWatcher::DebounceMilliseconds;
+
+namespace
+{
+	// "shaders/water.glsl" goes in "shaders/", "water.glsl" in "./"
+	std::string GetDirectory( const std::string& path )
+	{
+		const size_t slash = path.find_last_of( "/\\" );
+		if ( slash == std::string::npos )
+		{
+			return "./";
+		}
+
+		return path.substr( 0, slash + 1 );
+	}
+
+	std::string GetFileName( const std::string& path )
+	{
+		const size_t slash = path.find_last_of( "/\\" );
+		return slash == std::string::npos ? path : path.substr( slash + 1 );
+	}
+}
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+bool FileWatcher::Start( std::function<void()> onChange )
+{
+	Stop();
+
+#if defined( __linux__ )
+	inotifyDescriptor = inotify_init1( IN_CLOEXEC );
+	stopDescriptor = eventfd( 0, EFD_CLOEXEC );
+	if ( inotifyDescriptor < 0 || stopDescriptor < 0 )
+	{
+		std::cout << "FileWatcher::Start: couldn't set up inotify, press R to reload shaders instead" << std::endl;
+		Stop();
+		return false;
+	}
+
+	changed = std::move( onChange );
+	thread = std::thread( &FileWatcher::ThreadMain, this );
+	return true;
+#else
+	(void)onChange;
+	std::cout << "FileWatcher::Start: not supported on this platform, press R to reload shaders instead" << std::endl;
+	return false;
+#endif
+}
+
+void FileWatcher::Stop()
+{
+#if defined( __linux__ )
+	if ( thread.joinable() )
+	{
+		const uint64_t one = 1;
+		(void)write( stopDescriptor, &one, sizeof( one ) );
+		thread.join();
+	}
+
+	// Closing it takes all the watches with it
+	if ( inotifyDescriptor >= 0 )
+	{
+		close( inotifyDescriptor );
+	}
+	if ( stopDescriptor >= 0 )
+	{
+		close( stopDescriptor );
+	}
+#endif
+
+	inotifyDescriptor = -1;
+	stopDescriptor = -1;
+	changed = nullptr;
+
+	std::lock_guard<std::mutex> lock( mutex );
+	directories.clear();
+	files.clear();
+}
+
+void FileWatcher::SetFiles( const std::vector<std::string>& paths )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	files.clear();
+	for ( const std::string& path : paths )
+	{
+		const std::string directory = GetDirectory( path );
+		files.insert( directory + GetFileName( path ) );
+
+#if defined( __linux__ )
+		if ( inotifyDescriptor < 0 )
+		{
+			continue;
+		}
+
+		// Closing after writing covers saving in place, moving covers saving through a temporary file
+		// Adding the same directory again just gives back the same descriptor
+		const int watch = inotify_add_watch( inotifyDescriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO );
+		if ( watch < 0 )
+		{
+			std::cout << "FileWatcher::SetFiles: can't watch '" << directory << "'" << std::endl;
+			continue;
+		}
+
+		directories[watch] = directory;
+#endif
+	}
+
+	// Directories that have nothing in them anymore just stay watched, it's only ever a handful
+}
+
+void FileWatcher::ThreadMain()
+{
+#if defined( __linux__ )
+	TRACE_THREAD_NAME( "File watcher" );
+
+	using Clock = std::chrono::steady_clock;
+
+	// inotify_event has a name on the end, so there's room for a few of them
+	alignas( inotify_event ) char buffer[4096];
+
+	bool pending = false;
+	Clock::time_point lastChange;
+	while ( true )
+	{
+		// Asleep until something happens, or until a burst of changes has had time to settle
+		int timeout = -1;
+		if ( pending )
+		{
+			const auto sinceChange = std::chrono::duration_cast<std::chrono::milliseconds>( Clock::now() - lastChange );
+			timeout = std::max( 0, DebounceMilliseconds - int( sinceChange.count() ) );
+		}
+
+		pollfd descriptors[2]{};
+		descriptors[0].fd = inotifyDescriptor;
+		descriptors[0].events = POLLIN;
+		descriptors[1].fd = stopDescriptor;
+		descriptors[1].events = POLLIN;
+
+		const int ready = poll( descriptors, 2, timeout );
+		if ( descriptors[1].revents & POLLIN )
+		{
+			return;
+		}
+
+		if ( ready == 0 )
+		{
+			pending = false;
+			TRACE_SCOPE( "FileWatcher::Changed" );
+			changed();
+			continue;
+		}
+
+		if ( !(descriptors[0].revents & POLLIN) )
+		{
+			continue;
+		}
+
+		const ssize_t length = read( inotifyDescriptor, buffer, sizeof( buffer ) );
+		if ( length <= 0 )
+		{
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock( mutex );
+		for ( ssize_t offset = 0; offset < length; )
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>( buffer + offset );
+			offset += sizeof( inotify_event ) + event->len;
+
+			const auto directory = directories.find( event->wd );
+			if ( event->len == 0 || directory == directories.end() )
+			{
+				continue;
+			}
+
+			// Every save pushes the callback back a bit further
+			if ( files.count( directory->second + event->name ) )
+			{
+				pending = true;
+				lastChange = Clock::now();
+			}
+		}
+	}
+#endif
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
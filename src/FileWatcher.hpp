@@ -0,0 +1,79 @@
+
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Watches a set of files on a thread of its own, and calls back once they've changed
+// and then stayed the same for DebounceMilliseconds
+//
+// Editors tend to save in bursts, truncating, writing, renaming a temporary file over the
+// old one and so on, so the callback only comes once the burst is over. While nothing's
+// changing, the thread is asleep in the kernel and costs nothing at all
+//
+// It's the directories that actually get watched, since an editor that saves by renaming
+// replaces the file, and a watch on the old one would go with it
+// Only does anything on Linux, through inotify; elsewhere Start just says it can't
+class FileWatcher final
+{
+public:
+    static constexpr int DebounceMilliseconds = 100;
+
+    FileWatcher() = default;
+    ~FileWatcher();
+
+    FileWatcher( const FileWatcher& ) = delete;
+    FileWatcher& operator=( const FileWatcher& ) = delete;
+
+    // onChange gets called on the watcher thread, keep it short
+    bool Start( std::function<void()> onChange );
+    void Stop();
+
+    bool IsRunning() const
+    {
+        return thread.joinable();
+    }
+
+    // Replaces the files being watched, can be called from any thread
+    void SetFiles( const std::vector<std::string>& paths );
+
+private:
+    void ThreadMain();
+
+private:
+    int inotifyDescriptor{ -1 };
+    // Written to by Stop to wake the thread up
+    int stopDescriptor{ -1 };
+    std::thread thread;
+    std::function<void()> changed;
+
+    std::mutex mutex;
+    // Watch descriptor to directory, with a slash on the end
+    std::unordered_map<int, std::string> directories;
+    // Directory and name, the same way they're put together from an event
+    std::unordered_set<std::string> files;
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,337 @@
+
+#include "FrameCapture.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+constexpr int FrameCapture::RingSize;
+constexpr int FrameCapture::MaxQueuedFrames;
+
+namespace
+{
+	bool EndsWith( const std::string& string, const char* suffix )
+	{
+		const size_t suffixLength = strlen( suffix );
+		if ( string.size() < suffixLength )
+		{
+			return false;
+		}
+
+		return std::equal( string.end() - suffixLength, string.end(), suffix, []( const char& a, const char& b )
+		{
+			return tolower( a ) == tolower( b );
+		} );
+	}
+}
+
+bool FrameCapture::Start( const char* capturePath, const int& frameWidth, const int& frameHeight, const int& framesPerSecond )
+{
+	if ( capturing )
+	{
+		std::cout << "FrameCapture::Start: already capturing to '" << path << "'" << std::endl;
+		return false;
+	}
+
+	file = fopen( capturePath, "wb" );
+	if ( file == nullptr )
+	{
+		std::cout << "FrameCapture::Start: could not open '" << capturePath << "' for writing" << std::endl;
+		return false;
+	}
+
+	path = capturePath;
+	width = frameWidth;
+	height = frameHeight;
+	writeY4m = EndsWith( path, ".y4m" );
+
+	if ( writeY4m )
+	{
+		// Progressive, square pixels, no chroma subsampling, so the conversion stays cheap
+		fprintf( file, "YUV4MPEG2 W%i H%i F%i:1 Ip A1:1 C444\n", width, height, framesPerSecond );
+	}
+
+	const size_t frameSize = size_t( width ) * height * 4U;
+	for ( PendingReadback& readback : readbacks )
+	{
+		glGenBuffers( 1, &readback.bufferHandle );
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.bufferHandle );
+		glBufferData( GL_PIXEL_PACK_BUFFER, GLsizeiptr( frameSize ), nullptr, GL_STREAM_READ );
+		readback.fence = nullptr;
+	}
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	readbackHead = 0;
+	readbacksInFlight = 0;
+
+	freeFrames.resize( MaxQueuedFrames );
+	for ( auto& frame : freeFrames )
+	{
+		frame.resize( frameSize );
+	}
+	fileFrame.resize( size_t( width ) * height * 3U );
+
+	framesCaptured = 0;
+	framesWritten = 0;
+	writerStalls = 0;
+	writeFailed = false;
+	captureMilliseconds = 0.0;
+	worstCaptureMilliseconds = 0.0;
+	waitMilliseconds = 0.0;
+
+	stopWriter = false;
+	writer = std::thread( &FrameCapture::WriterThread, this );
+
+	capturing = true;
+	printf( "FrameCapture: recording %ix%i to '%s'\n", width, height, path.c_str() );
+	return true;
+}
+
+void FrameCapture::Stop()
+{
+	if ( !capturing )
+	{
+		return;
+	}
+
+	TRACE_SCOPE( "FrameCapture::Stop" );
+
+	while ( readbacksInFlight > 0 )
+	{
+		CollectReadback();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		stopWriter = true;
+	}
+	frameQueued.notify_one();
+	writer.join();
+
+	fclose( file );
+	file = nullptr;
+
+	for ( PendingReadback& readback : readbacks )
+	{
+		glDeleteBuffers( 1, &readback.bufferHandle );
+		readback.bufferHandle = 0;
+	}
+
+	queuedFrames.clear();
+	freeFrames.clear();
+	fileFrame = {};
+	capturing = false;
+
+	const double frames = framesCaptured ? double( framesCaptured ) : 1.0;
+	printf( "FrameCapture: wrote %i of %i frames to '%s', capturing took %.3f ms per frame (worst %.3f ms), "
+		"of which %.3f ms was waiting for the GPU\n",
+		framesWritten, framesCaptured, path.c_str(), captureMilliseconds / frames, worstCaptureMilliseconds,
+		waitMilliseconds / frames );
+
+	if ( writerStalls > 0 )
+	{
+		std::cout << "FrameCapture: the disk couldn't keep up, rendering waited for it "
+			<< writerStalls << " time(s)" << std::endl;
+	}
+}
+
+void FrameCapture::CaptureFrame()
+{
+	if ( !capturing )
+	{
+		return;
+	}
+
+	TRACE_SCOPE( "FrameCapture::CaptureFrame" );
+	const auto start = std::chrono::steady_clock::now();
+
+	// By the time the ring comes around, the oldest readback is RingSize - 1 frames old,
+	// so the GPU is practically always done with it and this doesn't wait
+	if ( readbacksInFlight == RingSize )
+	{
+		CollectReadback();
+	}
+
+	PendingReadback& readback = readbacks[(readbackHead + readbacksInFlight) % RingSize];
+
+	// With a pack buffer bound, glReadPixels just queues a copy and returns
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.bufferHandle );
+	glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+	glReadPixels( 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	readback.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	readbacksInFlight++;
+	framesCaptured++;
+
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	captureMilliseconds += elapsed.count();
+	worstCaptureMilliseconds = std::max( worstCaptureMilliseconds, elapsed.count() );
+}
+
+void FrameCapture::CollectReadback()
+{
+	PendingReadback& readback = readbacks[readbackHead];
+	readbackHead = (readbackHead + 1) % RingSize;
+	readbacksInFlight--;
+
+	const auto waitStart = std::chrono::steady_clock::now();
+	GLenum waitResult = GL_TIMEOUT_EXPIRED;
+	while ( waitResult == GL_TIMEOUT_EXPIRED )
+	{
+		waitResult = glClientWaitSync( readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100'000'000 );
+	}
+	const std::chrono::duration<double, std::milli> waited = std::chrono::steady_clock::now() - waitStart;
+	waitMilliseconds += waited.count();
+	glDeleteSync( readback.fence );
+	readback.fence = nullptr;
+
+	if ( waitResult == GL_WAIT_FAILED )
+	{
+		std::cout << "FrameCapture::CollectReadback: waiting for the readback failed, skipping a frame" << std::endl;
+		return;
+	}
+
+	std::vector<uint8_t> frame;
+	{
+		std::unique_lock<std::mutex> lock( mutex );
+		if ( freeFrames.empty() )
+		{
+			writerStalls++;
+			frameWritten.wait( lock, [this]() { return !freeFrames.empty(); } );
+		}
+
+		frame = std::move( freeFrames.back() );
+		freeFrames.pop_back();
+	}
+
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.bufferHandle );
+	const void* pixels = glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr( frame.size() ), GL_MAP_READ_BIT );
+	if ( pixels != nullptr )
+	{
+		memcpy( frame.data(), pixels, frame.size() );
+		glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+	}
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	std::lock_guard<std::mutex> lock( mutex );
+	if ( pixels == nullptr )
+	{
+		std::cout << "FrameCapture::CollectReadback: couldn't map the readback buffer, skipping a frame" << std::endl;
+		freeFrames.push_back( std::move( frame ) );
+		return;
+	}
+
+	queuedFrames.push_back( std::move( frame ) );
+	frameQueued.notify_one();
+}
+
+void FrameCapture::WriterThread()
+{
+	TRACE_THREAD_NAME( "Capture writer" );
+
+	while ( true )
+	{
+		std::vector<uint8_t> frame;
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			frameQueued.wait( lock, [this]() { return stopWriter || !queuedFrames.empty(); } );
+
+			// Everything that was queued still gets written
+			if ( queuedFrames.empty() )
+			{
+				return;
+			}
+
+			frame = std::move( queuedFrames.front() );
+			queuedFrames.pop_front();
+		}
+
+		const bool written = !writeFailed && WriteFrame( frame );
+
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			freeFrames.push_back( std::move( frame ) );
+			framesWritten += written ? 1 : 0;
+		}
+		frameWritten.notify_one();
+	}
+}
+
+bool FrameCapture::WriteFrame( const std::vector<uint8_t>& rgba )
+{
+	TRACE_SCOPE( "FrameCapture::WriteFrame" );
+
+	const size_t planeSize = size_t( width ) * height;
+	uint8_t* yPlane = fileFrame.data();
+	uint8_t* uPlane = yPlane + planeSize;
+	uint8_t* vPlane = uPlane + planeSize;
+
+	for ( int y = 0; y < height; y++ )
+	{
+		// GL rows go bottom to top, files go top to bottom
+		const uint8_t* source = rgba.data() + size_t( height - 1 - y ) * width * 4U;
+		const size_t rowStart = size_t( y ) * width;
+
+		if ( !writeY4m )
+		{
+			uint8_t* destination = fileFrame.data() + rowStart * 3U;
+			for ( int x = 0; x < width; x++ )
+			{
+				destination[x * 3 + 0] = source[x * 4 + 0];
+				destination[x * 3 + 1] = source[x * 4 + 1];
+				destination[x * 3 + 2] = source[x * 4 + 2];
+			}
+			continue;
+		}
+
+		// BT.601, limited range, which is what players assume when the header doesn't say
+		for ( int x = 0; x < width; x++ )
+		{
+			const int r = source[x * 4 + 0];
+			const int g = source[x * 4 + 1];
+			const int b = source[x * 4 + 2];
+
+			yPlane[rowStart + x] = uint8_t( ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16 );
+			uPlane[rowStart + x] = uint8_t( ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128 );
+			vPlane[rowStart + x] = uint8_t( ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128 );
+		}
+	}
+
+	bool okay = true;
+	if ( writeY4m )
+	{
+		okay = fputs( "FRAME\n", file ) >= 0;
+	}
+
+	okay = okay && fwrite( fileFrame.data(), 1, fileFrame.size(), file ) == fileFrame.size();
+	if ( !okay )
+	{
+		std::cout << "FrameCapture::WriteFrame: couldn't write to '" << path << "', the rest of the frames are dropped" << std::endl;
+		writeFailed = true;
+	}
+
+	return okay;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,110 @@
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records frames to a video file without stalling the render loop
+//
+// glReadPixels goes into a ring of pixel pack buffers, and a fence says when each one
+// has landed. The copy out of a buffer happens a few frames later, by which point the
+// GPU is long done with it. Files are written on a thread of its own, so disk speed
+// doesn't show up in the frame time either
+//
+// .y4m files are YUV 4:4:4 that ffmpeg and most players read as-is,
+// anything else gets raw top-to-bottom RGB24
+class FrameCapture final
+{
+public:
+    // Frames in flight between glReadPixels and the copy out
+    static constexpr int RingSize = 3;
+    // Copied frames waiting for the writer; if it falls this far behind, capturing waits for it
+    static constexpr int MaxQueuedFrames = 8;
+
+    bool Start( const char* path, const int& width, const int& height, const int& framesPerSecond );
+    // Waits for the frames that are still in flight and for the writer to finish
+    void Stop();
+
+    // Reads back the currently bound read framebuffer, call it after drawing what should be recorded
+    void CaptureFrame();
+
+    bool IsCapturing() const
+    {
+        return capturing;
+    }
+
+private:
+    struct PendingReadback
+    {
+        GLuint bufferHandle{ 0 };
+        GLsync fence{ nullptr };
+    };
+
+    // Copies the oldest readback out of its buffer and hands it to the writer
+    void CollectReadback();
+    void WriterThread();
+    bool WriteFrame( const std::vector<uint8_t>& rgba );
+
+private:
+    bool capturing{ false };
+    std::string path;
+    int width{ 0 };
+    int height{ 0 };
+    bool writeY4m{ false };
+
+    PendingReadback readbacks[RingSize];
+    int readbackHead{ 0 };
+    int readbacksInFlight{ 0 };
+
+    FILE* file{ nullptr };
+    std::thread writer;
+
+    // Buffers go back and forth between these two, so nothing is allocated while recording
+    std::mutex mutex;
+    std::condition_variable frameQueued;
+    std::condition_variable frameWritten;
+    std::deque<std::vector<uint8_t>> queuedFrames;
+    std::vector<std::vector<uint8_t>> freeFrames;
+    bool stopWriter{ false };
+
+    // The writer's conversion buffer, one planar YUV or RGB frame
+    std::vector<uint8_t> fileFrame;
+
+    int framesCaptured{ 0 };
+    int framesWritten{ 0 };
+    int writerStalls{ 0 };
+    bool writeFailed{ false };
+    // Time spent in CaptureFrame, and how much of that was waiting for the GPU to finish a frame,
+    // which is time the swap would have waited otherwise when rendering is GPU-bound
+    double captureMilliseconds{ 0.0 };
+    double worstCaptureMilliseconds{ 0.0 };
+    double waitMilliseconds{ 0.0 };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,230 @@
+
+#include "FrameStats.hpp"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+constexpr int FrameStats::HistorySize;
+constexpr int FrameStats::QueryLatency;
+
+namespace
+{
+	// How quickly the smoothed section times follow the latest ones
+	constexpr float SmoothingFactor = 0.05f;
+
+	const char* GpuPassNames[FrameStats::GpuPassCount] =
+	{
+		"Water",
+		"GUI",
+		"Swap"
+	};
+
+	const char* CpuSectionNames[FrameStats::CpuSectionCount] =
+	{
+		"Events",
+		"GUI",
+		"Upload",
+		"Capture",
+		"Swap"
+	};
+
+	void Smooth( float& smoothed, const float& latest )
+	{
+		smoothed += (latest - smoothed) * SmoothingFactor;
+	}
+}
+
+bool FrameStats::Init()
+{
+	// Timer queries are core in 3.3, but some software rasterisers still fumble them
+	glGetError();
+	glGenQueries( QueryLatency * GpuPassCount, &queries[0][0] );
+	gpuTimersAvailable = glGetError() == GL_NO_ERROR;
+
+	if ( !gpuTimersAvailable )
+	{
+		std::cout << "FrameStats::Init: timer queries aren't available, only CPU times will be shown" << std::endl;
+	}
+
+	return gpuTimersAvailable;
+}
+
+void FrameStats::Shutdown()
+{
+	if ( gpuTimersAvailable )
+	{
+		glDeleteQueries( QueryLatency * GpuPassCount, &queries[0][0] );
+		gpuTimersAvailable = false;
+	}
+}
+
+void FrameStats::BeginFrame()
+{
+	const auto now = Clock::now();
+	if ( hasLastFrame )
+	{
+		const std::chrono::duration<float, std::milli> frameTime = now - lastFrameStart;
+
+		frameTimes[historyHead] = frameTime.count();
+		historyHead = (historyHead + 1) % HistorySize;
+		historyCount = std::min( historyCount + 1, HistorySize );
+	}
+
+	lastFrameStart = now;
+	hasLastFrame = true;
+
+	for ( auto& cpuFrameTime : cpuFrameTimes )
+	{
+		cpuFrameTime = 0.0f;
+	}
+
+	CollectQueries();
+}
+
+void FrameStats::EndFrame()
+{
+	for ( int i = 0; i < CpuSectionCount; i++ )
+	{
+		Smooth( cpuTimes[i], cpuFrameTimes[i] );
+	}
+
+	queryFrame = (queryFrame + 1) % QueryLatency;
+}
+
+void FrameStats::BeginGpuPass( const GpuPass& pass )
+{
+	if ( !gpuTimersAvailable )
+	{
+		return;
+	}
+
+	if ( activeGpuPass != -1 )
+	{
+		std::cout << "FrameStats::BeginGpuPass: '" << GpuPassNames[pass] << "' started inside '"
+			<< GpuPassNames[activeGpuPass] << "', not timing it" << std::endl;
+		return;
+	}
+
+	glBeginQuery( GL_TIME_ELAPSED, queries[queryFrame][pass] );
+	queryIssued[queryFrame][pass] = true;
+	activeGpuPass = pass;
+}
+
+void FrameStats::EndGpuPass( const GpuPass& pass )
+{
+	if ( !gpuTimersAvailable )
+	{
+		return;
+	}
+
+	// Ending a pass that was never begun, or one that got skipped above, would end someone else's query
+	if ( pass != activeGpuPass )
+	{
+		return;
+	}
+
+	glEndQuery( GL_TIME_ELAPSED );
+	activeGpuPass = -1;
+}
+
+void FrameStats::AddCpuTime( const CpuSection& section, const float& milliseconds )
+{
+	cpuFrameTimes[section] += milliseconds;
+}
+
+// The slot we're about to reuse was issued QueryLatency frames ago, which is
+// usually plenty for the GPU to have finished it. If it still hasn't, the sample
+// is simply dropped, because waiting for it is exactly what we're trying to avoid
+void FrameStats::CollectQueries()
+{
+	if ( !gpuTimersAvailable )
+	{
+		return;
+	}
+
+	for ( int pass = 0; pass < GpuPassCount; pass++ )
+	{
+		if ( !queryIssued[queryFrame][pass] )
+		{
+			continue;
+		}
+
+		queryIssued[queryFrame][pass] = false;
+
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv( queries[queryFrame][pass], GL_QUERY_RESULT_AVAILABLE, &available );
+		if ( !available )
+		{
+			continue;
+		}
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v( queries[queryFrame][pass], GL_QUERY_RESULT, &nanoseconds );
+		Smooth( gpuTimes[pass], float( double( nanoseconds ) / 1.0e6 ) );
+	}
+}
+
+void FrameStats::DrawGui()
+{
+	if ( !ImGui::CollapsingHeader( "Performance", ImGuiTreeNodeFlags_DefaultOpen ) )
+	{
+		return;
+	}
+
+	// nth_element shuffles things around, so work on a copy
+	std::array<float, HistorySize> sorted = frameTimes;
+	const float p50 = Percentile( sorted.data(), historyCount, 50.0f );
+	const float p95 = Percentile( sorted.data(), historyCount, 95.0f );
+	const float p99 = Percentile( sorted.data(), historyCount, 99.0f );
+	const float maxTime = historyCount ? *std::max_element( sorted.begin(), sorted.begin() + historyCount ) : 0.0f;
+
+	char overlay[64];
+	snprintf( overlay, sizeof( overlay ), "p50 %.2f ms", p50 );
+
+	// Once the ring is full, the oldest frame sits at the head
+	ImGui::PlotLines( "Frame time", frameTimes.data(), historyCount,
+		historyCount == HistorySize ? historyHead : 0,
+		overlay, 0.0f, std::max( maxTime, 1.0f ), ImVec2( 0.0f, 60.0f ) );
+
+	ImGui::Text( "p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms", p50, p95, p99, maxTime );
+
+	ImGui::Text( "CPU:" );
+	for ( int i = 0; i < CpuSectionCount; i++ )
+	{
+		ImGui::Text( "  %-8s %6.3f ms", CpuSectionNames[i], cpuTimes[i] );
+	}
+
+	if ( !gpuTimersAvailable )
+	{
+		ImGui::TextUnformatted( "GPU: timer queries unavailable" );
+		return;
+	}
+
+	ImGui::Text( "GPU:" );
+	for ( int i = 0; i < GpuPassCount; i++ )
+	{
+		ImGui::Text( "  %-8s %6.3f ms", GpuPassNames[i], gpuTimes[i] );
+	}
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,142 @@
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+#include "Statistics.hpp"
+
+// Keeps track of how long each part of a frame takes, on both the CPU and the GPU
+// GPU times come from GL_TIME_ELAPSED queries that are read back a few frames late,
+// that way we never wait on the GPU just to find out how long it took
+class FrameStats final
+{
+public:
+    enum GpuPass
+    {
+        GpuWater,
+        GpuGui,
+        GpuSwap,
+        GpuPassCount
+    };
+
+    enum CpuSection
+    {
+        CpuEvents,
+        CpuGui,
+        CpuUpload,
+        CpuCapture,
+        CpuSwap,
+        CpuSectionCount
+    };
+
+    // How many frames of frame times the graph shows
+    static constexpr int HistorySize = 240;
+    // How many frames we wait before reading a query back
+    static constexpr int QueryLatency = 4;
+
+    using Clock = std::chrono::steady_clock;
+
+    bool Init();
+    void Shutdown();
+
+    void BeginFrame();
+    void EndFrame();
+
+    void BeginGpuPass( const GpuPass& pass );
+    void EndGpuPass( const GpuPass& pass );
+    void AddCpuTime( const CpuSection& section, const float& milliseconds );
+
+    // Draws into whatever ImGui window is currently open
+    void DrawGui();
+
+private:
+    void CollectQueries();
+
+private:
+    bool gpuTimersAvailable{ false };
+
+    // One set of queries per frame in flight
+    GLuint queries[QueryLatency][GpuPassCount]{};
+    bool queryIssued[QueryLatency][GpuPassCount]{};
+    int queryFrame{ 0 };
+    // GL_TIME_ELAPSED queries can't nest, so only one pass is timed at a time; -1 if none is
+    int activeGpuPass{ -1 };
+
+    std::array<float, HistorySize> frameTimes{};
+    int historyHead{ 0 };
+    int historyCount{ 0 };
+
+    // Smoothed, in milliseconds
+    float gpuTimes[GpuPassCount]{};
+    float cpuTimes[CpuSectionCount]{};
+    // What got added up during the current frame, before smoothing
+    float cpuFrameTimes[CpuSectionCount]{};
+
+    Clock::time_point lastFrameStart{};
+    bool hasLastFrame{ false };
+};
+
+// Adds the time spent in a scope to a CPU section
+class ScopedCpuTimer final
+{
+public:
+    ScopedCpuTimer( FrameStats& frameStats, const FrameStats::CpuSection& cpuSection )
+        : stats( frameStats ), section( cpuSection ), start( FrameStats::Clock::now() )
+    {
+    }
+
+    ~ScopedCpuTimer()
+    {
+        const std::chrono::duration<float, std::milli> elapsed = FrameStats::Clock::now() - start;
+        stats.AddCpuTime( section, elapsed.count() );
+    }
+
+private:
+    FrameStats& stats;
+    FrameStats::CpuSection section;
+    FrameStats::Clock::time_point start;
+};
+
+// Wraps a scope in a GPU timer query, these can't be nested
+class ScopedGpuTimer final
+{
+public:
+    ScopedGpuTimer( FrameStats& frameStats, const FrameStats::GpuPass& gpuPass )
+        : stats( frameStats ), pass( gpuPass )
+    {
+        stats.BeginGpuPass( pass );
+    }
+
+    ~ScopedGpuTimer()
+    {
+        stats.EndGpuPass( pass );
+    }
+
+private:
+    FrameStats& stats;
+    FrameStats::GpuPass pass;
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
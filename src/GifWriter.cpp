@@ -0,0 +1,298 @@
+
+#include "GifWriter.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+namespace
+{
+	// 256 colours, so symbols are 8 bits and codes start at 9
+	constexpr int MinCodeSize = 8;
+	constexpr int ClearCode = 1 << MinCodeSize;
+	constexpr int EndCode = ClearCode + 1;
+	constexpr int MaxCodes = 4096;
+
+	void PutShort( std::vector<uint8_t>& out, const int& value )
+	{
+		out.push_back( uint8_t( value & 0xFF ) );
+		out.push_back( uint8_t( (value >> 8) & 0xFF ) );
+	}
+}
+
+constexpr int GifWriter::LzwEncoder::HashSize;
+
+void GifWriter::LzwEncoder::Encode( const uint8_t* indices, const int& width, const int& height,
+	const bool& flipVertically, std::vector<uint8_t>& out )
+{
+	output = &out;
+	bitBuffer = 0;
+	bitCount = 0;
+	blockSize = 0;
+
+	ResetDictionary();
+	WriteCode( ClearCode );
+
+	int prefix = -1;
+	for ( int y = 0; y < height; y++ )
+	{
+		const int row = flipVertically ? height - 1 - y : y;
+		const uint8_t* rowIndices = indices + size_t( row ) * width;
+
+		for ( int x = 0; x < width; x++ )
+		{
+			const int symbol = rowIndices[x];
+			if ( prefix < 0 )
+			{
+				prefix = symbol;
+				continue;
+			}
+
+			// Look for prefix + symbol in the dictionary
+			const int32_t key = (prefix << 8) | symbol;
+			uint32_t slot = (uint32_t( key ) * 2654435761U) >> (32 - 13);
+			while ( hashKeys[slot] != -1 && hashKeys[slot] != key )
+			{
+				slot = (slot + 1) & (HashSize - 1);
+			}
+
+			if ( hashKeys[slot] == key )
+			{
+				prefix = hashCodes[slot];
+				continue;
+			}
+
+			// Not there, so the prefix goes out and prefix + symbol becomes a new code
+			WriteCode( prefix );
+
+			hashKeys[slot] = key;
+			hashCodes[slot] = int16_t( nextCode );
+			nextCode++;
+
+			// The decoder is always one code behind, which is why this is > rather than >=
+			if ( nextCode > (1 << codeSize) && codeSize < 12 )
+			{
+				codeSize++;
+			}
+
+			// Full, start over
+			if ( nextCode == MaxCodes )
+			{
+				WriteCode( ClearCode );
+				ResetDictionary();
+			}
+
+			prefix = symbol;
+		}
+	}
+
+	if ( prefix >= 0 )
+	{
+		WriteCode( prefix );
+
+		// The decoder adds one more code after reading the last one, and might widen its codes for it
+		nextCode++;
+		if ( nextCode > (1 << codeSize) && codeSize < 12 )
+		{
+			codeSize++;
+		}
+	}
+
+	WriteCode( EndCode );
+
+	// Whatever bits are left, padded to a byte
+	if ( bitCount > 0 )
+	{
+		block[blockSize++] = uint8_t( bitBuffer & 0xFF );
+		bitBuffer = 0;
+		bitCount = 0;
+	}
+	FlushBlock( true );
+
+	// Block terminator
+	out.push_back( 0 );
+	output = nullptr;
+}
+
+void GifWriter::LzwEncoder::ResetDictionary()
+{
+	memset( hashKeys, 0xFF, sizeof( hashKeys ) );
+	codeSize = MinCodeSize + 1;
+	nextCode = EndCode + 1;
+}
+
+void GifWriter::LzwEncoder::WriteCode( const int& code )
+{
+	// GIF packs codes starting from the least significant bit
+	bitBuffer |= uint32_t( code ) << bitCount;
+	bitCount += codeSize;
+
+	while ( bitCount >= 8 )
+	{
+		block[blockSize++] = uint8_t( bitBuffer & 0xFF );
+		bitBuffer >>= 8;
+		bitCount -= 8;
+
+		if ( blockSize == 255 )
+		{
+			FlushBlock( false );
+		}
+	}
+}
+
+void GifWriter::LzwEncoder::FlushBlock( const bool& partial )
+{
+	if ( blockSize == 0 || (!partial && blockSize < 255) )
+	{
+		return;
+	}
+
+	output->push_back( uint8_t( blockSize ) );
+	output->insert( output->end(), block, block + blockSize );
+	blockSize = 0;
+}
+
+bool GifWriter::Write( const char* path, const int& width, const int& height, const PaletteBuffer& palette,
+	const int& numFrames, const int& delayCentiseconds, const FrameSource& source,
+	const bool& flipVertically, const int& numThreads )
+{
+	TRACE_SCOPE( "GifWriter::Write" );
+
+	if ( width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF )
+	{
+		std::cout << "GifWriter::Write: GIF can't be " << width << "x" << height << std::endl;
+		return false;
+	}
+
+	FILE* file = fopen( path, "wb" );
+	if ( file == nullptr )
+	{
+		std::cout << "GifWriter::Write: could not open '" << path << "' for writing" << std::endl;
+		return false;
+	}
+
+	// Each frame is compressed into its own buffer, as many at once as there are jobs
+	std::vector<std::vector<uint8_t>> encodedFrames( numFrames );
+	std::atomic<int> nextFrame{ 0 };
+
+	const auto worker = [&]()
+	{
+		// The encoder has a 48 kB dictionary, so it doesn't go on the stack
+		std::unique_ptr<LzwEncoder> encoder( new LzwEncoder() );
+		std::vector<uint8_t> indices( size_t( width ) * height );
+
+		for ( int frame = nextFrame++; frame < numFrames; frame = nextFrame++ )
+		{
+			TRACE_SCOPE( "GifWriter::EncodeFrame" );
+
+			source( frame, indices.data() );
+			encoder->Encode( indices.data(), width, height, flipVertically, encodedFrames[frame] );
+		}
+	};
+
+	JobSystem& jobs = JobSystem::Get();
+	int workerCount = numThreads > 0 ? numThreads : jobs.GetNumThreads();
+	workerCount = std::max( 1, std::min( workerCount, numFrames ) );
+
+	// One job per encoder rather than per frame, so each dictionary gets reused,
+	// and the calling thread works too
+	JobSystem::Counter counter;
+	for ( int i = 1; i < workerCount; i++ )
+	{
+		jobs.Run( counter, worker );
+	}
+	worker();
+	jobs.Wait( counter );
+
+	std::vector<uint8_t> header;
+	header.reserve( 6 + 7 + 768 + 19 );
+
+	const char signature[] = "GIF89a";
+	header.insert( header.end(), signature, signature + 6 );
+
+	// Logical screen: global colour table of 256 entries with 8 bits per channel
+	PutShort( header, width );
+	PutShort( header, height );
+	header.push_back( 0xF7 );
+	header.push_back( 0 );
+	header.push_back( 0 );
+
+	for ( const PaletteEntry& entry : palette )
+	{
+		header.insert( header.end(), entry, entry + 3 );
+	}
+
+	// NETSCAPE2.0 application extension, loop forever
+	const uint8_t loopExtension[] =
+	{
+		0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+		0x03, 0x01, 0x00, 0x00, 0x00
+	};
+	header.insert( header.end(), loopExtension, loopExtension + sizeof( loopExtension ) );
+
+	bool okay = fwrite( header.data(), 1, header.size(), file ) == header.size();
+
+	for ( int frame = 0; frame < numFrames && okay; frame++ )
+	{
+		std::vector<uint8_t> frameHeader;
+		frameHeader.reserve( 8 + 10 + 1 );
+
+		// Graphic control extension: frames cover each other completely, so no disposal and no transparency
+		frameHeader.push_back( 0x21 );
+		frameHeader.push_back( 0xF9 );
+		frameHeader.push_back( 0x04 );
+		frameHeader.push_back( 0x04 );
+		PutShort( frameHeader, delayCentiseconds );
+		frameHeader.push_back( 0 );
+		frameHeader.push_back( 0 );
+
+		// Image descriptor covering the whole screen, using the global colour table
+		frameHeader.push_back( 0x2C );
+		PutShort( frameHeader, 0 );
+		PutShort( frameHeader, 0 );
+		PutShort( frameHeader, width );
+		PutShort( frameHeader, height );
+		frameHeader.push_back( 0 );
+
+		frameHeader.push_back( MinCodeSize );
+
+		const std::vector<uint8_t>& data = encodedFrames[frame];
+		okay = fwrite( frameHeader.data(), 1, frameHeader.size(), file ) == frameHeader.size()
+			&& fwrite( data.data(), 1, data.size(), file ) == data.size();
+	}
+
+	// Trailer
+	okay = okay && fputc( 0x3B, file ) != EOF;
+	okay = (fclose( file ) == 0) && okay;
+
+	if ( !okay )
+	{
+		std::cout << "GifWriter::Write: failed while writing '" << path << "'" << std::endl;
+	}
+
+	return okay;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,79 @@
+
+#pragma once
+
+#include "TextureProvider.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Writes looping animated GIFs straight from palette indices
+// The water is already 8-bit paletted, so the texture's palette goes in as the global
+// colour table and there's no quantisation at all
+//
+// Every frame is rendered and LZW-compressed on its own, so frames are spread over
+// jobs and only the final file is put together in order
+class GifWriter final
+{
+public:
+    // Fills width * height indices for the given frame, may be called from any job
+    using FrameSource = std::function<void( const int& frame, uint8_t* outIndices )>;
+
+    // delayCentiseconds is how long each frame shows, GIF can't do finer than that
+    // Flip it if the source gives rows bottom to top, like SoftwareWater and glReadPixels do
+    // numThreads 0 means one encoder per job system thread
+    static bool Write( const char* path, const int& width, const int& height, const PaletteBuffer& palette,
+        const int& numFrames, const int& delayCentiseconds, const FrameSource& source,
+        const bool& flipVertically, const int& numThreads = 0 );
+
+private:
+    // Variable-length LZW as GIF wants it: 8-bit symbols, up to 12-bit codes,
+    // already split into sub-blocks of up to 255 bytes and ending with the terminator
+    class LzwEncoder final
+    {
+    public:
+        void Encode( const uint8_t* indices, const int& width, const int& height,
+            const bool& flipVertically, std::vector<uint8_t>& out );
+
+    private:
+        void ResetDictionary();
+        void WriteCode( const int& code );
+        void FlushBlock( const bool& partial );
+
+    private:
+        // Open addressing, keyed by (prefix code << 8 | next symbol), twice as big as the 4096 codes
+        static constexpr int HashSize = 8192;
+        int32_t hashKeys[HashSize];
+        int16_t hashCodes[HashSize];
+
+        int codeSize{ 0 };
+        int nextCode{ 0 };
+
+        uint32_t bitBuffer{ 0 };
+        int bitCount{ 0 };
+
+        uint8_t block[255];
+        int blockSize{ 0 };
+        std::vector<uint8_t>* output{ nullptr };
+    };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,178 @@
+
+#include "GuardBand.hpp"
+
+#include <cstring>
+
+constexpr size_t GuardBand::Alignment;
+constexpr int GuardBand::DefaultGuard;
+
+namespace
+{
+	size_t AlignUp( const size_t& value )
+	{
+		return (value + GuardBand::Alignment - 1) & ~(GuardBand::Alignment - 1);
+	}
+
+	int Wrap( const int& coord, const int& size )
+	{
+		const int result = coord % size;
+		return result < 0 ? result + size : result;
+	}
+}
+
+GuardBand::GuardBand( const GuardBand& other )
+{
+	*this = other;
+}
+
+GuardBand& GuardBand::operator=( const GuardBand& other )
+{
+	if ( this == &other )
+	{
+		return *this;
+	}
+
+	width = other.width;
+	height = other.height;
+	guard = other.guard;
+	leftPadding = other.leftPadding;
+	stride = other.stride;
+
+	if ( other.storage.empty() )
+	{
+		storage.clear();
+		storage.shrink_to_fit();
+		return *this;
+	}
+
+	// Same size, but the rows go wherever this one's start rounds up to
+	storage.resize( other.storage.size() );
+	memcpy( storage.data() + GetStartOffset(), other.storage.data() + other.GetStartOffset(),
+		stride * (height + 2U * guard) );
+	return *this;
+}
+
+void GuardBand::Build( const uint8_t* texels, const uint32_t& textureWidth, const uint32_t& textureHeight, const int& guardTexels )
+{
+	width = textureWidth;
+	height = textureHeight;
+	guard = guardTexels > 0 ? guardTexels : 0;
+	leftPadding = 0;
+	stride = 0;
+
+	if ( guard == 0 || width == 0 || height == 0 )
+	{
+		guard = 0;
+		storage.clear();
+		storage.shrink_to_fit();
+		return;
+	}
+
+	// Every byte gets written below, rebuilding at the same size doesn't allocate
+	leftPadding = AlignUp( size_t( guard ) );
+	stride = AlignUp( leftPadding + width + size_t( guard ) );
+	storage.resize( stride * (height + 2U * guard) + Alignment - 1 );
+
+	for ( int y = -guard; y < int( height ) + guard; y++ )
+	{
+		BuildRow( texels, y );
+	}
+}
+
+void GuardBand::UpdateRows( const uint8_t* texels, const uint32_t& firstRow, const uint32_t& numRows )
+{
+	if ( storage.empty() )
+	{
+		return;
+	}
+
+	// A row shows up once in the middle, and again in the border above or below if it's near an edge
+	for ( int y = -guard; y < int( height ) + guard; y++ )
+	{
+		const uint32_t textureRow = uint32_t( Wrap( y, int( height ) ) );
+		if ( textureRow >= firstRow && textureRow - firstRow < numRows )
+		{
+			BuildRow( texels, y );
+		}
+	}
+}
+
+bool GuardBand::HasSameTexels( const GuardBand& other ) const
+{
+	if ( width != other.width || height != other.height || guard != other.guard || stride != other.stride )
+	{
+		return false;
+	}
+
+	if ( storage.empty() || other.storage.empty() )
+	{
+		return storage.empty() == other.storage.empty();
+	}
+
+	const size_t rowBytes = width + 2U * guard;
+	for ( int y = -guard; y < int( height ) + guard; y++ )
+	{
+		const uint8_t* row = GetOrigin() + ptrdiff_t( y ) * ptrdiff_t( stride ) - guard;
+		const uint8_t* otherRow = other.GetOrigin() + ptrdiff_t( y ) * ptrdiff_t( stride ) - guard;
+		if ( memcmp( row, otherRow, rowBytes ) != 0 )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uint8_t* GuardBand::GetRow( const int& y )
+{
+	return storage.data() + GetStartOffset() + (ptrdiff_t( y ) + guard) * ptrdiff_t( stride ) + ptrdiff_t( leftPadding );
+}
+
+size_t GuardBand::GetStartOffset() const
+{
+	const uintptr_t start = reinterpret_cast<uintptr_t>( storage.data() );
+	return size_t( ((start + Alignment - 1) & ~uintptr_t( Alignment - 1 )) - start );
+}
+
+void GuardBand::BuildRow( const uint8_t* texels, const int& y )
+{
+	const uint8_t* source = texels + size_t( Wrap( y, int( height ) ) ) * width;
+	uint8_t* row = GetRow( y );
+	memcpy( row, source, width );
+
+	// Then the borders a texel at a time, alignment slack included so nothing's left uninitialised
+	// They're narrow, and the texture might be narrower still, so this just keeps going round it
+	const auto fill = [&]( uint8_t* begin, uint8_t* end, int column )
+	{
+		for ( uint8_t* texel = begin; texel < end; texel++ )
+		{
+			*texel = source[column];
+			if ( ++column == int( width ) )
+			{
+				column = 0;
+			}
+		}
+	};
+
+	fill( row - leftPadding, row, Wrap( -int( leftPadding ), int( width ) ) );
+	fill( row + width, row - leftPadding + stride, 0 );
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
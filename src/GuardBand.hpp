@@ -0,0 +1,103 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A copy of a texture's texels with a border of wrapped-around texels all the way round it,
+// so a kernel reading up to guard texels off any edge gets what GL_REPEAT would give
+// without a modulo per sample
+//
+// Texel 0 of every row sits on a 64-byte boundary and rows are a multiple of 64 bytes,
+// so SIMD kernels can load whole vectors straight across the edges
+// Texture keeps one of these up to date by itself, see Texture::SetGuardBand
+class GuardBand final
+{
+public:
+    static constexpr size_t Alignment = 64;
+    // The ripples sample 48 texels to the left and 32 rows down, and a 16-texel vector
+    // starting at the last texel of a row runs 15 past it, so this covers all of them
+    static constexpr int DefaultGuard = 48;
+
+    GuardBand() = default;
+    // A copied vector keeps the bytes where they were, but its own start is aligned differently,
+    // so copies lay the rows out again against their own storage
+    GuardBand( const GuardBand& other );
+    GuardBand& operator=( const GuardBand& other );
+    // Moving hands the same storage over, so the rows stay where they are
+    GuardBand( GuardBand&& other ) = default;
+    GuardBand& operator=( GuardBand&& other ) = default;
+
+    // texels is width * height, row by row; guard 0 drops the copy
+    void Build( const uint8_t* texels, const uint32_t& width, const uint32_t& height, const int& guard );
+    // Redoes every padded row that repeats one of rows [firstRow, firstRow + numRows)
+    // texels is the whole texture again, with those rows changed
+    void UpdateRows( const uint8_t* texels, const uint32_t& firstRow, const uint32_t& numRows );
+
+    bool IsEmpty() const
+    {
+        return storage.empty();
+    }
+
+    // Texel (0, 0); (x, y) is at GetOrigin() + y * GetStride() + x, for anything from
+    // -guard to width + guard - 1 across, and -guard to height + guard - 1 down
+    const uint8_t* GetOrigin() const
+    {
+        return const_cast<GuardBand*>( this )->GetRow( 0 );
+    }
+
+    size_t GetStride() const
+    {
+        return stride;
+    }
+
+    int GetGuard() const
+    {
+        return guard;
+    }
+
+    // Whether every texel, borders included, reads the same as in other
+    bool HasSameTexels( const GuardBand& other ) const;
+
+    // Everything on top of the texture's own width * height, alignment included
+    size_t GetOverheadBytes() const
+    {
+        return storage.size() - (storage.empty() ? 0 : size_t( width ) * height);
+    }
+
+private:
+    uint8_t* GetRow( const int& y );
+    // Where texel 0 of row -guard is, rounded up from the start of storage
+    size_t GetStartOffset() const;
+    void BuildRow( const uint8_t* texels, const int& y );
+
+private:
+    // Has room to round the start up to Alignment, wherever the allocation happens to land
+    std::vector<uint8_t> storage;
+    uint32_t width{ 0 };
+    uint32_t height{ 0 };
+    int guard{ 0 };
+    // The left border is rounded up to Alignment so texel 0 lands on a boundary
+    size_t leftPadding{ 0 };
+    size_t stride{ 0 };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
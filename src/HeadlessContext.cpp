@@ -0,0 +1,285 @@
+
+#include "HeadlessContext.hpp"
+
+#include <cstring>
+#include <iostream>
+
+#ifndef SWATER_HEADLESS
+#define SWATER_HEADLESS 0
+#endif
+
+#if SWATER_HEADLESS
+// Keeps eglplatform.h from including Xlib, which #defines all sorts of things
+#define EGL_NO_X11 1
+#define MESA_EGL_NO_X11_HEADERS 1
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+namespace
+{
+	// Same as what we ask SDL for
+	const EGLint ContextAttributes[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+}
+#endif
+
+bool HeadlessContext::IsAvailable()
+{
+	return SWATER_HEADLESS != 0;
+}
+
+#if SWATER_HEADLESS
+
+bool HeadlessContext::Create()
+{
+	const auto hasExtension = []( const char* extensions, const char* name )
+	{
+		return extensions != nullptr && strstr( extensions, name ) != nullptr;
+	};
+
+	// Client extensions are queried without a display
+	const char* clientExtensions = eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	if ( hasExtension( clientExtensions, "EGL_MESA_platform_surfaceless" )
+		&& hasExtension( clientExtensions, "EGL_EXT_platform_base" ) )
+	{
+		const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+			eglGetProcAddress( "eglGetPlatformDisplayEXT" ) );
+
+		if ( getPlatformDisplay != nullptr )
+		{
+			eglDisplay = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr );
+		}
+	}
+
+	// Not Mesa, or an old one; the default display might still do surfaceless contexts
+	if ( eglDisplay == EGL_NO_DISPLAY )
+	{
+		eglDisplay = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+	}
+
+	EGLint major = 0;
+	EGLint minor = 0;
+	if ( eglDisplay == EGL_NO_DISPLAY || !eglInitialize( eglDisplay, &major, &minor ) )
+	{
+		std::cout << "HeadlessContext::Create: couldn't initialise an EGL display (0x"
+			<< std::hex << eglGetError() << std::dec << ")" << std::endl;
+		return false;
+	}
+	display = eglDisplay;
+
+	const char* displayExtensions = eglQueryString( eglDisplay, EGL_EXTENSIONS );
+	if ( !hasExtension( displayExtensions, "EGL_KHR_surfaceless_context" ) )
+	{
+		std::cout << "HeadlessContext::Create: EGL " << major << "." << minor
+			<< " doesn't support surfaceless contexts" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	if ( !eglBindAPI( EGL_OPENGL_API ) )
+	{
+		std::cout << "HeadlessContext::Create: EGL can't do desktop OpenGL here" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	// We never render to an EGL surface, so a config is only needed if the driver insists
+	EGLConfig eglConfig = EGL_NO_CONFIG_KHR;
+	if ( !hasExtension( displayExtensions, "EGL_KHR_no_config_context" ) )
+	{
+		const EGLint configAttributes[] =
+		{
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+
+		EGLint numConfigs = 0;
+		if ( !eglChooseConfig( eglDisplay, configAttributes, &eglConfig, 1, &numConfigs ) || numConfigs == 0 )
+		{
+			std::cout << "HeadlessContext::Create: no usable EGL config" << std::endl;
+			Destroy();
+			return false;
+		}
+	}
+
+	EGLContext eglContext = eglCreateContext( eglDisplay, eglConfig, EGL_NO_CONTEXT, ContextAttributes );
+	if ( eglContext == EGL_NO_CONTEXT )
+	{
+		std::cout << "HeadlessContext::Create: couldn't create a 3.3 core context (0x"
+			<< std::hex << eglGetError() << std::dec << ")" << std::endl;
+		Destroy();
+		return false;
+	}
+	context = eglContext;
+	config = eglConfig;
+
+	if ( !eglMakeCurrent( eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext ) )
+	{
+		std::cout << "HeadlessContext::Create: couldn't make the context current" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	std::cout << "HeadlessContext: EGL " << major << "." << minor << " by "
+		<< eglQueryString( eglDisplay, EGL_VENDOR ) << std::endl;
+	return true;
+}
+
+void HeadlessContext::Destroy()
+{
+	if ( context != nullptr && framebufferHandle )
+	{
+		glDeleteFramebuffers( 1, &framebufferHandle );
+		glDeleteRenderbuffers( 1, &colourBufferHandle );
+		glDeleteRenderbuffers( 1, &depthBufferHandle );
+	}
+
+	framebufferHandle = 0;
+	colourBufferHandle = 0;
+	depthBufferHandle = 0;
+
+	if ( display != nullptr )
+	{
+		eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+
+		if ( context != nullptr )
+		{
+			eglDestroyContext( display, context );
+		}
+
+		eglTerminate( display );
+	}
+
+	context = nullptr;
+	config = nullptr;
+	display = nullptr;
+}
+
+void* HeadlessContext::CreateSharedContext()
+{
+	if ( context == nullptr )
+	{
+		return nullptr;
+	}
+
+	EGLContext sharedContext = eglCreateContext( display, config, context, ContextAttributes );
+	if ( sharedContext == EGL_NO_CONTEXT )
+	{
+		std::cout << "HeadlessContext::CreateSharedContext: couldn't create one (0x"
+			<< std::hex << eglGetError() << std::dec << ")" << std::endl;
+		return nullptr;
+	}
+
+	return sharedContext;
+}
+
+void HeadlessContext::DestroySharedContext( void* sharedContext )
+{
+	if ( display != nullptr && sharedContext != nullptr )
+	{
+		eglDestroyContext( display, sharedContext );
+	}
+}
+
+bool HeadlessContext::MakeCurrent( void* sharedContext )
+{
+	if ( sharedContext == nullptr )
+	{
+		// Lets go of the thread's EGL state too, it's about to end
+		eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+		eglReleaseThread();
+		return true;
+	}
+
+	return eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, sharedContext ) == EGL_TRUE;
+}
+
+#else
+
+bool HeadlessContext::Create()
+{
+	std::cout << "HeadlessContext::Create: this build has no headless support (EGL wasn't found)" << std::endl;
+	return false;
+}
+
+void HeadlessContext::Destroy()
+{
+}
+
+void* HeadlessContext::CreateSharedContext()
+{
+	return nullptr;
+}
+
+void HeadlessContext::DestroySharedContext( void* )
+{
+}
+
+bool HeadlessContext::MakeCurrent( void* )
+{
+	return false;
+}
+
+#endif
+
+bool HeadlessContext::CreateFramebuffer( const int& framebufferWidth, const int& framebufferHeight )
+{
+	width = framebufferWidth;
+	height = framebufferHeight;
+
+	glGenRenderbuffers( 1, &colourBufferHandle );
+	glBindRenderbuffer( GL_RENDERBUFFER, colourBufferHandle );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+
+	// The window has a depth buffer, so this gets one too
+	glGenRenderbuffers( 1, &depthBufferHandle );
+	glBindRenderbuffer( GL_RENDERBUFFER, depthBufferHandle );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height );
+
+	glGenFramebuffers( 1, &framebufferHandle );
+	glBindFramebuffer( GL_FRAMEBUFFER, framebufferHandle );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourBufferHandle );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBufferHandle );
+
+	const GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	if ( status != GL_FRAMEBUFFER_COMPLETE )
+	{
+		std::cout << "HeadlessContext::CreateFramebuffer: framebuffer is incomplete (0x"
+			<< std::hex << status << std::dec << ")" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void HeadlessContext::BindFramebuffer() const
+{
+	glBindFramebuffer( GL_FRAMEBUFFER, framebufferHandle );
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
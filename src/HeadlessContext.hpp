@@ -0,0 +1,74 @@
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+// An OpenGL context without a window, for render servers and CI containers
+// It goes through EGL, preferably on Mesa's surfaceless platform, which works with
+// llvmpipe and doesn't need a display server or a GPU. Since there's no default
+// framebuffer, everything is rendered into an FBO that the frames are read back from
+//
+// Only available when built with SWATER_HEADLESS, which CMake enables if it finds EGL
+class HeadlessContext final
+{
+public:
+    // Creates the context and makes it current, call glewInit after this
+    bool Create();
+    // Needs GL functions, so it goes after glewInit
+    bool CreateFramebuffer( const int& width, const int& height );
+    void Destroy();
+
+    // Another context sharing objects with this one, for a thread of its own; null if it can't be made
+    void* CreateSharedContext();
+    void DestroySharedContext( void* sharedContext );
+    // On the calling thread; null lets go of whatever's current there
+    bool MakeCurrent( void* sharedContext );
+
+    void BindFramebuffer() const;
+
+    int GetWidth() const
+    {
+        return width;
+    }
+
+    int GetHeight() const
+    {
+        return height;
+    }
+
+    static bool IsAvailable();
+
+private:
+    // EGL types are kept out of the header, their platform headers like to drag X11 along
+    void* display{ nullptr };
+    void* context{ nullptr };
+    // Whatever the main context was made with, so shared ones can match
+    void* config{ nullptr };
+
+    GLuint framebufferHandle{ 0 };
+    GLuint colourBufferHandle{ 0 };
+    GLuint depthBufferHandle{ 0 };
+
+    int width{ 0 };
+    int height{ 0 };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -12,7 +12,7 @@ public:
         Success = 0
     };
     
-    virtual int Run() = 0;
+    virtual int Run( int argc, char** argv ) = 0;
 };
 
 extern IApp& GetApp();
@@ -0,0 +1,141 @@
+
+#include "ImageCompare.hpp"
+
+#include <cmath>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 2)
+#define SWATER_SSE2 1
+#include <emmintrin.h>
+#else
+#define SWATER_SSE2 0
+#endif
+
+constexpr double ImageCompare::MaxPsnr;
+
+namespace
+{
+	size_t CountMismatchesScalar( const uint8_t* a, const uint8_t* b, const size_t& count )
+	{
+		size_t mismatches = 0;
+		for ( size_t i = 0; i < count; i++ )
+		{
+			mismatches += a[i] != b[i];
+		}
+		return mismatches;
+	}
+
+	uint64_t SumSquaredDifferencesScalar( const uint8_t* a, const uint8_t* b, const size_t& count )
+	{
+		uint64_t sum = 0;
+		for ( size_t i = 0; i < count; i++ )
+		{
+			const int difference = int( a[i] ) - int( b[i] );
+			sum += uint64_t( difference * difference );
+		}
+		return sum;
+	}
+
+#if SWATER_SSE2
+	int PopCount( unsigned int value )
+	{
+		int bits = 0;
+		for ( ; value != 0; value &= value - 1 )
+		{
+			bits++;
+		}
+		return bits;
+	}
+#endif
+}
+
+size_t ImageCompare::CountMismatches( const uint8_t* a, const uint8_t* b, const size_t& count )
+{
+	size_t i = 0;
+	size_t mismatches = 0;
+
+#if SWATER_SSE2
+	// 16 bytes at a time; the compare gives 0xFF for equal bytes, movemask packs them into 16 bits
+	for ( ; i + 16 <= count; i += 16 )
+	{
+		const __m128i va = _mm_loadu_si128( reinterpret_cast<const __m128i*>( a + i ) );
+		const __m128i vb = _mm_loadu_si128( reinterpret_cast<const __m128i*>( b + i ) );
+		const unsigned int equalMask = unsigned( _mm_movemask_epi8( _mm_cmpeq_epi8( va, vb ) ) );
+
+		if ( equalMask != 0xFFFFU )
+		{
+			mismatches += 16 - PopCount( equalMask );
+		}
+	}
+#endif
+
+	return mismatches + CountMismatchesScalar( a + i, b + i, count - i );
+}
+
+uint64_t ImageCompare::SumSquaredDifferences( const uint8_t* a, const uint8_t* b, const size_t& count )
+{
+	size_t i = 0;
+	uint64_t sum = 0;
+
+#if SWATER_SSE2
+	const __m128i zero = _mm_setzero_si128();
+
+	// Each 32-bit lane takes at most 4 * 255^2 per step, so flush into 64 bits
+	// well before it could overflow
+	constexpr size_t BlockSize = 16 * 1024;
+	while ( i + 16 <= count )
+	{
+		const size_t blockEnd = (count - i) > BlockSize ? i + BlockSize : count;
+
+		__m128i blockSum = _mm_setzero_si128();
+		for ( ; i + 16 <= blockEnd; i += 16 )
+		{
+			const __m128i va = _mm_loadu_si128( reinterpret_cast<const __m128i*>( a + i ) );
+			const __m128i vb = _mm_loadu_si128( reinterpret_cast<const __m128i*>( b + i ) );
+
+			// Widen to 16 bits, subtract, then madd squares and adds neighbouring pairs
+			const __m128i low = _mm_sub_epi16( _mm_unpacklo_epi8( va, zero ), _mm_unpacklo_epi8( vb, zero ) );
+			const __m128i high = _mm_sub_epi16( _mm_unpackhi_epi8( va, zero ), _mm_unpackhi_epi8( vb, zero ) );
+			blockSum = _mm_add_epi32( blockSum, _mm_madd_epi16( low, low ) );
+			blockSum = _mm_add_epi32( blockSum, _mm_madd_epi16( high, high ) );
+		}
+
+		alignas( 16 ) uint32_t lanes[4];
+		_mm_store_si128( reinterpret_cast<__m128i*>( lanes ), blockSum );
+		sum += uint64_t( lanes[0] ) + lanes[1] + lanes[2] + lanes[3];
+	}
+#endif
+
+	return sum + SumSquaredDifferencesScalar( a + i, b + i, count - i );
+}
+
+double ImageCompare::Psnr( const uint8_t* a, const uint8_t* b, const size_t& count )
+{
+	const uint64_t sum = SumSquaredDifferences( a, b, count );
+	if ( sum == 0 || count == 0 )
+	{
+		return MaxPsnr;
+	}
+
+	const double meanSquaredError = double( sum ) / double( count );
+	const double psnr = 10.0 * std::log10( (255.0 * 255.0) / meanSquaredError );
+	return psnr < MaxPsnr ? psnr : MaxPsnr;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,42 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Byte-by-byte image metrics for the golden image checks
+// Uses SSE2 where the compiler has it (always on x86-64), plain loops otherwise
+class ImageCompare final
+{
+public:
+    // How many bytes differ, for comparing palette indices exactly
+    static size_t CountMismatches( const uint8_t* a, const uint8_t* b, const size_t& count );
+
+    // Sum of (a - b)^2 over all bytes
+    static uint64_t SumSquaredDifferences( const uint8_t* a, const uint8_t* b, const size_t& count );
+
+    // Peak signal-to-noise ratio in dB, for 8-bit channels
+    // Identical images would be infinite, they get MaxPsnr instead so it can go in a report
+    static double Psnr( const uint8_t* a, const uint8_t* b, const size_t& count );
+
+    static constexpr double MaxPsnr = 99.0;
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
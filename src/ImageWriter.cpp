@@ -0,0 +1,55 @@
+
+#include "ImageWriter.hpp"
+
+#include <cstdio>
+#include <iostream>
+
+bool ImageWriter::WritePpm( const char* path, const int& width, const int& height,
+	const uint8_t* rgb, const bool& flipVertically )
+{
+	FILE* file = fopen( path, "wb" );
+	if ( file == nullptr )
+	{
+		std::cout << "ImageWriter::WritePpm: could not open '" << path << "' for writing" << std::endl;
+		return false;
+	}
+
+	fprintf( file, "P6\n%i %i\n255\n", width, height );
+
+	const size_t rowSize = size_t( width ) * 3U;
+	bool okay = true;
+	for ( int y = 0; y < height && okay; y++ )
+	{
+		// PPM goes top to bottom, GL goes bottom to top
+		const int row = flipVertically ? height - 1 - y : y;
+		okay = fwrite( rgb + rowSize * row, 1, rowSize, file ) == rowSize;
+	}
+
+	fclose( file );
+
+	if ( !okay )
+	{
+		std::cout << "ImageWriter::WritePpm: failed while writing '" << path << "'" << std::endl;
+	}
+
+	return okay;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,262 @@
+
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <string>
+#include <utility>
+
+constexpr uint32_t JobSystem::QueueCapacity;
+
+#if defined( _WIN32 )
+#define NOMINMAX
+#include <Windows.h>
+#elif defined( __linux__ )
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	// Which deque the current thread owns, and in which job system, since the benchmark has a few
+	thread_local const JobSystem* currentSystem = nullptr;
+	thread_local int currentQueue = 0;
+
+	int configuredThreads = 0;
+	bool configuredPinThreads = false;
+
+	// Rounds of looking for work a worker does before going to sleep, jobs often come
+	// in bursts and waking up a sleeping thread takes a lot longer than this
+	constexpr int SpinsBeforeSleeping = 64;
+
+	void PinThread( std::thread& thread, const int& core )
+	{
+#if defined( _WIN32 )
+		SetThreadAffinityMask( thread.native_handle(), DWORD_PTR( 1 ) << core );
+#elif defined( __linux__ )
+		cpu_set_t cpuSet;
+		CPU_ZERO( &cpuSet );
+		CPU_SET( core, &cpuSet );
+		pthread_setaffinity_np( thread.native_handle(), sizeof( cpuSet ), &cpuSet );
+#else
+		// Nothing to do it with, the OS will have to make do
+		(void)thread;
+		(void)core;
+#endif
+	}
+}
+
+JobSystem::JobSystem( const int& numThreads, const bool& pinThreads )
+{
+	const int hardwareThreads = std::max( 1, int( std::thread::hardware_concurrency() ) );
+	const int workerCount = (numThreads > 0 ? numThreads : hardwareThreads) - 1;
+
+	for ( int i = 0; i <= workerCount; i++ )
+	{
+		queues.push_back( std::make_unique<Queue>() );
+	}
+
+	workers.reserve( workerCount );
+	for ( int i = 0; i < workerCount; i++ )
+	{
+		workers.emplace_back( &JobSystem::WorkerMain, this, i + 1 );
+		// Core 0 is left to the main thread
+		if ( pinThreads )
+		{
+			PinThread( workers.back(), (i + 1) % hardwareThreads );
+		}
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock( sleepMutex );
+		stop.store( true, std::memory_order_release );
+	}
+	wakeUp.notify_all();
+
+	for ( std::thread& worker : workers )
+	{
+		worker.join();
+	}
+}
+
+JobSystem& JobSystem::Get()
+{
+	static JobSystem system( configuredThreads, configuredPinThreads );
+	return system;
+}
+
+void JobSystem::Configure( const int& numThreads, const bool& pinThreads )
+{
+	configuredThreads = numThreads;
+	configuredPinThreads = pinThreads;
+}
+
+void JobSystem::Run( Counter& counter, std::function<void()> job )
+{
+	counter.pending.fetch_add( 1, std::memory_order_relaxed );
+
+	const int queueIndex = GetQueueIndex();
+	Queue& queue = *queues[queueIndex];
+	Job newJob{ std::move( job ), &counter };
+	while ( true )
+	{
+		{
+			std::lock_guard<std::mutex> lock( queue.mutex );
+			if ( !queue.IsFull() )
+			{
+				queue.PushBack( std::move( newJob ) );
+				break;
+			}
+		}
+
+		// There's more queued up than everyone can get through for now, so help out until there's room
+		Job queuedJob;
+		if ( FindJob( queueIndex, queuedJob ) )
+		{
+			Execute( queuedJob );
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+	queuedJobs.fetch_add( 1, std::memory_order_seq_cst );
+
+	// Usually somebody's awake already and this is all it costs. Otherwise taking the lock
+	// makes sure a worker that's about to sleep either sees the job or gets the notify
+	if ( sleepingWorkers.load( std::memory_order_seq_cst ) > 0 )
+	{
+		{
+			std::lock_guard<std::mutex> lock( sleepMutex );
+		}
+		wakeUp.notify_one();
+	}
+}
+
+void JobSystem::Wait( Counter& counter )
+{
+	const int queueIndex = GetQueueIndex();
+
+	Job job;
+	while ( counter.pending.load( std::memory_order_acquire ) > 0 )
+	{
+		if ( FindJob( queueIndex, job ) )
+		{
+			Execute( job );
+		}
+		else
+		{
+			// Whatever's left is running on other threads
+			std::this_thread::yield();
+		}
+	}
+}
+
+int JobSystem::GetQueueIndex() const
+{
+	return currentSystem == this ? currentQueue : 0;
+}
+
+bool JobSystem::FindJob( const int& queueIndex, Job& outJob )
+{
+	if ( queuedJobs.load( std::memory_order_acquire ) <= 0 )
+	{
+		return false;
+	}
+
+	// Own deque first, newest job first
+	{
+		Queue& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock( queue.mutex );
+		if ( !queue.IsEmpty() )
+		{
+			queue.PopBack( outJob );
+			queuedJobs.fetch_sub( 1, std::memory_order_relaxed );
+			return true;
+		}
+	}
+
+	// Then everyone else's, oldest job first, starting from the next one along so
+	// the thieves don't all pile onto the same deque
+	const int numQueues = int( queues.size() );
+	for ( int i = 1; i < numQueues; i++ )
+	{
+		Queue& queue = *queues[(queueIndex + i) % numQueues];
+		std::lock_guard<std::mutex> lock( queue.mutex );
+		if ( !queue.IsEmpty() )
+		{
+			queue.PopFront( outJob );
+			queuedJobs.fetch_sub( 1, std::memory_order_relaxed );
+			jobsStolen.fetch_add( 1, std::memory_order_relaxed );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute( Job& job )
+{
+	job.work();
+	job.work = nullptr;
+
+	jobsRun.fetch_add( 1, std::memory_order_relaxed );
+	job.counter->pending.fetch_sub( 1, std::memory_order_release );
+}
+
+void JobSystem::WorkerMain( const int& queueIndex )
+{
+	const std::string name = "Job worker " + std::to_string( queueIndex );
+	TRACE_THREAD_NAME( name.c_str() );
+
+	currentSystem = this;
+	currentQueue = queueIndex;
+
+	Job job;
+	int idleRounds = 0;
+	while ( !stop.load( std::memory_order_acquire ) )
+	{
+		if ( FindJob( queueIndex, job ) )
+		{
+			Execute( job );
+			idleRounds = 0;
+			continue;
+		}
+
+		if ( ++idleRounds < SpinsBeforeSleeping )
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( sleepMutex );
+		sleepingWorkers.fetch_add( 1, std::memory_order_seq_cst );
+		wakeUp.wait( lock, [this]()
+		{
+			return stop.load( std::memory_order_acquire ) || queuedJobs.load( std::memory_order_seq_cst ) > 0;
+		} );
+		sleepingWorkers.fetch_sub( 1, std::memory_order_relaxed );
+		idleRounds = 0;
+	}
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
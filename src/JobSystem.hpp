@@ -0,0 +1,222 @@
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A pool of worker threads that everything parallel goes through, instead of each
+// feature starting threads of its own
+//
+// Every worker has its own deque of jobs. New jobs go on the back of the deque of
+// whoever starts them, and that thread takes from the back too, so it gets to the
+// freshest (and most cache-friendly) work first. A worker with nothing left steals
+// from the front of somebody else's, which is the oldest and usually the biggest
+// chunk of work. Threads that aren't workers share one extra deque
+//
+// The deques are fixed-size rings, allocated once up front, so starting and running jobs
+// never touches the heap. Whoever finds theirs full runs some of its jobs to make room
+//
+// Waiting never blocks: a thread waiting on a counter runs jobs until it's done, so
+// jobs can start jobs and wait on them without tying up a worker
+class JobSystem final
+{
+public:
+    // How many jobs are still to finish, Wait on it to wait for all of them
+    // A job that starts more jobs on the counter it was started with keeps it above zero
+    // until those are done too, so waiting on a parent job waits for all of its children
+    class Counter final
+    {
+    public:
+        bool IsDone() const
+        {
+            return pending.load( std::memory_order_acquire ) == 0;
+        }
+
+    private:
+        friend class JobSystem;
+        std::atomic<int> pending{ 0 };
+    };
+
+    // numThreads counts the thread that waits too, so 1 does everything right there on it,
+    // and 0 means one per hardware thread
+    // pinThreads puts each worker on a core of its own, which helps when nothing else is running
+    explicit JobSystem( const int& numThreads = 0, const bool& pinThreads = false );
+    ~JobSystem();
+
+    JobSystem( const JobSystem& ) = delete;
+    JobSystem& operator=( const JobSystem& ) = delete;
+
+    // The one everything shares, started the first time it's asked for
+    static JobSystem& Get();
+    // Only has an effect before the first Get
+    static void Configure( const int& numThreads, const bool& pinThreads );
+
+    void Run( Counter& counter, std::function<void()> job );
+    void Wait( Counter& counter );
+
+    // Calls work( begin, end ) for chunks of [0, count), grainSize items at a time
+    // grainSize 0 picks one that gives every thread a few chunks to balance with
+    template<typename Work>
+    void ParallelFor( const int& count, const int& grainSize, const Work& work );
+
+    // Calls work( x0, y0, x1, y1 ) for tiles of a width * height area, ends exclusive
+    template<typename Work>
+    void ParallelFor2D( const int& width, const int& height, const int& tileWidth, const int& tileHeight, const Work& work );
+
+    // Workers plus the thread that waits
+    int GetNumThreads() const
+    {
+        return int( workers.size() ) + 1;
+    }
+
+    uint64_t GetNumJobsRun() const
+    {
+        return jobsRun.load( std::memory_order_relaxed );
+    }
+
+    uint64_t GetNumJobsStolen() const
+    {
+        return jobsStolen.load( std::memory_order_relaxed );
+    }
+
+private:
+    struct Job
+    {
+        std::function<void()> work;
+        Counter* counter{ nullptr };
+    };
+
+    // Jobs per deque, a power of two so the ring indices can just be masked
+    static constexpr uint32_t QueueCapacity = 1024;
+
+    // head is the oldest job, tail is one past the newest; both only ever go up
+    struct Queue
+    {
+        std::mutex mutex;
+        Job jobs[QueueCapacity];
+        uint32_t head{ 0 };
+        uint32_t tail{ 0 };
+
+        bool IsEmpty() const
+        {
+            return head == tail;
+        }
+
+        bool IsFull() const
+        {
+            return tail - head == QueueCapacity;
+        }
+
+        void PushBack( Job&& job )
+        {
+            jobs[tail++ & (QueueCapacity - 1)] = std::move( job );
+        }
+
+        void PopBack( Job& outJob )
+        {
+            outJob = std::move( jobs[--tail & (QueueCapacity - 1)] );
+        }
+
+        void PopFront( Job& outJob )
+        {
+            outJob = std::move( jobs[head++ & (QueueCapacity - 1)] );
+        }
+    };
+    static_assert( (QueueCapacity & (QueueCapacity - 1)) == 0, "QueueCapacity has to be a power of two" );
+
+    // The calling thread's own deque, or the shared one if it isn't a worker
+    int GetQueueIndex() const;
+    bool FindJob( const int& queueIndex, Job& outJob );
+    void Execute( Job& job );
+    void WorkerMain( const int& queueIndex );
+
+private:
+    // Index 0 is for threads that aren't workers, worker i has i + 1
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<bool> stop{ false };
+    // Jobs sitting in any of the deques, so idle workers know whether to bother looking
+    std::atomic<int> queuedJobs{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::atomic<int> sleepingWorkers{ 0 };
+
+    std::atomic<uint64_t> jobsRun{ 0 };
+    std::atomic<uint64_t> jobsStolen{ 0 };
+};
+
+template<typename Work>
+void JobSystem::ParallelFor( const int& count, const int& grainSize, const Work& work )
+{
+    if ( count <= 0 )
+    {
+        return;
+    }
+
+    const int grain = grainSize > 0 ? grainSize : std::max( 1, count / (GetNumThreads() * 4) );
+    if ( grain >= count )
+    {
+        work( 0, count );
+        return;
+    }
+
+    // The caller does the first chunk itself rather than just sitting in Wait
+    // The job only holds a pointer and two ints, so std::function doesn't have to allocate
+    Counter counter;
+    for ( int begin = grain; begin < count; begin += grain )
+    {
+        const int end = std::min( count, begin + grain );
+        Run( counter, [&work, begin, end]()
+        {
+            work( begin, end );
+        } );
+    }
+
+    work( 0, grain );
+    Wait( counter );
+}
+
+template<typename Work>
+void JobSystem::ParallelFor2D( const int& width, const int& height, const int& tileWidth, const int& tileHeight, const Work& work )
+{
+    const int tilesX = (width + tileWidth - 1) / tileWidth;
+    const int tilesY = (height + tileHeight - 1) / tileHeight;
+
+    // Row-major tiles, so neighbouring chunks are neighbouring tiles
+    ParallelFor( tilesX * tilesY, 1, [&]( const int& begin, const int& end )
+    {
+        for ( int tile = begin; tile < end; tile++ )
+        {
+            const int x0 = (tile % tilesX) * tileWidth;
+            const int y0 = (tile / tilesX) * tileHeight;
+            work( x0, y0, std::min( width, x0 + tileWidth ), std::min( height, y0 + tileHeight ) );
+        }
+    } );
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
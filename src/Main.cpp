@@ -6,7 +6,7 @@
 
 int main( int argc, char** argv )
 {
-    return GetApp().Run();
+    return GetApp().Run( argc, argv );
 }
 
 /*
@@ -0,0 +1,238 @@
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Just enough vector maths for the 3D viewer, right-handed with Y up like OpenGL
+// Matrices are column-major, so they go straight into glUniformMatrix4fv
+
+struct Vec3
+{
+    float x{ 0.0f };
+    float y{ 0.0f };
+    float z{ 0.0f };
+
+    Vec3() = default;
+    Vec3( const float& vx, const float& vy, const float& vz )
+        : x( vx ), y( vy ), z( vz )
+    {
+    }
+
+    Vec3 operator+( const Vec3& v ) const { return Vec3( x + v.x, y + v.y, z + v.z ); }
+    Vec3 operator-( const Vec3& v ) const { return Vec3( x - v.x, y - v.y, z - v.z ); }
+    Vec3 operator*( const float& s ) const { return Vec3( x * s, y * s, z * s ); }
+    Vec3& operator+=( const Vec3& v ) { x += v.x; y += v.y; z += v.z; return *this; }
+
+    float operator[]( const int& axis ) const
+    {
+        return axis == 0 ? x : (axis == 1 ? y : z);
+    }
+
+    static float Dot( const Vec3& a, const Vec3& b )
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    static Vec3 Cross( const Vec3& a, const Vec3& b )
+    {
+        return Vec3( a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x );
+    }
+
+    static Vec3 Min( const Vec3& a, const Vec3& b )
+    {
+        return Vec3( std::min( a.x, b.x ), std::min( a.y, b.y ), std::min( a.z, b.z ) );
+    }
+
+    static Vec3 Max( const Vec3& a, const Vec3& b )
+    {
+        return Vec3( std::max( a.x, b.x ), std::max( a.y, b.y ), std::max( a.z, b.z ) );
+    }
+
+    Vec3 Normalized() const
+    {
+        const float length = std::sqrt( Dot( *this, *this ) );
+        return length > 0.0f ? *this * (1.0f / length) : *this;
+    }
+};
+
+struct Mat4
+{
+    float m[16]{};
+
+    static Mat4 Identity()
+    {
+        Mat4 result;
+        result.m[0] = result.m[5] = result.m[10] = result.m[15] = 1.0f;
+        return result;
+    }
+
+    // Column-major, so element (row, column) lives at m[column * 4 + row]
+    float& At( const int& row, const int& column ) { return m[column * 4 + row]; }
+    float At( const int& row, const int& column ) const { return m[column * 4 + row]; }
+
+    Mat4 operator*( const Mat4& other ) const
+    {
+        Mat4 result;
+        for ( int column = 0; column < 4; column++ )
+        {
+            for ( int row = 0; row < 4; row++ )
+            {
+                float sum = 0.0f;
+                for ( int i = 0; i < 4; i++ )
+                {
+                    sum += At( row, i ) * other.At( i, column );
+                }
+                result.At( row, column ) = sum;
+            }
+        }
+        return result;
+    }
+
+    // Same as gluPerspective, fieldOfView is vertical and in degrees
+    static Mat4 Perspective( const float& fieldOfView, const float& aspect, const float& nearPlane, const float& farPlane )
+    {
+        const float f = 1.0f / std::tan( fieldOfView * 3.14159265f / 360.0f );
+
+        Mat4 result;
+        result.At( 0, 0 ) = f / aspect;
+        result.At( 1, 1 ) = f;
+        result.At( 2, 2 ) = (farPlane + nearPlane) / (nearPlane - farPlane);
+        result.At( 2, 3 ) = 2.0f * farPlane * nearPlane / (nearPlane - farPlane);
+        result.At( 3, 2 ) = -1.0f;
+        return result;
+    }
+
+    // Same as gluLookAt
+    static Mat4 LookAt( const Vec3& eye, const Vec3& target, const Vec3& up )
+    {
+        const Vec3 forward = (target - eye).Normalized();
+        const Vec3 right = Vec3::Cross( forward, up ).Normalized();
+        const Vec3 trueUp = Vec3::Cross( right, forward );
+
+        Mat4 result = Identity();
+        result.At( 0, 0 ) = right.x;
+        result.At( 0, 1 ) = right.y;
+        result.At( 0, 2 ) = right.z;
+        result.At( 1, 0 ) = trueUp.x;
+        result.At( 1, 1 ) = trueUp.y;
+        result.At( 1, 2 ) = trueUp.z;
+        result.At( 2, 0 ) = -forward.x;
+        result.At( 2, 1 ) = -forward.y;
+        result.At( 2, 2 ) = -forward.z;
+        result.At( 0, 3 ) = -Vec3::Dot( right, eye );
+        result.At( 1, 3 ) = -Vec3::Dot( trueUp, eye );
+        result.At( 2, 3 ) = Vec3::Dot( forward, eye );
+        return result;
+    }
+};
+
+struct Aabb
+{
+    Vec3 mins{ 1.0e30f, 1.0e30f, 1.0e30f };
+    Vec3 maxs{ -1.0e30f, -1.0e30f, -1.0e30f };
+
+    Aabb() = default;
+    Aabb( const Vec3& boxMins, const Vec3& boxMaxs )
+        : mins( boxMins ), maxs( boxMaxs )
+    {
+    }
+
+    void Add( const Aabb& other )
+    {
+        mins = Vec3::Min( mins, other.mins );
+        maxs = Vec3::Max( maxs, other.maxs );
+    }
+
+    Vec3 GetCentre() const
+    {
+        return (mins + maxs) * 0.5f;
+    }
+};
+
+// The six planes of a view-projection matrix, pointing inwards
+// Gribb & Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+class Frustum final
+{
+public:
+    enum Result
+    {
+        Outside,
+        Intersecting,
+        Inside
+    };
+
+    explicit Frustum( const Mat4& viewProjection )
+    {
+        for ( int i = 0; i < 3; i++ )
+        {
+            for ( int sign = 0; sign < 2; sign++ )
+            {
+                const float direction = sign == 0 ? 1.0f : -1.0f;
+                Plane& plane = planes[i * 2 + sign];
+
+                plane.normal = Vec3(
+                    viewProjection.At( 3, 0 ) + direction * viewProjection.At( i, 0 ),
+                    viewProjection.At( 3, 1 ) + direction * viewProjection.At( i, 1 ),
+                    viewProjection.At( 3, 2 ) + direction * viewProjection.At( i, 2 ) );
+                plane.distance = viewProjection.At( 3, 3 ) + direction * viewProjection.At( i, 3 );
+            }
+        }
+    }
+
+    // Conservative: boxes near the corners can come out as intersecting when they're just outside
+    Result Test( const Aabb& box ) const
+    {
+        Result result = Inside;
+        for ( const Plane& plane : planes )
+        {
+            // The corners furthest along and furthest against the plane normal
+            const Vec3 positive( plane.normal.x >= 0.0f ? box.maxs.x : box.mins.x,
+                plane.normal.y >= 0.0f ? box.maxs.y : box.mins.y,
+                plane.normal.z >= 0.0f ? box.maxs.z : box.mins.z );
+            const Vec3 negative( plane.normal.x >= 0.0f ? box.mins.x : box.maxs.x,
+                plane.normal.y >= 0.0f ? box.mins.y : box.maxs.y,
+                plane.normal.z >= 0.0f ? box.mins.z : box.maxs.z );
+
+            if ( Vec3::Dot( plane.normal, positive ) + plane.distance < 0.0f )
+            {
+                return Outside;
+            }
+
+            if ( Vec3::Dot( plane.normal, negative ) + plane.distance < 0.0f )
+            {
+                result = Intersecting;
+            }
+        }
+
+        return result;
+    }
+
+private:
+    struct Plane
+    {
+        Vec3 normal;
+        float distance{ 0.0f };
+    };
+
+    Plane planes[6];
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
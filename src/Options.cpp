@@ -0,0 +1,357 @@
+
+#include "Options.hpp"
+#include "TextureSwizzle.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+bool AppOptions::Parse( int argc, char** argv )
+{
+	bool timestepGiven = false;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		const char* arg = argv[i];
+
+		// For options that take a value, returns nullptr if it's missing
+		const auto nextValue = [&]() -> const char*
+		{
+			if ( i + 1 >= argc )
+			{
+				std::cout << "AppOptions: '" << arg << "' needs a value" << std::endl;
+				return nullptr;
+			}
+
+			return argv[++i];
+		};
+
+		const auto readInt = [&]( int& out, const int& minimum )
+		{
+			const char* value = nextValue();
+			if ( value == nullptr )
+			{
+				return false;
+			}
+
+			char* end = nullptr;
+			const long result = strtol( value, &end, 10 );
+			if ( *end != '\0' || result < minimum )
+			{
+				std::cout << "AppOptions: '" << arg << "' expects a whole number of at least " << minimum
+					<< ", got '" << value << "'" << std::endl;
+				return false;
+			}
+
+			out = int( result );
+			return true;
+		};
+
+		const auto readFloat = [&]( float& out )
+		{
+			const char* value = nextValue();
+			if ( value == nullptr )
+			{
+				return false;
+			}
+
+			char* end = nullptr;
+			const float result = strtof( value, &end );
+			if ( *end != '\0' || result < 0.0f )
+			{
+				std::cout << "AppOptions: '" << arg << "' expects a positive number, got '" << value << "'" << std::endl;
+				return false;
+			}
+
+			out = result;
+			return true;
+		};
+
+		bool okay = true;
+		if ( !strcmp( arg, "--benchmark" ) )
+		{
+			benchmark = true;
+		}
+		else if ( !strcmp( arg, "--headless" ) )
+		{
+			headless = true;
+		}
+		else if ( !strcmp( arg, "--size" ) )
+		{
+			const char* value = nextValue();
+			okay = value != nullptr && sscanf( value, "%ix%i", &width, &height ) == 2 && width > 0 && height > 0;
+			if ( value != nullptr && !okay )
+			{
+				std::cout << "AppOptions: '--size' expects WIDTHxHEIGHT, got '" << value << "'" << std::endl;
+			}
+		}
+		else if ( !strcmp( arg, "--frames" ) )
+		{
+			okay = readInt( frames, 1 );
+		}
+		else if ( !strcmp( arg, "--seconds" ) )
+		{
+			okay = readFloat( seconds );
+		}
+		else if ( !strcmp( arg, "--output" ) )
+		{
+			const char* value = nextValue();
+			okay = value != nullptr;
+			outputPrefix = okay ? value : "";
+		}
+		else if ( !strcmp( arg, "--scene" ) )
+		{
+			scene = true;
+		}
+		else if ( !strcmp( arg, "--scene-size" ) )
+		{
+			okay = readInt( scenePools, 1 );
+		}
+		else if ( !strcmp( arg, "--vertex-warp" ) )
+		{
+			vertexWarp = true;
+		}
+		else if ( !strcmp( arg, "--subdivide" ) )
+		{
+			okay = readInt( subdivideSize, 16 );
+		}
+		else if ( !strcmp( arg, "--atlas" ) )
+		{
+			atlas = true;
+		}
+		else if ( !strcmp( arg, "--scene-textures" ) )
+		{
+			okay = readInt( sceneTextures, 1 );
+		}
+		else if ( !strcmp( arg, "--texture-budget" ) )
+		{
+			okay = readInt( textureBudget, 16 );
+		}
+		else if ( !strcmp( arg, "--virtual-texture" ) )
+		{
+			const char* value = nextValue();
+			okay = value != nullptr;
+			virtualTexturePath = okay ? value : "";
+		}
+		else if ( !strcmp( arg, "--make-virtual" ) )
+		{
+			const char* value = nextValue();
+			okay = value != nullptr;
+			makeVirtualPath = okay ? value : "";
+		}
+		else if ( !strcmp( arg, "--gif" ) )
+		{
+			const char* value = nextValue();
+			okay = value != nullptr;
+			gifPath = okay ? value : "";
+		}
+		else if ( !strcmp( arg, "--capture" ) )
+		{
+			const char* value = nextValue();
+			okay = value != nullptr;
+			capturePath = okay ? value : "";
+		}
+		else if ( !strcmp( arg, "--output-every" ) )
+		{
+			okay = readInt( outputEvery, 1 );
+		}
+		else if ( !strcmp( arg, "--warmup" ) )
+		{
+			okay = readInt( warmupFrames, 0 );
+		}
+		else if ( !strcmp( arg, "--timestep" ) )
+		{
+			okay = readFloat( timestep );
+			timestepGiven = true;
+		}
+		else if ( !strcmp( arg, "--report" ) )
+		{
+			const char* value = nextValue();
+			okay = value != nullptr;
+			reportPath = okay ? value : "";
+		}
+		else if ( !strcmp( arg, "--no-allocations" ) )
+		{
+			noAllocations = true;
+		}
+		else if ( !strcmp( arg, "--golden" ) )
+		{
+			golden = true;
+		}
+		else if ( !strcmp( arg, "--max-mismatch" ) )
+		{
+			okay = readFloat( maxMismatch );
+		}
+		else if ( !strcmp( arg, "--min-psnr" ) )
+		{
+			okay = readFloat( minPsnr );
+		}
+		else if ( !strcmp( arg, "--no-vsync" ) )
+		{
+			vsync = false;
+		}
+		else if ( !strcmp( arg, "--no-gui" ) )
+		{
+			gui = false;
+		}
+		else if ( !strcmp( arg, "--on-demand" ) )
+		{
+			onDemand = true;
+		}
+		else if ( !strcmp( arg, "--cpu-water" ) )
+		{
+			cpuWater = true;
+		}
+		else if ( !strcmp( arg, "--job-threads" ) )
+		{
+			okay = readInt( jobThreads, 0 );
+		}
+		else if ( !strcmp( arg, "--texture-layout" ) )
+		{
+			const char* value = nextValue();
+			okay = value != nullptr && TextureSwizzle::FromName( value, textureLayout );
+		}
+		else if ( !strcmp( arg, "--guard-band" ) )
+		{
+			okay = readInt( guardBand, 0 );
+		}
+		else if ( !strcmp( arg, "--pin-threads" ) )
+		{
+			pinThreads = true;
+		}
+		else if ( !strcmp( arg, "--no-watch-shaders" ) )
+		{
+			watchShaders = false;
+		}
+		else if ( !strcmp( arg, "--benchmark-jobs" ) )
+		{
+			benchmarkJobs = true;
+		}
+		else if ( !strcmp( arg, "--help" ) || !strcmp( arg, "-h" ) )
+		{
+			PrintUsage();
+			return false;
+		}
+		else
+		{
+			std::cout << "AppOptions: unknown option '" << arg << "'" << std::endl;
+			okay = false;
+		}
+
+		if ( !okay )
+		{
+			PrintUsage();
+			return false;
+		}
+	}
+
+	if ( !makeVirtualPath.empty() && virtualTexturePath.empty() )
+	{
+		std::cout << "AppOptions: '--make-virtual' needs '--virtual-texture' to say where the page file goes" << std::endl;
+		PrintUsage();
+		return false;
+	}
+
+	// The 3D scene and SoftwareWater have textures of their own, and golden compares against the latter
+	if ( !virtualTexturePath.empty() && (scene || cpuWater || golden) )
+	{
+		std::cout << "AppOptions: '--virtual-texture' is only for the 2D view, not with --scene, --cpu-water or --golden" << std::endl;
+		PrintUsage();
+		return false;
+	}
+
+	// The guard band is whole rows with their borders, so it only goes with rows
+	if ( guardBand > 0 && textureLayout != TextureLayout::RowMajor )
+	{
+		std::cout << "AppOptions: '--guard-band' only works with '--texture-layout row-major'" << std::endl;
+		PrintUsage();
+		return false;
+	}
+
+	// Benchmarks have to be reproducible, and there's no one watching a headless run,
+	// so in both cases the animation can't depend on how fast frames go
+	if ( (benchmark || headless) && !timestepGiven )
+	{
+		timestep = 1.0f / 60.0f;
+	}
+
+	if ( benchmark )
+	{
+		vsync = false;
+	}
+
+	// The overlay would end up in the compared images
+	if ( headless || golden )
+	{
+		gui = false;
+	}
+
+	// Neither of these should run forever by accident
+	if ( (benchmark || headless) && frames == 0 && seconds <= 0.0f )
+	{
+		frames = benchmark ? 1000 : 60;
+	}
+
+	return true;
+}
+
+void AppOptions::PrintUsage()
+{
+	std::cout
+		<< "Usage: SWater [options]" << std::endl
+		<< "  --timestep <s>     Advance the animation by a fixed amount per frame instead of real time" << std::endl
+		<< "  --no-vsync         Don't wait for vertical sync" << std::endl
+		<< "  --no-gui           Don't draw the ImGui overlay" << std::endl
+		<< "  --on-demand        Only draw when the ripples move or something changes, idle otherwise" << std::endl
+		<< "  --cpu-water        Simulate the 2D view's ripples on the CPU, on a thread of their own" << std::endl
+		<< "  --job-threads <n>  Threads for CPU work, the main one included (default: one per core)" << std::endl
+		<< "  --pin-threads      Keep each job thread on a core of its own" << std::endl
+		<< "  --texture-layout <l> How the CPU ripples store the texture: row-major, tiled or morton" << std::endl
+		<< "  --guard-band <n>   Keep n texels of wrap-around round the CPU's texture, 48 lets it skip the modulo" << std::endl
+		<< "  --no-watch-shaders Don't reload the shaders when their files are saved, only with R" << std::endl
+		<< "  --size <w>x<h>     Window or framebuffer size (default 1024x1024)" << std::endl
+		<< "  --headless         Render offscreen through EGL, no window or display needed" << std::endl
+		<< "  --frames <n>       Quit after this many frames (default: 1000 for benchmarks, 60 headless)" << std::endl
+		<< "  --seconds <s>      Quit after this much wall-clock time" << std::endl
+		<< "  --output <prefix>  Write frames to <prefix>00000.ppm, <prefix>00001.ppm..." << std::endl
+		<< "  --output-every <n> Only write every n-th frame (default 1)" << std::endl
+		<< "  --capture <file>   Record a video, Y4M if it ends in .y4m, raw RGB24 otherwise" << std::endl
+		<< "  --scene            Start in the 3D viewer" << std::endl
+		<< "  --scene-size <n>   The example scene has n by n pools (default 8)" << std::endl
+		<< "  --vertex-warp      Warp the 3D scene's water per vertex, like GLQuake" << std::endl
+		<< "  --subdivide <n>    Chop water into pieces n units across for that (default 64)" << std::endl
+		<< "  --scene-textures <n> How many different textures the 3D scene's pools have (default 48)" << std::endl
+		<< "  --atlas            Pack them into one atlas instead of streaming them" << std::endl
+		<< "  --texture-budget <KB> GPU memory the streamed textures may use (default 512)" << std::endl
+		<< "  --virtual-texture <file> Show a page file in the 2D view, streaming in the parts on screen" << std::endl
+		<< "  --make-virtual <bmp> Chop an 8-bit BMP of any size into that page file first" << std::endl
+		<< "  --gif <file>       Write one loop of the animation as a GIF at --size, then quit" << std::endl
+		<< "  --benchmark-jobs   Time the job system and CPU ripples at --size for each thread count, then quit" << std::endl
+		<< "  --benchmark        Run with a fixed timestep and vsync off, print a JSON report and quit" << std::endl
+		<< "  --warmup <n>       Frames to run before measuring (default 60)" << std::endl
+		<< "  --report <file>    Also write the benchmark or golden report to a file" << std::endl
+		<< "  --no-allocations   Fail the benchmark if a measured frame touches the heap (needs SWATER_COUNT_ALLOCATIONS)" << std::endl
+		<< "  --golden           Compare GPU frames against the CPU reference, fail if they differ" << std::endl
+		<< "  --max-mismatch <f> Fraction of palette indices allowed to differ (default 0.001)" << std::endl
+		<< "  --min-psnr <dB>    Lowest colour PSNR that still passes (default 40)" << std::endl;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
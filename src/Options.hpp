@@ -0,0 +1,109 @@
+
+#pragma once
+
+#include "TextureProvider.hpp"
+
+#include <string>
+
+// Everything that can be set from the command line
+struct AppOptions
+{
+    // Seconds of animation per frame; 0 means follow the wall clock
+    float timestep{ 0.0f };
+    bool vsync{ true };
+    bool gui{ true };
+    // Only draw when something on screen would change, and not at all while the window's hidden
+    bool onDemand{ false };
+    // The 2D view's ripples are simulated on the CPU, on a thread of their own
+    bool cpuWater{ false };
+    // Threads the job system runs on, the main one included; 0 means one per hardware thread
+    int jobThreads{ 0 };
+    bool pinThreads{ false };
+    // The order SoftwareWater gets water.bmp's texels in, see TextureSwizzle
+    TextureLayout textureLayout{ TextureLayout::RowMajor };
+    // Texels of wrap-around kept round SoftwareWater's copy, see GuardBand; 0 means none
+    int guardBand{ 0 };
+    // Reload the shaders when their files are saved
+    bool watchShaders{ true };
+
+    // Size of the window, or of the offscreen framebuffer when headless
+    int width{ 1024 };
+    int height{ 1024 };
+
+    // Render offscreen without a window, see HeadlessContext
+    // Implies a fixed timestep and no GUI
+    bool headless{ false };
+
+    // Whichever limit is hit first ends the run; 0 means no limit
+    // In benchmark mode, these count measured frames only
+    int frames{ 0 };
+    float seconds{ 0.0f };
+
+    // If set, every outputEvery-th frame is written to <outputPrefix>00000.ppm and so on
+    std::string outputPrefix{};
+    int outputEvery{ 1 };
+
+    // Starts in the 3D viewer, with an example scene of poolsPerSide squared pools
+    bool scene{ false };
+    int scenePools{ 8 };
+    // Warps the water per vertex like GLQuake, on pieces this many units across
+    bool vertexWarp{ false };
+    int subdivideSize{ 64 };
+    // The pools have sceneTextures different textures, packed into one atlas if atlas is set,
+    // otherwise streamed in and out by TextureResidency within textureBudget KB
+    bool atlas{ false };
+    int sceneTextures{ 48 };
+    int textureBudget{ 512 };
+
+    // The 2D view shows a page file instead, streamed in as it's needed, see VirtualTexture
+    // makeVirtualPath is a BMP to turn into that page file first
+    std::string virtualTexturePath{};
+    std::string makeVirtualPath{};
+
+    // Renders one loop of the animation on the CPU into a GIF and quits, no GL needed
+    std::string gifPath{};
+    // Times the job system with 1 thread, 2, and so on up to jobThreads, prints a report and quits
+    bool benchmarkJobs{ false };
+
+    // Records a video from the first frame on, see FrameCapture; C starts and stops it too
+    std::string capturePath{};
+
+    // Benchmark mode: fixed timestep, no vsync, run for a while, print a report and quit
+    bool benchmark{ false };
+    // Frames that run before measuring starts, so shader compiles and driver warm-up don't count
+    int warmupFrames{ 60 };
+    // The report always goes to stdout, this writes a copy too
+    std::string reportPath{};
+    // Fail if the measured frames allocate at all, needs SWATER_COUNT_ALLOCATIONS
+    bool noAllocations{ false };
+
+    // Golden mode: render a set of fixed frames on the GPU and in SoftwareWater, compare and quit
+    // Fails if more than maxMismatch of the indices differ, or the colours are under minPsnr dB
+    bool golden{ false };
+    float maxMismatch{ 0.001f };
+    float minPsnr{ 40.0f };
+
+    // Returns false if something was wrong with the arguments, or if the usage was asked for
+    bool Parse( int argc, char** argv );
+
+    static void PrintUsage();
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,279 @@
+
+#include "PaletteMips.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <utility>
+
+constexpr int PaletteLookup::Bits;
+constexpr int PaletteLookup::Size;
+constexpr int PaletteLookup::BlockBits;
+constexpr int PaletteLookup::NumBlocks;
+
+namespace
+{
+	// FNV-1a over the palette and which entries can be picked, that's all a table depends on
+	uint64_t HashPalette( const PaletteBuffer& palette, const std::array<bool, 256U>& usable )
+	{
+		uint64_t hash = 0xCBF29CE484222325ull;
+		const auto add = [&hash]( const uint8_t& byte )
+		{
+			hash = (hash ^ byte) * 0x100000001B3ull;
+		};
+
+		for ( size_t i = 0; i < palette.size(); i++ )
+		{
+			add( palette[i][0] );
+			add( palette[i][1] );
+			add( palette[i][2] );
+			add( usable[i] ? 1 : 0 );
+		}
+
+		return hash;
+	}
+
+	std::mutex cacheMutex;
+	std::vector<std::pair<uint64_t, std::shared_ptr<const PaletteLookup>>> cache;
+}
+
+PaletteLookup::PaletteLookup( const PaletteBuffer& lookupPalette, const std::array<bool, 256U>& usable )
+	: palette( lookupPalette )
+{
+	for ( int i = 0; i < 256; i++ )
+	{
+		if ( usable[i] )
+		{
+			candidates.push_back( i );
+		}
+	}
+
+	// Nothing usable would leave nothing to find, so just give back index 0
+	if ( candidates.empty() )
+	{
+		candidates.push_back( 0 );
+	}
+
+	table.resize( Size * Size * Size, 0 );
+	blockStates.reset( new std::atomic<uint8_t>[NumBlocks * NumBlocks * NumBlocks] );
+	for ( int i = 0; i < NumBlocks * NumBlocks * NumBlocks; i++ )
+	{
+		blockStates[i].store( BlockEmpty, std::memory_order_relaxed );
+	}
+}
+
+void PaletteLookup::FillBlock( const int& block ) const
+{
+	uint8_t expected = BlockEmpty;
+	if ( !blockStates[block].compare_exchange_strong( expected, BlockFilling, std::memory_order_acquire ) )
+	{
+		// Another thread got here first, it won't take long
+		while ( blockStates[block].load( std::memory_order_acquire ) != BlockReady )
+		{
+			std::this_thread::yield();
+		}
+		return;
+	}
+
+	constexpr int Step = 256 / Size;
+	constexpr int BlockCells = 1 << BlockBits;
+	const int blockCoords[3] = { block / (NumBlocks * NumBlocks), (block / NumBlocks) % NumBlocks, block % NumBlocks };
+
+	// The centres of the block's first and last cells, along each channel
+	int low[3];
+	int high[3];
+	for ( int channel = 0; channel < 3; channel++ )
+	{
+		low[channel] = blockCoords[channel] * BlockCells * Step + Step / 2;
+		high[channel] = low[channel] + (BlockCells - 1) * Step;
+	}
+
+	// Heckbert's "locally sorted search", more or less: whatever's closest to a cell is no
+	// further away than the entry with the nearest furthest corner, so anything whose nearest
+	// point is beyond that can't win anywhere in the block and doesn't need looking at
+	int threshold = INT32_MAX;
+	for ( const int& index : candidates )
+	{
+		int furthest = 0;
+		for ( int channel = 0; channel < 3; channel++ )
+		{
+			const int delta = std::max( std::abs( palette[index][channel] - low[channel] ), std::abs( palette[index][channel] - high[channel] ) );
+			furthest += delta * delta;
+		}
+		threshold = std::min( threshold, furthest );
+	}
+
+	int nearby[256];
+	int numNearby = 0;
+	for ( const int& index : candidates )
+	{
+		int nearest = 0;
+		for ( int channel = 0; channel < 3; channel++ )
+		{
+			const int value = palette[index][channel];
+			const int delta = value < low[channel] ? low[channel] - value : (value > high[channel] ? value - high[channel] : 0);
+			nearest += delta * delta;
+		}
+
+		if ( nearest <= threshold )
+		{
+			nearby[numNearby++] = index;
+		}
+	}
+
+	for ( int r = 0; r < BlockCells; r++ )
+	{
+		for ( int g = 0; g < BlockCells; g++ )
+		{
+			for ( int b = 0; b < BlockCells; b++ )
+			{
+				const int red = low[0] + r * Step;
+				const int green = low[1] + g * Step;
+				const int blue = low[2] + b * Step;
+
+				// Candidates are in index order, so ties go to the lowest index
+				int bestDistance = INT32_MAX;
+				int bestIndex = nearby[0];
+				for ( int i = 0; i < numNearby; i++ )
+				{
+					const int index = nearby[i];
+					const int dr = red - palette[index][0];
+					const int dg = green - palette[index][1];
+					const int db = blue - palette[index][2];
+					const int distance = dr * dr + dg * dg + db * db;
+					if ( distance < bestDistance )
+					{
+						bestDistance = distance;
+						bestIndex = index;
+					}
+				}
+
+				const int cell = ((blockCoords[0] * BlockCells + r) * Size + blockCoords[1] * BlockCells + g) * Size + blockCoords[2] * BlockCells + b;
+				table[cell] = uint8_t( bestIndex );
+			}
+		}
+	}
+
+	blockStates[block].store( BlockReady, std::memory_order_release );
+}
+
+std::shared_ptr<const PaletteLookup> PaletteLookup::Get( const PaletteBuffer& palette, const std::array<bool, 256U>& usable )
+{
+	const uint64_t hash = HashPalette( palette, usable );
+
+	std::lock_guard<std::mutex> lock( cacheMutex );
+	for ( const auto& entry : cache )
+	{
+		if ( entry.first == hash )
+		{
+			return entry.second;
+		}
+	}
+
+	std::shared_ptr<const PaletteLookup> lookup = std::make_shared<PaletteLookup>( palette, usable );
+	cache.emplace_back( hash, lookup );
+	return lookup;
+}
+
+std::vector<Texture> PaletteMips::Build( const Texture& texture, const int& numThreads )
+{
+	TRACE_SCOPE( "PaletteMips::Build" );
+
+	std::vector<Texture> levels;
+	if ( !texture )
+	{
+		return levels;
+	}
+
+	const PaletteBuffer palette = texture.GetPalette();
+	const TextureBuffer& indices = texture.GetBuffer();
+
+	// Only colours the texture already has, so the mips can't pick up the fog colour
+	// or whatever else is lurking in the unused end of the palette
+	std::array<bool, 256U> usable{};
+	for ( const uint8_t& index : indices )
+	{
+		usable[index] = true;
+	}
+
+	const std::shared_ptr<const PaletteLookup> lookup = PaletteLookup::Get( palette, usable );
+
+	// Each level is averaged from the RGB of the one above rather than from its
+	// indices, so the rounding to the palette doesn't pile up level after level
+	int width = int( texture.GetWidth() );
+	int height = int( texture.GetHeight() );
+	std::vector<float> colours( size_t( width ) * height * 3 );
+	for ( size_t i = 0; i < indices.size(); i++ )
+	{
+		colours[i * 3] = palette[indices[i]][0];
+		colours[i * 3 + 1] = palette[indices[i]][1];
+		colours[i * 3 + 2] = palette[indices[i]][2];
+	}
+
+	std::vector<float> nextColours;
+	while ( width > 1 || height > 1 )
+	{
+		const int nextWidth = std::max( 1, width / 2 );
+		const int nextHeight = std::max( 1, height / 2 );
+		nextColours.resize( size_t( nextWidth ) * nextHeight * 3 );
+		TextureBuffer nextIndices( size_t( nextWidth ) * nextHeight );
+
+		const int rowsPerJob = numThreads > 0 ? (nextHeight + numThreads - 1) / numThreads : 0;
+		JobSystem::Get().ParallelFor( nextHeight, rowsPerJob, [&]( const int& begin, const int& end )
+		{
+			for ( int y = begin; y < end; y++ )
+			{
+				// Odd sizes lose their last row or column, same as glGenerateMipmap's box filter
+				const int y0 = std::min( y * 2, height - 1 );
+				const int y1 = std::min( y * 2 + 1, height - 1 );
+
+				for ( int x = 0; x < nextWidth; x++ )
+				{
+					const int x0 = std::min( x * 2, width - 1 );
+					const int x1 = std::min( x * 2 + 1, width - 1 );
+
+					float* out = &nextColours[(size_t( y ) * nextWidth + x) * 3];
+					for ( int channel = 0; channel < 3; channel++ )
+					{
+						out[channel] = 0.25f * (colours[(size_t( y0 ) * width + x0) * 3 + channel]
+							+ colours[(size_t( y0 ) * width + x1) * 3 + channel]
+							+ colours[(size_t( y1 ) * width + x0) * 3 + channel]
+							+ colours[(size_t( y1 ) * width + x1) * 3 + channel]);
+					}
+
+					nextIndices[size_t( y ) * nextWidth + x] = lookup->Find(
+						uint8_t( out[0] + 0.5f ), uint8_t( out[1] + 0.5f ), uint8_t( out[2] + 0.5f ) );
+				}
+			}
+		} );
+
+		levels.emplace_back( uint32_t( nextWidth ), uint32_t( nextHeight ), nextIndices, palette );
+		colours.swap( nextColours );
+		width = nextWidth;
+		height = nextHeight;
+	}
+
+	return levels;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,91 @@
+
+#pragma once
+
+#include "TextureProvider.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Nearest palette entry for any colour, through a 64x64x64 table
+// Cells get filled in blocks of 4x4x4 the first time something lands in them, since a
+// texture's colours only ever cover a sliver of the cube. Tables are cached too, so asking
+// for the same palette twice gives back the same, already partly filled, one
+// Find is safe to call from any number of threads at once
+class PaletteLookup final
+{
+public:
+    static constexpr int Bits = 6;
+    static constexpr int Size = 1 << Bits;
+    static constexpr int BlockBits = 2;
+    static constexpr int NumBlocks = Size >> BlockBits;
+
+    // Only entries marked in usable are ever returned, at least one has to be
+    PaletteLookup( const PaletteBuffer& palette, const std::array<bool, 256U>& usable );
+
+    static std::shared_ptr<const PaletteLookup> Get( const PaletteBuffer& palette, const std::array<bool, 256U>& usable );
+
+    uint8_t Find( const uint8_t& r, const uint8_t& g, const uint8_t& b ) const
+    {
+        const int cr = r >> (8 - Bits);
+        const int cg = g >> (8 - Bits);
+        const int cb = b >> (8 - Bits);
+
+        const int block = ((cr >> BlockBits) * NumBlocks + (cg >> BlockBits)) * NumBlocks + (cb >> BlockBits);
+        if ( blockStates[block].load( std::memory_order_acquire ) != BlockReady )
+        {
+            FillBlock( block );
+        }
+
+        return table[(cr * Size + cg) * Size + cb];
+    }
+
+private:
+    enum BlockState : uint8_t
+    {
+        BlockEmpty,
+        BlockFilling,
+        BlockReady
+    };
+
+    void FillBlock( const int& block ) const;
+
+private:
+    PaletteBuffer palette;
+    std::vector<int> candidates;
+
+    mutable std::vector<uint8_t> table;
+    mutable std::unique_ptr<std::atomic<uint8_t>[]> blockStates;
+};
+
+// Mip levels for indexed textures
+// Averaging palette indices like glGenerateMipmap does gives colours that have nothing
+// to do with the texture, so the levels are averaged in RGB through the palette and
+// mapped back to the closest colour the texture actually uses
+class PaletteMips final
+{
+public:
+    // Levels 1 and down to 1x1, level 0 is the texture itself
+    // Rows of each level are split into numThreads jobs, 0 lets the job system pick
+    static std::vector<Texture> Build( const Texture& texture, const int& numThreads = 0 );
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
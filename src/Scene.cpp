@@ -0,0 +1,388 @@
+
+#include "Scene.hpp"
+#include "Trace.hpp"
+#include "WaterMesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <initializer_list>
+#include <iostream>
+
+namespace
+{
+	// Each pool sits in a square cell this big, with walls around a floor
+	constexpr float CellSize = 256.0f;
+	constexpr float WallThickness = 32.0f;
+	constexpr float FloorHeight = 16.0f;
+	constexpr float WallHeight = 96.0f;
+	constexpr float WaterHeight = 80.0f;
+}
+
+constexpr int Scene::NumWaterLods;
+constexpr int Scene::FlatWaterLod;
+
+void Scene::BuildExample( const int& poolsPerSide, const int& textureWidth, const int& textureHeight, const float& waterSubdivideSize,
+	const int& numWaterTextures )
+{
+	TRACE_SCOPE( "Scene::BuildExample" );
+
+	brushes.clear();
+	waterSurfaces.clear();
+	vertices.clear();
+	indices.clear();
+
+	textureScaleS = 1.0f / float( textureWidth );
+	textureScaleT = 1.0f / float( textureHeight );
+	subdivideSize = waterSubdivideSize;
+
+	waterVertexCount = 0;
+	waterTriangleCount = 0;
+	waterCacheMissRatio = 0.0f;
+	waterCacheMissRatioBefore = 0.0f;
+
+	for ( int i = 0; i < poolsPerSide; i++ )
+	{
+		for ( int j = 0; j < poolsPerSide; j++ )
+		{
+			const float x = i * CellSize;
+			const float z = j * CellSize;
+			const float inner = CellSize - WallThickness;
+
+			AddBox( Aabb( Vec3( x, 0.0f, z ), Vec3( x + CellSize, FloorHeight, z + CellSize ) ) );
+
+			AddBox( Aabb( Vec3( x, FloorHeight, z ), Vec3( x + WallThickness, WallHeight, z + CellSize ) ) );
+			AddBox( Aabb( Vec3( x + inner, FloorHeight, z ), Vec3( x + CellSize, WallHeight, z + CellSize ) ) );
+			AddBox( Aabb( Vec3( x + WallThickness, FloorHeight, z ), Vec3( x + inner, WallHeight, z + WallThickness ) ) );
+			AddBox( Aabb( Vec3( x + WallThickness, FloorHeight, z + inner ), Vec3( x + inner, WallHeight, z + CellSize ) ) );
+
+			const float timeOffset = float( (i * 7 + j * 13) % 16 ) * 0.37f;
+			AddWaterSurface( Aabb( Vec3( x + WallThickness, FloorHeight, z + WallThickness ),
+				Vec3( x + inner, WaterHeight, z + inner ) ), timeOffset, subdivideSize );
+			waterSurfaces.back().textureIndex = (i * poolsPerSide + j) % std::max( 1, numWaterTextures );
+		}
+	}
+
+	std::vector<Aabb> bounds;
+	for ( const Brush& brush : brushes )
+	{
+		bounds.push_back( brush.bounds );
+	}
+	brushTree.Build( bounds );
+
+	bounds.clear();
+	for ( const WaterSurface& surface : waterSurfaces )
+	{
+		bounds.push_back( surface.bounds );
+	}
+	waterTree.Build( bounds );
+
+	// Weighted by triangles while adding them up
+	if ( waterTriangleCount > 0 )
+	{
+		waterCacheMissRatio /= float( waterTriangleCount );
+		waterCacheMissRatioBefore /= float( waterTriangleCount );
+	}
+
+	std::cout << std::dec << "Scene::BuildExample: " << brushes.size() << " brushes, " << waterSurfaces.size()
+		<< " water surfaces, " << brushTree.GetNumNodes() + waterTree.GetNumNodes() << " BVH nodes" << std::endl;
+	printf( "Scene::BuildExample: water is %i vertices and %i triangles at %g units, ACMR %.3f before reordering, %.3f after\n",
+		int( waterVertexCount ), int( waterTriangleCount ), subdivideSize, waterCacheMissRatioBefore, waterCacheMissRatio );
+}
+
+void Scene::AddQuad( const Vec3& a, const Vec3& b, const Vec3& c, const Vec3& d )
+{
+	const uint32_t base = uint32_t( vertices.size() );
+
+	// Planar mapping from above, which is the only way anyone looks at water anyway
+	for ( const Vec3* corner : { &a, &b, &c, &d } )
+	{
+		Vertex vertex;
+		vertex.position[0] = corner->x;
+		vertex.position[1] = corner->y;
+		vertex.position[2] = corner->z;
+		vertex.coord[0] = corner->x * textureScaleS;
+		vertex.coord[1] = corner->z * textureScaleT;
+		vertices.push_back( vertex );
+	}
+
+	const uint32_t quadIndices[] = { 0, 1, 2, 2, 3, 0 };
+	for ( const uint32_t& index : quadIndices )
+	{
+		indices.push_back( base + index );
+	}
+}
+
+void Scene::AddBox( const Aabb& box )
+{
+	Brush brush;
+	brush.bounds = box;
+	brush.indexOffset = indices.size() * sizeof( uint32_t );
+
+	const Vec3& n = box.mins;
+	const Vec3& x = box.maxs;
+
+	AddQuad( Vec3( n.x, x.y, n.z ), Vec3( n.x, x.y, x.z ), Vec3( x.x, x.y, x.z ), Vec3( x.x, x.y, n.z ) ); // top
+	AddQuad( Vec3( n.x, n.y, n.z ), Vec3( x.x, n.y, n.z ), Vec3( x.x, n.y, x.z ), Vec3( n.x, n.y, x.z ) ); // bottom
+	AddQuad( Vec3( n.x, n.y, n.z ), Vec3( n.x, n.y, x.z ), Vec3( n.x, x.y, x.z ), Vec3( n.x, x.y, n.z ) ); // -X
+	AddQuad( Vec3( x.x, n.y, n.z ), Vec3( x.x, x.y, n.z ), Vec3( x.x, x.y, x.z ), Vec3( x.x, n.y, x.z ) ); // +X
+	AddQuad( Vec3( n.x, n.y, n.z ), Vec3( n.x, x.y, n.z ), Vec3( x.x, x.y, n.z ), Vec3( x.x, n.y, n.z ) ); // -Z
+	AddQuad( Vec3( n.x, n.y, x.z ), Vec3( x.x, n.y, x.z ), Vec3( x.x, x.y, x.z ), Vec3( n.x, x.y, x.z ) ); // +Z
+
+	brush.indexCount = GLsizei( indices.size() - brush.indexOffset / sizeof( uint32_t ) );
+	brushes.push_back( brush );
+}
+
+void Scene::AddWaterSurface( const Aabb& volume, const float& timeOffset, const float& size )
+{
+	WaterSurface surface;
+	surface.timeOffset = timeOffset;
+
+	// Only the top of the volume is ever drawn, so that's all the bounds need to cover
+	const float y = volume.maxs.y;
+	surface.bounds = Aabb( Vec3( volume.mins.x, y, volume.mins.z ), volume.maxs );
+
+	// Any convex face works, the pools just happen to be rectangles
+	const std::vector<Vec3> polygon =
+	{
+		Vec3( volume.mins.x, y, volume.mins.z ), Vec3( volume.mins.x, y, volume.maxs.z ),
+		Vec3( volume.maxs.x, y, volume.maxs.z ), Vec3( volume.maxs.x, y, volume.mins.z )
+	};
+
+	std::vector<Vec3> triangles;
+	std::vector<Vec3> meshVertices;
+	std::vector<uint32_t> meshIndices;
+	for ( int lod = 0; lod < NumWaterLods; lod++ )
+	{
+		triangles.clear();
+		meshVertices.clear();
+		meshIndices.clear();
+
+		const float lodSize = lod == FlatWaterLod ? 0.0f : size * float( 1 << lod );
+		WaterMesh::Subdivide( polygon, lodSize, triangles );
+		WaterMesh::Weld( triangles, meshVertices, meshIndices );
+
+		const float missRatioBefore = WaterMesh::GetAverageCacheMissRatio( meshIndices, meshVertices.size() );
+		WaterMesh::OptimiseVertexCache( meshIndices, meshVertices.size() );
+		WaterMesh::OptimiseVertexFetch( meshVertices, meshIndices );
+
+		if ( lod == 0 )
+		{
+			const size_t numTriangles = meshIndices.size() / 3;
+			waterVertexCount += meshVertices.size();
+			waterTriangleCount += numTriangles;
+			waterCacheMissRatioBefore += missRatioBefore * numTriangles;
+			waterCacheMissRatio += WaterMesh::GetAverageCacheMissRatio( meshIndices, meshVertices.size() ) * numTriangles;
+		}
+
+		DrawRange& range = surface.lods[lod];
+		range.indexOffset = indices.size() * sizeof( uint32_t );
+		range.indexCount = GLsizei( meshIndices.size() );
+		range.vertexCount = GLsizei( meshVertices.size() );
+
+		const uint32_t base = uint32_t( vertices.size() );
+		for ( const Vec3& position : meshVertices )
+		{
+			Vertex vertex;
+			vertex.position[0] = position.x;
+			vertex.position[1] = position.y;
+			vertex.position[2] = position.z;
+			vertex.coord[0] = position.x * textureScaleS;
+			vertex.coord[1] = position.z * textureScaleT;
+			vertices.push_back( vertex );
+		}
+
+		for ( const uint32_t& index : meshIndices )
+		{
+			indices.push_back( base + index );
+		}
+	}
+
+	waterSurfaces.push_back( surface );
+}
+
+bool Scene::CreateGeometry()
+{
+	glGenBuffers( 1, &vertexBufferHandle );
+	glBindBuffer( GL_ARRAY_BUFFER, vertexBufferHandle );
+	glBufferData( GL_ARRAY_BUFFER, vertices.size() * sizeof( Vertex ), vertices.data(), GL_STATIC_DRAW );
+
+	glGenVertexArrays( 1, &vertexArrayHandle );
+	glBindVertexArray( vertexArrayHandle );
+
+	glEnableVertexAttribArray( 0 );
+	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof( Vertex ), reinterpret_cast<void*>( offsetof( Vertex, position ) ) );
+	glEnableVertexAttribArray( 1 );
+	glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, sizeof( Vertex ), reinterpret_cast<void*>( offsetof( Vertex, coord ) ) );
+
+	glGenBuffers( 1, &indexBufferHandle );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBufferHandle );
+	glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof( uint32_t ), indices.data(), GL_STATIC_DRAW );
+
+	glBindVertexArray( 0 );
+
+	if ( glGetError() != GL_NO_ERROR )
+	{
+		std::cout << "Scene::CreateGeometry: couldn't upload the scene" << std::endl;
+		return false;
+	}
+
+	// The GPU has it now
+	vertices = {};
+	indices = {};
+	return true;
+}
+
+void Scene::Destroy()
+{
+	if ( vertexArrayHandle )
+	{
+		glDeleteVertexArrays( 1, &vertexArrayHandle );
+		glDeleteBuffers( 1, &vertexBufferHandle );
+		glDeleteBuffers( 1, &indexBufferHandle );
+	}
+
+	vertexArrayHandle = 0;
+	vertexBufferHandle = 0;
+	indexBufferHandle = 0;
+}
+
+void Scene::Cull( const Frustum& frustum, const Vec3& viewOrigin, const WaterDetail& waterDetail )
+{
+	TRACE_SCOPE( "Scene::Cull" );
+
+	visibleBrushes.clear();
+	visibleWaterSurfaces.clear();
+
+	nodesTested = brushTree.Cull( frustum, visibleBrushes );
+	nodesTested += waterTree.Cull( frustum, visibleWaterSurfaces );
+
+	visibleWaterLods.clear();
+	visibleWaterDistances.clear();
+	waterVerticesDrawn = 0;
+	for ( const int& surfaceIndex : visibleWaterSurfaces )
+	{
+		const WaterSurface& surface = waterSurfaces[surfaceIndex];
+
+		// Distance to the closest point of the surface
+		const Vec3 closest = Vec3::Max( surface.bounds.mins, Vec3::Min( viewOrigin, surface.bounds.maxs ) );
+		const Vec3 delta = closest - viewOrigin;
+		const float distance = std::sqrt( Vec3::Dot( delta, delta ) );
+		visibleWaterDistances.push_back( distance );
+
+		int lod = 0;
+		if ( waterDetail == WaterDetail::Flat )
+		{
+			lod = FlatWaterLod;
+		}
+		else if ( waterDetail == WaterDetail::Adaptive )
+		{
+			// Pieces double in size every 8 of them
+			const float pieces = distance / (subdivideSize * 8.0f);
+			lod = pieces < 1.0f ? 0 : (pieces < 2.0f ? 1 : 2);
+		}
+
+		visibleWaterLods.push_back( lod );
+		waterVerticesDrawn += surface.lods[lod].vertexCount;
+	}
+
+	// Brushes all look the same, so they go in a single multi-draw
+	drawCounts.clear();
+	drawOffsets.clear();
+	for ( const int& brushIndex : visibleBrushes )
+	{
+		drawCounts.push_back( brushes[brushIndex].indexCount );
+		drawOffsets.push_back( reinterpret_cast<const void*>( brushes[brushIndex].indexOffset ) );
+	}
+}
+
+void Scene::DrawBrushes() const
+{
+	if ( drawCounts.empty() )
+	{
+		return;
+	}
+
+	glBindVertexArray( vertexArrayHandle );
+	glMultiDrawElements( GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(), GLsizei( drawCounts.size() ) );
+}
+
+void Scene::DrawWater( const ShaderProgram& program, const float& time, const TextureAtlas* atlas,
+	const TextureResidency* residency ) const
+{
+	glBindVertexArray( vertexArrayHandle );
+
+	for ( size_t i = 0; i < visibleWaterSurfaces.size(); i++ )
+	{
+		const WaterSurface& surface = waterSurfaces[visibleWaterSurfaces[i]];
+		const DrawRange& range = surface.lods[visibleWaterLods[i]];
+
+		glUniform1f( program.timeHandle, time + surface.timeOffset );
+		if ( atlas != nullptr )
+		{
+			const TextureAtlas::Region& region = atlas->GetRegion( surface.textureIndex );
+			glUniform4i( program.atlasRegionHandle, region.x, region.y, region.width, region.height );
+			glUniform1i( program.atlasPageHandle, region.page );
+			glUniform1i( program.atlasPaletteHandle, region.palette );
+		}
+		else if ( residency != nullptr )
+		{
+			glUniform1i( program.baseLevelHandle, residency->Bind( surface.textureIndex, GL_TEXTURE0, GL_TEXTURE1 ) );
+		}
+
+		glDrawElements( GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+			reinterpret_cast<const void*>( range.indexOffset ) );
+	}
+}
+
+void Scene::RequestWaterTextures( TextureResidency& residency, const float& texelsPerPixel ) const
+{
+	for ( size_t i = 0; i < visibleWaterSurfaces.size(); i++ )
+	{
+		// World units are texels, so this is how many texels land on the nearest pixel,
+		// and every doubling of that is a level down. Rounded down, and looking straight
+		// at it, so it's never coarser than what SelectMipLevel ends up picking
+		const float footprint = std::max( 1.0f, visibleWaterDistances[i] * texelsPerPixel );
+		const int level = int( std::floor( std::log2( footprint ) ) );
+		residency.Request( waterSurfaces[visibleWaterSurfaces[i]].textureIndex, level );
+	}
+}
+
+float Scene::GetTimeUntilRippleStep( const float& time, const float& rippleRate ) const
+{
+	float untilStep = 1.0f / rippleRate;
+	for ( const int& surfaceIndex : visibleWaterSurfaces )
+	{
+		const float surfaceTime = time + waterSurfaces[surfaceIndex].timeOffset;
+		const float step = (std::floor( surfaceTime * rippleRate ) + 1.0f) / rippleRate - surfaceTime;
+		untilStep = std::min( untilStep, step );
+	}
+
+	return untilStep;
+}
+
+Vec3 Scene::GetStartPosition() const
+{
+	// Just outside one corner, up high enough to see over the walls
+	return Vec3( -96.0f, 320.0f, -96.0f );
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,197 @@
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include "Bvh.hpp"
+#include "Math.hpp"
+#include "ShaderProvider.hpp"
+#include "TextureAtlas.hpp"
+#include "TextureResidency.hpp"
+
+#include <vector>
+
+// An example scene for the 3D viewer: a grid of pools made of box brushes, each one
+// filled with water. Water surfaces and brushes each get a BVH, and every frame
+// only what's inside the view frustum gets updated and drawn
+//
+// World units are texels, like in Quake, so a 128-unit wide pool shows the texture once
+class Scene final
+{
+public:
+    // Water is chopped up into pieces of subdivideSize, twice and four times that for
+    // far away surfaces, and the last level isn't chopped at all. That one's for when the
+    // warp happens per pixel, where extra vertices would only cost
+    static constexpr int NumWaterLods = 4;
+    static constexpr int FlatWaterLod = NumWaterLods - 1;
+
+    enum class WaterDetail
+    {
+        // One polygon per surface, the pixel shader does the rippling
+        Flat,
+        // Every surface at subdivideSize, for the vertex warp
+        Subdivided,
+        // Coarser pieces further away
+        Adaptive
+    };
+
+    struct DrawRange
+    {
+        GLsizei indexCount{ 0 };
+        // Byte offset into the index buffer
+        size_t indexOffset{ 0 };
+        GLsizei vertexCount{ 0 };
+    };
+
+    struct Brush
+    {
+        Aabb bounds;
+        GLsizei indexCount{ 0 };
+        // Byte offset into the index buffer
+        size_t indexOffset{ 0 };
+    };
+
+    struct WaterSurface
+    {
+        Aabb bounds;
+        DrawRange lods[NumWaterLods];
+        // So the pools don't all ripple in lockstep
+        float timeOffset{ 0.0f };
+        // Region of the texture atlas or texture of the residency manager, when there is one
+        int textureIndex{ 0 };
+    };
+
+    // poolsPerSide squared pools, the texture size decides the texture coordinates
+    // subdivideSize is in world units, GLQuake uses 64
+    // The pools are spread over numWaterTextures textures, for when they come from an atlas or TextureResidency
+    void BuildExample( const int& poolsPerSide, const int& textureWidth, const int& textureHeight, const float& subdivideSize,
+        const int& numWaterTextures = 1 );
+
+    bool CreateGeometry();
+    void Destroy();
+
+    // Figures out what's visible and how finely to draw the water, call once per frame before drawing
+    void Cull( const Frustum& frustum, const Vec3& viewOrigin, const WaterDetail& waterDetail );
+
+    // All the visible brushes in one call, with whatever program is bound
+    void DrawBrushes() const;
+    // Visible water surfaces, setting gTime for each one since that's all that differs
+    // With an atlas, each one's region goes in uniforms too, so it's still just the one bind
+    // With a residency manager instead, each one binds its own texture
+    void DrawWater( const ShaderProgram& program, const float& time, const TextureAtlas* atlas = nullptr,
+        const TextureResidency* residency = nullptr ) const;
+
+    // Tells the residency manager which textures the visible water needs, and how sharp
+    // texelsPerPixel is how many world units one pixel covers 1 unit in front of the camera
+    void RequestWaterTextures( TextureResidency& residency, const float& texelsPerPixel ) const;
+
+    // How long until the ripples on any of the visible surfaces move next, each one has its own time offset
+    float GetTimeUntilRippleStep( const float& time, const float& rippleRate ) const;
+
+    // Somewhere to start looking from
+    Vec3 GetStartPosition() const;
+
+    size_t GetNumBrushes() const
+    {
+        return brushes.size();
+    }
+
+    size_t GetNumWaterSurfaces() const
+    {
+        return waterSurfaces.size();
+    }
+
+    size_t GetNumVisibleBrushes() const
+    {
+        return visibleBrushes.size();
+    }
+
+    size_t GetNumVisibleWaterSurfaces() const
+    {
+        return visibleWaterSurfaces.size();
+    }
+
+    int GetNumNodesTested() const
+    {
+        return nodesTested;
+    }
+
+    int GetNumWaterVerticesDrawn() const
+    {
+        return waterVerticesDrawn;
+    }
+
+    // For the finest level over the whole scene, before and after the vertex cache optimisation
+    size_t GetNumWaterVertices() const
+    {
+        return waterVertexCount;
+    }
+
+    float GetWaterCacheMissRatio( const bool& optimised ) const
+    {
+        return optimised ? waterCacheMissRatio : waterCacheMissRatioBefore;
+    }
+
+private:
+    // xyz st, same layout as the screen-space quad
+    struct Vertex
+    {
+        float position[3];
+        float coord[2];
+    };
+
+    void AddBox( const Aabb& box );
+    void AddWaterSurface( const Aabb& volume, const float& timeOffset, const float& subdivideSize );
+    void AddQuad( const Vec3& a, const Vec3& b, const Vec3& c, const Vec3& d );
+
+private:
+    std::vector<Brush> brushes;
+    std::vector<WaterSurface> waterSurfaces;
+    Bvh brushTree;
+    Bvh waterTree;
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    float textureScaleS{ 1.0f };
+    float textureScaleT{ 1.0f };
+
+    // Rebuilt by Cull every frame, the memory stays
+    std::vector<int> visibleBrushes;
+    std::vector<int> visibleWaterSurfaces;
+    std::vector<int> visibleWaterLods;
+    std::vector<float> visibleWaterDistances;
+    int waterVerticesDrawn{ 0 };
+    float subdivideSize{ 64.0f };
+
+    size_t waterVertexCount{ 0 };
+    size_t waterTriangleCount{ 0 };
+    float waterCacheMissRatio{ 0.0f };
+    float waterCacheMissRatioBefore{ 0.0f };
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void*> drawOffsets;
+    int nodesTested{ 0 };
+
+    GLuint vertexBufferHandle{ 0 };
+    GLuint indexBufferHandle{ 0 };
+    GLuint vertexArrayHandle{ 0 };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
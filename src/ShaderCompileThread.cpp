@@ -0,0 +1,200 @@
+
+#include "ShaderCompileThread.hpp"
+#include "Trace.hpp"
+
+#include <iostream>
+#include <utility>
+
+bool ShaderCompileThread::Start( std::function<bool()> makeCurrent, std::function<void()> release )
+{
+	Stop();
+
+	stop = false;
+	started = false;
+	startedOkay = false;
+	thread = std::thread( &ShaderCompileThread::ThreadMain, this, std::move( makeCurrent ), std::move( release ) );
+
+	// Worth waiting for, ShaderProvider needs to know whether to send anything this way
+	bool okay = false;
+	{
+		std::unique_lock<std::mutex> lock( mutex );
+		finished.wait( lock, [this]()
+		{
+			return started;
+		} );
+		okay = startedOkay;
+	}
+
+	if ( !okay )
+	{
+		thread.join();
+		std::cout << "ShaderCompileThread::Start: couldn't use a shared context, shaders will compile on the main thread" << std::endl;
+	}
+
+	return okay;
+}
+
+void ShaderCompileThread::Stop()
+{
+	if ( !thread.joinable() )
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		stop = true;
+	}
+	wakeUp.notify_one();
+	thread.join();
+}
+
+std::shared_ptr<ShaderCompileThread::Build> ShaderCompileThread::Submit( const GLuint& program,
+	const GLuint& vertexShader, const bool& compileVertex, const GLuint& fragmentShader, const bool& compileFragment )
+{
+	auto build = std::make_shared<Build>();
+	build->program = program;
+	build->vertexShader = vertexShader;
+	build->fragmentShader = fragmentShader;
+	build->compileVertex = compileVertex;
+	build->compileFragment = compileFragment;
+
+	// The objects were made on this thread's context, the other one
+	// might not see them yet unless the commands have gone out
+	glFlush();
+
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		queue.push_back( build );
+	}
+	wakeUp.notify_one();
+	return build;
+}
+
+void ShaderCompileThread::Wait( const Build& build )
+{
+	std::unique_lock<std::mutex> lock( mutex );
+	finished.wait( lock, [&build]()
+	{
+		return build.IsDone();
+	} );
+}
+
+bool ShaderCompileThread::Discard( Build& build )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	if ( build.IsDone() )
+	{
+		return false;
+	}
+
+	build.discarded = true;
+	return true;
+}
+
+void ShaderCompileThread::ThreadMain( std::function<bool()> makeCurrent, std::function<void()> release )
+{
+	TRACE_THREAD_NAME( "Shader compiler" );
+
+	const bool okay = makeCurrent();
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		started = true;
+		startedOkay = okay;
+	}
+	finished.notify_all();
+
+	if ( !okay )
+	{
+		return;
+	}
+
+	while ( true )
+	{
+		std::shared_ptr<Build> build;
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			wakeUp.wait( lock, [this]()
+			{
+				return stop || !queue.empty();
+			} );
+
+			// Whatever's queued still gets done, or deleted, before stopping
+			if ( queue.empty() )
+			{
+				break;
+			}
+
+			build = std::move( queue.front() );
+			queue.pop_front();
+		}
+
+		{
+			TRACE_SCOPE( "ShaderCompileThread::Build" );
+
+			if ( build->compileVertex )
+			{
+				glCompileShader( build->vertexShader );
+			}
+			if ( build->compileFragment )
+			{
+				glCompileShader( build->fragmentShader );
+			}
+
+			glAttachShader( build->program, build->vertexShader );
+			glAttachShader( build->program, build->fragmentShader );
+			glLinkProgram( build->program );
+
+			// This is the bit that would have held up the frame, asking makes the driver finish
+			GLint linked = GL_FALSE;
+			glGetProgramiv( build->program, GL_LINK_STATUS, &linked );
+			// And this makes sure the main context sees all of it
+			glFinish();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			if ( build->discarded )
+			{
+				DeleteObjects( *build );
+			}
+			build->done.store( true, std::memory_order_release );
+		}
+		finished.notify_all();
+	}
+
+	release();
+}
+
+void ShaderCompileThread::DeleteObjects( const Build& build )
+{
+	glDeleteProgram( build.program );
+	// Shaders it didn't compile belong to other programs too
+	if ( build.compileVertex )
+	{
+		glDeleteShader( build.vertexShader );
+	}
+	if ( build.compileFragment )
+	{
+		glDeleteShader( build.fragmentShader );
+	}
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
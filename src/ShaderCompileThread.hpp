@@ -0,0 +1,99 @@
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Compiles and links shaders on a thread of its own, with a GL context that shares objects with the main one
+//
+// Drivers without KHR_parallel_shader_compile do all the work in glCompileShader, glLinkProgram or
+// the first status query after them, and Mesa's software drivers are like that. So ShaderProvider
+// creates the objects and hands them over here, and only looks at them again once this is done,
+// at which point every query is free and the frame loop never waits on the compiler
+class ShaderCompileThread final
+{
+public:
+    // One program to link; the stages marked for compiling get compiled first
+    class Build final
+    {
+    public:
+        bool IsDone() const
+        {
+            return done.load( std::memory_order_acquire );
+        }
+
+    private:
+        friend class ShaderCompileThread;
+        GLuint program{ 0 };
+        GLuint vertexShader{ 0 };
+        GLuint fragmentShader{ 0 };
+        bool compileVertex{ false };
+        bool compileFragment{ false };
+        std::atomic<bool> done{ false };
+        // Nobody wants it any more, the thread deletes it once it's through with it
+        bool discarded{ false };
+    };
+
+    // makeCurrent and release are called on the thread, at the start and at the end,
+    // to make the shared context current there and let go of it again
+    // Returns false if the context couldn't be made current, the thread's gone again then
+    bool Start( std::function<bool()> makeCurrent, std::function<void()> release );
+    // Finishes whatever's queued first, call it before the contexts go
+    void Stop();
+
+    bool IsRunning() const
+    {
+        return thread.joinable();
+    }
+
+    std::shared_ptr<Build> Submit( const GLuint& program, const GLuint& vertexShader, const bool& compileVertex,
+        const GLuint& fragmentShader, const bool& compileFragment );
+    void Wait( const Build& build );
+
+    // Hands the build's program, and the shaders it compiles, over to the thread to delete
+    // Returns false if it's done already, they're the caller's to delete then
+    bool Discard( Build& build );
+
+private:
+    void ThreadMain( std::function<bool()> makeCurrent, std::function<void()> release );
+    static void DeleteObjects( const Build& build );
+
+private:
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    // For Start and Wait, signalled when the thread's started and whenever a build's done
+    std::condition_variable finished;
+    std::deque<std::shared_ptr<Build>> queue;
+    bool stop{ false };
+    // Set by the thread once it knows whether it got its context
+    bool started{ false };
+    bool startedOkay{ false };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
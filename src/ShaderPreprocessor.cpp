@@ -0,0 +1,225 @@
+
+#include "ShaderPreprocessor.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+
+std::string ShaderDefines::GetKey() const
+{
+	std::string key;
+	for ( const auto& define : defines )
+	{
+		key.append( define.first ).append( 1, '=' ).append( define.second ).append( 1, ';' );
+	}
+
+	return key;
+}
+
+namespace
+{
+	std::string GetDirectory( const std::string& path )
+	{
+		const auto slash = path.find_last_of( "/\\" );
+		if ( slash == std::string::npos )
+		{
+			return "";
+		}
+
+		return path.substr( 0, slash + 1 );
+	}
+
+	// Returns the first non-whitespace position, or npos if the line is blank
+	size_t SkipWhitespace( const std::string& line, size_t position = 0 )
+	{
+		return line.find_first_not_of( " \t\r", position );
+	}
+
+	// Checks if the line is a "#directive", with any amount of whitespace around the #
+	bool IsDirective( const std::string& line, const char* directive, size_t& outEnd )
+	{
+		size_t position = SkipWhitespace( line );
+		if ( position == std::string::npos || line[position] != '#' )
+		{
+			return false;
+		}
+
+		position = SkipWhitespace( line, position + 1 );
+		if ( position == std::string::npos )
+		{
+			return false;
+		}
+
+		const size_t length = strlen( directive );
+		if ( line.compare( position, length, directive ) != 0 )
+		{
+			return false;
+		}
+
+		outEnd = position + length;
+		return true;
+	}
+}
+
+bool ShaderPreprocessor::Process( const char* path, const ShaderDefines& defines, LinearArena& scratch,
+	std::string& outSource, std::vector<std::string>& outDependencies )
+{
+	TRACE_SCOPE( "ShaderPreprocessor::Process" );
+
+	std::string body;
+	std::vector<std::string> includeStack;
+
+	outDependencies.clear();
+	if ( !ProcessFile( path, scratch, body, outDependencies, includeStack ) )
+	{
+		return false;
+	}
+
+	// #version has to be the very first thing, so the defines go right after it
+	size_t versionEnd = 0;
+	{
+		std::string line;
+		size_t lineStart = 0;
+		while ( lineStart < body.size() )
+		{
+			size_t lineEnd = body.find( '\n', lineStart );
+			if ( lineEnd == std::string::npos )
+			{
+				lineEnd = body.size();
+			}
+
+			size_t directiveEnd = 0;
+			line.assign( body, lineStart, lineEnd - lineStart );
+			if ( IsDirective( line, "version", directiveEnd ) )
+			{
+				versionEnd = std::min( lineEnd + 1, body.size() );
+				break;
+			}
+
+			lineStart = lineEnd + 1;
+		}
+	}
+
+	// Count the lines up to and including #version, so error messages still point at the right line
+	const auto versionLines = std::count( body.begin(), body.begin() + versionEnd, '\n' );
+
+	outSource.clear();
+	outSource.reserve( body.size() + 1024 );
+	outSource.append( body, 0, versionEnd );
+	for ( const auto& define : defines.GetDefines() )
+	{
+		outSource.append( "#define " ).append( define.first ).append( 1, ' ' ).append( define.second ).append( 1, '\n' );
+	}
+	outSource.append( "#line " ).append( std::to_string( versionLines + 1 ) ).append( " 0\n" );
+	outSource.append( body, versionEnd, std::string::npos );
+	return true;
+}
+
+bool ShaderPreprocessor::ProcessFile( const std::string& path, LinearArena& scratch, std::string& outSource,
+	std::vector<std::string>& outDependencies, std::vector<std::string>& includeStack )
+{
+	if ( std::find( includeStack.begin(), includeStack.end(), path ) != includeStack.end() )
+	{
+		std::cout << "ShaderPreprocessor: '" << path << "' includes itself" << std::endl;
+		return false;
+	}
+
+	// Everything is included once at most, as if it had #pragma once
+	if ( std::find( outDependencies.begin(), outDependencies.end(), path ) != outDependencies.end() )
+	{
+		return true;
+	}
+
+	std::ifstream file( path, std::ios::binary | std::ios::ate );
+	if ( !file )
+	{
+		std::cout << "ShaderPreprocessor: '" << path << "' does not exist" << std::endl;
+		return false;
+	}
+
+	// In one go, rather than a string per line
+	const size_t size = size_t( file.tellg() );
+	char* const text = scratch.AllocateArray<char>( size );
+	file.seekg( 0 );
+	if ( !file.read( text, std::streamsize( size ) ) )
+	{
+		std::cout << "ShaderPreprocessor: couldn't read '" << path << "'" << std::endl;
+		return false;
+	}
+	outSource.reserve( outSource.size() + size );
+
+	// GLSL's #line takes a source string number instead of a file name, so use the dependency index
+	const auto fileIndex = std::to_string( outDependencies.size() );
+	outDependencies.push_back( path );
+	includeStack.push_back( path );
+
+	const std::string directory = GetDirectory( path );
+
+	int lineNumber = 0;
+	std::string line;
+	const char* const textEnd = text + size;
+	for ( const char* lineStart = text; lineStart < textEnd; )
+	{
+		const char* newline = static_cast<const char*>( memchr( lineStart, '\n', size_t( textEnd - lineStart ) ) );
+		const char* lineEnd = newline != nullptr ? newline : textEnd;
+		const char* nextLine = lineEnd + 1;
+
+		// Same lines whether the file's got Windows line endings or not
+		if ( lineEnd > lineStart && lineEnd[-1] == '\r' )
+		{
+			lineEnd--;
+		}
+
+		line.assign( lineStart, lineEnd );
+		lineStart = nextLine;
+		lineNumber++;
+
+		size_t directiveEnd = 0;
+		if ( !IsDirective( line, "include", directiveEnd ) )
+		{
+			outSource.append( line ).append( 1, '\n' );
+			continue;
+		}
+
+		const size_t nameStart = line.find( '"', directiveEnd );
+		const size_t nameEnd = nameStart == std::string::npos ? std::string::npos : line.find( '"', nameStart + 1 );
+		if ( nameEnd == std::string::npos )
+		{
+			std::cout << "ShaderPreprocessor: bad #include in '" << path << "' at line " << lineNumber << std::endl;
+			return false;
+		}
+
+		const std::string includePath = directory + line.substr( nameStart + 1, nameEnd - nameStart - 1 );
+
+		outSource.append( "#line 1 " ).append( std::to_string( outDependencies.size() ) ).append( 1, '\n' );
+		if ( !ProcessFile( includePath, scratch, outSource, outDependencies, includeStack ) )
+		{
+			return false;
+		}
+		outSource.append( "#line " ).append( std::to_string( lineNumber + 1 ) ).append( 1, ' ' ).append( fileIndex ).append( 1, '\n' );
+	}
+
+	includeStack.pop_back();
+	return true;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
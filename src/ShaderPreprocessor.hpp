@@ -0,0 +1,72 @@
+
+#pragma once
+
+#include "Arena.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Compile-time switches for a shader permutation
+// Kept sorted by name, so the same set of defines always produces the same key
+class ShaderDefines final
+{
+public:
+    ShaderDefines& Set( const std::string& name, const std::string& value = "1" )
+    {
+        defines[name] = value;
+        return *this;
+    }
+
+    ShaderDefines& Set( const std::string& name, const int& value )
+    {
+        return Set( name, std::to_string( value ) );
+    }
+
+    // E.g. "POW2_WRAP=1;TEXTURE_WIDTH=128;"
+    std::string GetKey() const;
+
+    const std::map<std::string, std::string>& GetDefines() const
+    {
+        return defines;
+    }
+
+private:
+    std::map<std::string, std::string> defines;
+};
+
+// Resolves #include "file" directives and injects #defines after the #version line
+// Everything else is left to the GLSL compiler's own preprocessor, which
+// takes care of folding the injected constants
+class ShaderPreprocessor final
+{
+public:
+    // Include paths are relative to the file that includes them
+    // Every file that went into the result gets listed in outDependencies, starting with path itself
+    // The files are read into scratch, which can be Reset as soon as this returns
+    static bool Process( const char* path, const ShaderDefines& defines, LinearArena& scratch,
+        std::string& outSource, std::vector<std::string>& outDependencies );
+
+private:
+    static bool ProcessFile( const std::string& path, LinearArena& scratch, std::string& outSource,
+        std::vector<std::string>& outDependencies, std::vector<std::string>& includeStack );
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,478 @@
+
+#include "ShaderProvider.hpp"
+#include "Trace.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+namespace
+{
+	// FNV-1a, starting from the stage so a vertex and a fragment shader never share a hash
+	uint64_t HashSource( const GLenum& stage, const std::string& code )
+	{
+		uint64_t hash = 0xCBF29CE484222325ull ^ stage;
+		for ( const char& c : code )
+		{
+			hash = (hash ^ uint8_t( c )) * 0x100000001B3ull;
+		}
+
+		return hash;
+	}
+}
+
+void ShaderProvider::Init( const char* vertexPath, const char* fragmentPath, ShaderCompileThread* sharedCompileThread )
+{
+	vertexShaderPath = vertexPath;
+	fragmentShaderPath = fragmentPath;
+	compileThread = nullptr;
+
+	// Both extensions use the same enums, ARB just came first
+	if ( GLEW_KHR_parallel_shader_compile )
+	{
+		parallelCompile = true;
+		// 0xFFFFFFFF lets the driver pick however many threads it likes
+		glMaxShaderCompilerThreadsKHR( 0xFFFFFFFFU );
+	}
+	else if ( GLEW_ARB_parallel_shader_compile )
+	{
+		parallelCompile = true;
+		glMaxShaderCompilerThreadsARB( 0xFFFFFFFFU );
+	}
+
+	if ( !parallelCompile && sharedCompileThread != nullptr && sharedCompileThread->IsRunning() )
+	{
+		compileThread = sharedCompileThread;
+	}
+
+	std::cout << "ShaderProvider: parallel shader compile is " << (parallelCompile ? "available"
+		: compileThread != nullptr ? "not available, compiling on a thread with a shared context instead"
+		: "not available, reloads will block briefly") << std::endl;
+}
+
+void ShaderProvider::Shutdown()
+{
+	DiscardPending();
+
+	for ( auto& variant : variants )
+	{
+		Destroy( variant.second.program );
+	}
+
+	variants.clear();
+	DeleteUnusedShaders();
+}
+
+bool ShaderProvider::Request( const ShaderDefines& defines, ShaderProgram& outProgram )
+{
+	const std::string key = defines.GetKey();
+
+	const auto it = variants.find( key );
+	if ( it != variants.end() && it->second.generation == generation )
+	{
+		// Whatever was pending is no longer wanted
+		DiscardPending();
+		outProgram = it->second.program;
+		return true;
+	}
+
+	// Already on its way
+	if ( IsBuilding() && pendingKey == key )
+	{
+		return false;
+	}
+
+	BeginBuild( defines );
+	return false;
+}
+
+bool ShaderProvider::Reload( const ShaderDefines& defines )
+{
+	TRACE_SCOPE( "ShaderProvider::Reload" );
+
+	generation++;
+	RevalidateVariants();
+
+	// A build in flight might be from the old files, so that one gets redone either way
+	const auto it = variants.find( defines.GetKey() );
+	if ( it != variants.end() && it->second.generation == generation && !IsBuilding() )
+	{
+		std::cout << "ShaderProvider: '" << it->first << "' didn't change, nothing to compile" << std::endl;
+		return true;
+	}
+
+	return BeginBuild( defines );
+}
+
+bool ShaderProvider::ReadSources( const ShaderDefines& defines, StageSource& outVertex, StageSource& outFragment )
+{
+	const bool readBoth = ShaderPreprocessor::Process( vertexShaderPath.c_str(), defines, sourceArena, outVertex.code, outVertex.dependencies )
+		&& ShaderPreprocessor::Process( fragmentShaderPath.c_str(), defines, sourceArena, outFragment.code, outFragment.dependencies );
+
+	// The files are all in the strings now
+	sourceArena.Reset();
+	sourceFiles.insert( outVertex.dependencies.begin(), outVertex.dependencies.end() );
+	sourceFiles.insert( outFragment.dependencies.begin(), outFragment.dependencies.end() );
+	if ( !readBoth )
+	{
+		return false;
+	}
+
+	outVertex.hash = HashSource( GL_VERTEX_SHADER, outVertex.code );
+	outFragment.hash = HashSource( GL_FRAGMENT_SHADER, outFragment.code );
+	return true;
+}
+
+void ShaderProvider::GetSourceFiles( std::vector<std::string>& outPaths ) const
+{
+	outPaths.insert( outPaths.end(), sourceFiles.begin(), sourceFiles.end() );
+}
+
+void ShaderProvider::RevalidateVariants()
+{
+	// Reading and hashing is nothing next to compiling, even for every variant there is
+	int unchanged = 0;
+	StageSource vertex;
+	StageSource fragment;
+	for ( auto& variant : variants )
+	{
+		CachedVariant& cached = variant.second;
+		if ( ReadSources( cached.defines, vertex, fragment )
+			&& vertex.hash == cached.vertexHash && fragment.hash == cached.fragmentHash )
+		{
+			cached.generation = generation;
+			unchanged++;
+		}
+	}
+
+	std::cout << "ShaderProvider: " << unchanged << " of " << variants.size() << " variant(s) didn't change" << std::endl;
+}
+
+GLuint ShaderProvider::GetShader( const GLenum& stage, const StageSource& source, bool& outCompiled )
+{
+	const auto it = shaderObjects.find( source.hash );
+	if ( it != shaderObjects.end() )
+	{
+		outCompiled = false;
+		return it->second;
+	}
+
+	const char* code = source.code.c_str();
+	const GLuint handle = glCreateShader( stage );
+	glShaderSource( handle, 1, &code, nullptr );
+	// No asking how it went, any status query here would make the driver finish the job on this thread
+	// With a compile thread, even glCompileShader is left to that
+	if ( compileThread == nullptr )
+	{
+		glCompileShader( handle );
+	}
+
+	outCompiled = true;
+	return handle;
+}
+
+void ShaderProvider::DeleteUnusedShaders()
+{
+	for ( auto it = shaderObjects.begin(); it != shaderObjects.end(); )
+	{
+		bool used = false;
+		for ( const auto& variant : variants )
+		{
+			used |= variant.second.vertexHash == it->first || variant.second.fragmentHash == it->first;
+		}
+
+		if ( used )
+		{
+			it++;
+		}
+		else
+		{
+			glDeleteShader( it->second );
+			it = shaderObjects.erase( it );
+		}
+	}
+}
+
+bool ShaderProvider::BeginBuild( const ShaderDefines& defines )
+{
+	TRACE_SCOPE( "ShaderProvider::BeginBuild" );
+
+	// Read both files before touching GL, so a missing file doesn't cancel a build that's in flight
+	StageSource vertex;
+	StageSource fragment;
+	if ( !ReadSources( defines, vertex, fragment ) )
+	{
+		return false;
+	}
+
+	DiscardPending();
+
+	pendingKey = defines.GetKey();
+	pendingDefines = defines;
+	pendingVertexDependencies = vertex.dependencies;
+	pendingFragmentDependencies = fragment.dependencies;
+	pendingVertexHash = vertex.hash;
+	pendingFragmentHash = fragment.hash;
+
+	pendingProgramHandle = glCreateProgram();
+	pendingVertexShaderHandle = GetShader( GL_VERTEX_SHADER, vertex, pendingVertexCompiled );
+	pendingFragmentShaderHandle = GetShader( GL_FRAGMENT_SHADER, fragment, pendingFragmentCompiled );
+
+	pendingPolls = 0;
+	if ( compileThread != nullptr )
+	{
+		pendingBuild = compileThread->Submit( pendingProgramHandle, pendingVertexShaderHandle, pendingVertexCompiled,
+			pendingFragmentShaderHandle, pendingFragmentCompiled );
+		return true;
+	}
+
+	// Compile le shadeurs and link right away, without asking how it went
+	glAttachShader( pendingProgramHandle, pendingVertexShaderHandle );
+	glAttachShader( pendingProgramHandle, pendingFragmentShaderHandle );
+	glLinkProgram( pendingProgramHandle );
+	return true;
+}
+
+ShaderProvider::BuildStatus ShaderProvider::Poll( ShaderProgram& outProgram, const bool& wait )
+{
+	if ( !IsBuilding() )
+	{
+		return BuildStatus::Idle;
+	}
+
+	pendingPolls++;
+	if ( !wait && !IsPendingComplete() )
+	{
+		return BuildStatus::Compiling;
+	}
+
+	if ( pendingBuild )
+	{
+		compileThread->Wait( *pendingBuild );
+		pendingBuild.reset();
+	}
+
+	// From here on, status queries are free
+	TRACE_SCOPE( "ShaderProvider::FinishBuild" );
+
+	int success = 0;
+	glGetProgramiv( pendingProgramHandle, GL_LINK_STATUS, &success );
+	if ( !success )
+	{
+		const char* errorMessage = GetShaderError();
+		std::cout << "Error while compiling '" << pendingKey << "': " << errorMessage << std::endl;
+
+		// Error logs refer to files by their source string number
+		const auto printDependencies = []( const char* stage, const std::vector<std::string>& dependencies )
+		{
+			std::cout << "  " << stage << " sources:";
+			for ( size_t i = 0U; i < dependencies.size(); i++ )
+			{
+				std::cout << " " << i << "='" << dependencies[i] << "'";
+			}
+			std::cout << std::endl;
+		};
+		printDependencies( "Vertex", pendingVertexDependencies );
+		printDependencies( "Fragment", pendingFragmentDependencies );
+
+		DiscardPending();
+		return BuildStatus::Failed;
+	}
+
+	ShaderProgram program;
+	program.handle = pendingProgramHandle;
+
+	// The program holds onto the linked code, the shader objects are kept for the next build
+	// that has the same source for a stage
+	glDetachShader( pendingProgramHandle, pendingVertexShaderHandle );
+	glDetachShader( pendingProgramHandle, pendingFragmentShaderHandle );
+	shaderObjects[pendingVertexHash] = pendingVertexShaderHandle;
+	shaderObjects[pendingFragmentHash] = pendingFragmentShaderHandle;
+	const int stagesCompiled = int( pendingVertexCompiled ) + int( pendingFragmentCompiled );
+	pendingProgramHandle = 0;
+	pendingVertexShaderHandle = 0;
+	pendingFragmentShaderHandle = 0;
+	pendingVertexCompiled = false;
+	pendingFragmentCompiled = false;
+
+	program.timeHandle = glGetUniformLocation( program.handle, "gTime" );
+
+	// Samplers never change, so set them up once here
+	GLint currentProgramHandle = 0;
+	glGetIntegerv( GL_CURRENT_PROGRAM, &currentProgramHandle );
+	glUseProgram( program.handle );
+
+	GLint diffuseMapHandle = glGetUniformLocation( program.handle, "diffuseMap" );
+	GLint paletteMapHandle = glGetUniformLocation( program.handle, "paletteMap" );
+
+	glUniform1i( diffuseMapHandle, 0 );
+	glUniform1i( paletteMapHandle, 1 );
+
+	// Only the ATLAS variant has these
+	glUniform1i( glGetUniformLocation( program.handle, "atlasMap" ), 2 );
+	glUniform1i( glGetUniformLocation( program.handle, "atlasPaletteMap" ), 3 );
+	// And only VIRTUAL_TEXTURE this one
+	glUniform1i( glGetUniformLocation( program.handle, "pageTableMap" ), 4 );
+
+	glUseProgram( currentProgramHandle );
+
+	program.upperIndexHandle = glGetUniformLocation( program.handle, "gUpperIndex" );
+	program.lowerIndexHandle = glGetUniformLocation( program.handle, "gLowerIndex" );
+
+	program.textureWidthHandle = glGetUniformLocation( program.handle, "gTextureWidth" );
+	program.textureHeightHandle = glGetUniformLocation( program.handle, "gTextureHeight" );
+
+	program.viewProjectionHandle = glGetUniformLocation( program.handle, "gViewProjection" );
+
+	program.atlasRegionHandle = glGetUniformLocation( program.handle, "gAtlasRegion" );
+	program.atlasPageHandle = glGetUniformLocation( program.handle, "gAtlasPage" );
+	program.atlasPaletteHandle = glGetUniformLocation( program.handle, "gAtlasPalette" );
+
+	program.baseLevelHandle = glGetUniformLocation( program.handle, "gBaseLevel" );
+
+	program.virtualOriginHandle = glGetUniformLocation( program.handle, "gVirtualOrigin" );
+	program.virtualScaleHandle = glGetUniformLocation( program.handle, "gVirtualScale" );
+	program.feedbackFrameHandle = glGetUniformLocation( program.handle, "gFeedbackFrame" );
+
+	std::cout << "ShaderProvider: '" << pendingKey << "' is ready after " << pendingPolls << " poll(s), "
+		<< stagesCompiled << " of 2 stages compiled" << std::endl;
+
+	// Whatever was cached under this key is either a stale generation or a duplicate,
+	// and the caller is about to switch to the new program anyway
+	auto& variant = variants[pendingKey];
+	Destroy( variant.program );
+	variant.program = program;
+	variant.generation = generation;
+	variant.defines = pendingDefines;
+	variant.vertexHash = pendingVertexHash;
+	variant.fragmentHash = pendingFragmentHash;
+
+	EvictStaleVariants();
+	DeleteUnusedShaders();
+
+	outProgram = program;
+	return BuildStatus::Succeeded;
+}
+
+void ShaderProvider::Destroy( ShaderProgram& program )
+{
+	if ( program.handle )
+	{
+		glDeleteProgram( program.handle );
+	}
+
+	program = ShaderProgram();
+}
+
+bool ShaderProvider::IsPendingComplete() const
+{
+	if ( pendingBuild )
+	{
+		return pendingBuild->IsDone();
+	}
+
+	if ( parallelCompile )
+	{
+		int complete = GL_FALSE;
+		glGetProgramiv( pendingProgramHandle, GL_COMPLETION_STATUS_KHR, &complete );
+		return complete == GL_TRUE;
+	}
+
+	// No way of asking without blocking, so give the driver one frame's worth of head start
+	return pendingPolls > 1;
+}
+
+void ShaderProvider::DiscardPending()
+{
+	// Still on the compile thread, which deletes it all when it's done
+	if ( pendingBuild && compileThread->Discard( *pendingBuild ) )
+	{
+		pendingProgramHandle = 0;
+		pendingVertexShaderHandle = 0;
+		pendingFragmentShaderHandle = 0;
+	}
+	pendingBuild.reset();
+
+	if ( pendingProgramHandle )
+	{
+		glDeleteProgram( pendingProgramHandle );
+	}
+	// The ones that came from shaderObjects belong to other variants too
+	if ( pendingVertexShaderHandle && pendingVertexCompiled )
+	{
+		glDeleteShader( pendingVertexShaderHandle );
+	}
+	if ( pendingFragmentShaderHandle && pendingFragmentCompiled )
+	{
+		glDeleteShader( pendingFragmentShaderHandle );
+	}
+
+	pendingProgramHandle = 0;
+	pendingVertexShaderHandle = 0;
+	pendingFragmentShaderHandle = 0;
+	pendingVertexCompiled = false;
+	pendingFragmentCompiled = false;
+	pendingPolls = 0;
+	pendingKey.clear();
+}
+
+void ShaderProvider::EvictStaleVariants()
+{
+	// Only called right after a successful build, which the caller switches to immediately,
+	// so nothing from an older generation is in use anymore
+	for ( auto it = variants.begin(); it != variants.end(); )
+	{
+		if ( it->second.generation != generation )
+		{
+			Destroy( it->second.program );
+			it = variants.erase( it );
+		}
+		else
+		{
+			it++;
+		}
+	}
+}
+
+const char* ShaderProvider::GetShaderError() const
+{
+	int success;
+	static char infoLog[512];
+
+	// Check the vertex shader
+	glGetShaderiv( pendingVertexShaderHandle, GL_COMPILE_STATUS, &success );
+	if ( !success )
+	{
+		glGetShaderInfoLog( pendingVertexShaderHandle, 512, nullptr, infoLog );
+		return infoLog;
+	}
+	// Then the fragment shader
+	glGetShaderiv( pendingFragmentShaderHandle, GL_COMPILE_STATUS, &success );
+	if ( !success )
+	{
+		glGetShaderInfoLog( pendingFragmentShaderHandle, 512, nullptr, infoLog );
+		return infoLog;
+	}
+	// Both compiled, so it's the linker complaining
+	glGetProgramInfoLog( pendingProgramHandle, 512, nullptr, infoLog );
+	return infoLog;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,198 @@
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ShaderPreprocessor.hpp"
+#include "ShaderCompileThread.hpp"
+
+// A linked GPU program along with the uniform locations the frame loop needs
+// Swapping one of these is a single assignment, so the frame loop never sees half of a program
+struct ShaderProgram
+{
+    GLuint handle{ 0 };
+
+    GLint timeHandle{ -1 };
+    GLint upperIndexHandle{ -1 };
+    GLint lowerIndexHandle{ -1 };
+    GLint textureWidthHandle{ -1 };
+    GLint textureHeightHandle{ -1 };
+    GLint viewProjectionHandle{ -1 };
+    GLint atlasRegionHandle{ -1 };
+    GLint atlasPageHandle{ -1 };
+    GLint atlasPaletteHandle{ -1 };
+    GLint baseLevelHandle{ -1 };
+    GLint virtualOriginHandle{ -1 };
+    GLint virtualScaleHandle{ -1 };
+    GLint feedbackFrameHandle{ -1 };
+
+    operator bool() const
+    {
+        return handle != 0;
+    }
+};
+
+// Compiles and links shader programs without stalling the frame loop
+// With KHR_parallel_shader_compile (or the ARB flavour), the driver compiles on its own threads
+// and we simply poll GL_COMPLETION_STATUS_KHR every frame. Without it, the compiling and linking
+// goes to a ShaderCompileThread if there is one, and if there isn't, the status query is postponed
+// by a frame so drivers that compile lazily still get a chance to overlap with rendering
+// 
+// Every permutation of defines is a separate program, and they're all kept around until
+// the source files get reloaded, so flipping between variants only compiles each one once
+//
+// Reloads only redo what changed: every stage's final source (includes and defines and all)
+// is hashed, compiled shader objects are kept by hash, and a variant whose sources hash the
+// same as before is kept as it is. So a reload with nothing changed doesn't compile anything,
+// and one with just the pixel shader changed compiles that and relinks with the old vertex shader
+class ShaderProvider final
+{
+public:
+    enum class BuildStatus
+    {
+        Idle,       // Nothing is being built
+        Compiling,  // Still in progress, keep rendering with the old program
+        Succeeded,  // A new program is ready and was written into the output
+        Failed      // Compiling or linking failed, the pending program was discarded
+    };
+
+    // compileThread is only used if the driver can't compile in parallel itself, and has to outlive this
+    void Init( const char* vertexShaderPath, const char* fragmentShaderPath, ShaderCompileThread* compileThread = nullptr );
+    void Shutdown();
+
+    // Fills in outProgram and returns true if this variant is already compiled,
+    // otherwise starts building it and returns false; Poll will hand it over once it's done
+    // Returns false if the variant couldn't even be submitted, i.e. the files couldn't be read
+    bool Request( const ShaderDefines& defines, ShaderProgram& outProgram );
+
+    // The source files may have changed, so every cached variant is checked against them
+    // Changed ones stay alive until a fresh build succeeds, so there's always something to draw with
+    // If this variant didn't change, there's nothing to build and Poll stays Idle
+    bool Reload( const ShaderDefines& defines );
+
+    // Checks on the pending build; if wait is true, this blocks until the driver is done
+    // On success, the program is owned by the cache, don't destroy it yourself
+    BuildStatus Poll( ShaderProgram& outProgram, const bool& wait = false );
+
+    bool IsBuilding() const
+    {
+        return pendingProgramHandle != 0;
+    }
+
+    bool HasParallelCompile() const
+    {
+        return parallelCompile;
+    }
+
+    size_t GetNumVariants() const
+    {
+        return variants.size();
+    }
+
+    size_t GetNumShaderObjects() const
+    {
+        return shaderObjects.size();
+    }
+
+    // Every file any build has read so far, includes too, for watching them
+    void GetSourceFiles( std::vector<std::string>& outPaths ) const;
+
+private:
+    // One stage's source after preprocessing, hashed with the stage so the same text
+    // as a vertex and a fragment shader doesn't come out the same
+    struct StageSource
+    {
+        std::string code;
+        std::vector<std::string> dependencies;
+        uint64_t hash{ 0 };
+    };
+
+    bool ReadSources( const ShaderDefines& defines, StageSource& outVertex, StageSource& outFragment );
+    // Marks every cached variant whose sources haven't changed as up to date
+    void RevalidateVariants();
+    // Starts compiling the stage unless a shader object with the same hash is around already
+    GLuint GetShader( const GLenum& stage, const StageSource& source, bool& outCompiled );
+    void DeleteUnusedShaders();
+
+    bool BeginBuild( const ShaderDefines& defines );
+    bool IsPendingComplete() const;
+    void DiscardPending();
+    void EvictStaleVariants();
+    const char* GetShaderError() const;
+
+    static void Destroy( ShaderProgram& program );
+
+private:
+    struct CachedVariant
+    {
+        ShaderProgram program;
+        // Which reload this was compiled from, or checked against
+        int generation{ 0 };
+        // To check it against the files again on the next reload
+        ShaderDefines defines;
+        uint64_t vertexHash{ 0 };
+        uint64_t fragmentHash{ 0 };
+    };
+
+    bool parallelCompile{ false };
+    // Null unless it's being used
+    ShaderCompileThread* compileThread{ nullptr };
+
+    std::string vertexShaderPath;
+    std::string fragmentShaderPath;
+    // Shader files get read into this, it lives as long as the provider and is emptied after every build
+    LinearArena sourceArena{ 64 * 1024 };
+
+    // Keyed by ShaderDefines::GetKey
+    std::unordered_map<std::string, CachedVariant> variants;
+    int generation{ 0 };
+
+    // Compiled stages, keyed by StageSource::hash, kept as long as a variant uses them
+    std::unordered_map<uint64_t, GLuint> shaderObjects;
+    std::unordered_set<std::string> sourceFiles;
+
+    std::string pendingKey;
+    ShaderDefines pendingDefines;
+    GLuint pendingProgramHandle{ 0 };
+    GLuint pendingVertexShaderHandle{ 0 };
+    GLuint pendingFragmentShaderHandle{ 0 };
+    uint64_t pendingVertexHash{ 0 };
+    uint64_t pendingFragmentHash{ 0 };
+    // Whether the stage is being compiled for this build, rather than coming from shaderObjects
+    bool pendingVertexCompiled{ false };
+    bool pendingFragmentCompiled{ false };
+    // What compileThread is doing with the pending build, if it's got it
+    std::shared_ptr<ShaderCompileThread::Build> pendingBuild;
+    // How many times Poll was called for the current build
+    int pendingPolls{ 0 };
+
+    // Files that went into the pending build, for decoding the source string numbers in error logs
+    std::vector<std::string> pendingVertexDependencies;
+    std::vector<std::string> pendingFragmentDependencies;
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,262 @@
+
+#include "SoftwareWater.hpp"
+#include "JobSystem.hpp"
+#include "TextureSwizzle.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 2)
+#define SWATER_SSE2 1
+#include <emmintrin.h>
+#else
+#define SWATER_SSE2 0
+#endif
+
+namespace
+{
+	// GL_REPEAT for integer coordinates, negative ones included
+	int Wrap( const int& coord, const int& size )
+	{
+		const int result = coord % size;
+		return result < 0 ? result + size : result;
+	}
+
+	// Where the fragment at this pixel lands in the texture, see Coord_F2I
+	// fragmentCoord is interpolated at pixel centres, so that's what this uses
+	int PixelToTexel( const int& pixel, const int& pixels, const int& texels )
+	{
+		const float coord = (float( pixel ) + 0.5f) / float( pixels );
+		return int( coord * float( texels ) );
+	}
+
+	// A 256 wide tile is a quarter of a 1024 row, small enough that there's plenty
+	// to steal and big enough that the column tables stay in cache for a while
+	constexpr int TileWidth = 256;
+	constexpr int TileHeight = 32;
+
+	// The furthest the ripples sample off the texel they're on, 48 to the left and
+	// 32 rows down, or 15 to the right for the last of a 16-pixel vector
+	constexpr int MinGuard = 48;
+
+	// The column tables, kept around per thread and only ever grown,
+	// so once a thread's seen a size its steps don't go to the heap again
+	thread_local std::vector<uint32_t> columnTables;
+
+	// The rest of the shader, once the three samples are in
+	uint8_t ShadePixel( const uint8_t& main, const uint8_t& primary, const uint8_t& secondary, const WaterParameters& parameters )
+	{
+		// FixIndex; the sum is never negative and never over 510, so no modulo needed
+		int averageIndex = (primary + secondary) / 2;
+		if ( parameters.fixFogIndex && averageIndex == 4 )
+		{
+			averageIndex = 5;
+		}
+
+		const bool ripple = (averageIndex & 48) != 0
+			&& averageIndex > parameters.lowerIndex
+			&& averageIndex < parameters.upperIndex;
+
+		return ripple ? uint8_t( averageIndex ) : main;
+	}
+
+#if SWATER_SSE2
+	// ShadePixel's constants, a byte per lane
+	struct ShadeConstants
+	{
+		__m128i one;
+		__m128i four;
+		__m128i bits48;
+		// One where FixIndex applies, zero otherwise
+		__m128i fogFix;
+		// The thresholds as an inclusive range, since SSE2 only compares unsigned bytes for equality
+		__m128i lowest;
+		__m128i highest;
+		// Zero if nothing can be in that range
+		__m128i anyRipples;
+	};
+
+	ShadeConstants MakeShadeConstants( const WaterParameters& parameters )
+	{
+		const int lowest = parameters.lowerIndex + 1;
+		const int highest = parameters.upperIndex - 1;
+		const bool anyRipples = lowest <= highest && lowest <= 255 && highest >= 0;
+
+		ShadeConstants constants;
+		constants.one = _mm_set1_epi8( 1 );
+		constants.four = _mm_set1_epi8( 4 );
+		constants.bits48 = _mm_set1_epi8( 48 );
+		constants.fogFix = parameters.fixFogIndex ? constants.one : _mm_setzero_si128();
+		constants.lowest = _mm_set1_epi8( char( std::max( lowest, 0 ) ) );
+		constants.highest = _mm_set1_epi8( char( std::min( highest, 255 ) ) );
+		constants.anyRipples = anyRipples ? _mm_set1_epi8( -1 ) : _mm_setzero_si128();
+		return constants;
+	}
+
+	// ShadePixel for 16 pixels
+	__m128i ShadePixels( const __m128i& main, const __m128i& primary, const __m128i& secondary, const ShadeConstants& constants )
+	{
+		// avg_epu8 rounds up, so the low bit of the xor comes back off to round down like / 2
+		__m128i average = _mm_sub_epi8( _mm_avg_epu8( primary, secondary ),
+			_mm_and_si128( _mm_xor_si128( primary, secondary ), constants.one ) );
+		average = _mm_add_epi8( average, _mm_and_si128( _mm_cmpeq_epi8( average, constants.four ), constants.fogFix ) );
+
+		const __m128i outsideBand = _mm_cmpeq_epi8( _mm_and_si128( average, constants.bits48 ), _mm_setzero_si128() );
+		const __m128i aboveLowest = _mm_cmpeq_epi8( _mm_max_epu8( average, constants.lowest ), average );
+		const __m128i belowHighest = _mm_cmpeq_epi8( _mm_min_epu8( average, constants.highest ), average );
+		const __m128i ripple = _mm_andnot_si128( outsideBand,
+			_mm_and_si128( _mm_and_si128( aboveLowest, belowHighest ), constants.anyRipples ) );
+
+		return _mm_or_si128( _mm_and_si128( ripple, average ), _mm_andnot_si128( ripple, main ) );
+	}
+
+	__m128i Load16( const uint8_t* texels )
+	{
+		return _mm_loadu_si128( reinterpret_cast<const __m128i*>( texels ) );
+	}
+#endif
+
+	// RenderIndices for a texel per pixel across, out of the texture's guard band
+	// Every row of pixels reads a run of texels from each of three rows then, and
+	// the guard band means a run can go over the edge, so there are no column tables,
+	// no modulo, and with SSE2 it's 16 pixels per loop
+	void RenderIndicesGuarded( const Texture& texture, const WaterParameters& parameters,
+		const int& width, const int& height, uint8_t* outIndices, JobSystem& jobSystem )
+	{
+		const int textureWidth = int( texture.GetWidth() );
+		const int textureHeight = int( texture.GetHeight() );
+		const GuardBand& guardBand = texture.GetGuardBand();
+		const uint8_t* origin = guardBand.GetOrigin();
+		const ptrdiff_t stride = ptrdiff_t( guardBand.GetStride() );
+
+		// Wrapped once here, after that a run that starts past the edge just moves back by a width
+		const int timeOffset = int( parameters.time * parameters.rippleRate );
+		const int shiftX = Wrap( timeOffset, textureWidth );
+		const int shiftY = Wrap( timeOffset, textureHeight );
+
+#if SWATER_SSE2
+		const ShadeConstants constants = MakeShadeConstants( parameters );
+#endif
+
+		jobSystem.ParallelFor2D( width, height, TileWidth, TileHeight, [&]( const int& x0, const int& y0, const int& x1, const int& y1 )
+		{
+			for ( int y = y0; y < y1; y++ )
+			{
+				const int texelY = PixelToTexel( y, height, textureHeight );
+				const int secondaryY = texelY + shiftY - (texelY + shiftY >= textureHeight ? textureHeight : 0);
+
+				const uint8_t* mainRow = origin + texelY * stride;
+				// Up to 32 rows past the top, into the guard band
+				const uint8_t* primaryRow = origin + (texelY + 32) * stride;
+				const uint8_t* secondaryRow = origin + secondaryY * stride;
+				// The secondary samples start up to 48 texels before the row, also in the guard band
+				uint8_t* out = outIndices + size_t( y ) * width;
+
+				int x = x0;
+#if SWATER_SSE2
+				for ( ; x + 16 <= x1; x += 16 )
+				{
+					const int primaryX = x + shiftX - (x + shiftX >= textureWidth ? textureWidth : 0);
+					const __m128i pixels = ShadePixels( Load16( mainRow + x ), Load16( primaryRow + primaryX ),
+						Load16( secondaryRow + x - 48 ), constants );
+					_mm_storeu_si128( reinterpret_cast<__m128i*>( out + x ), pixels );
+				}
+#endif
+				for ( ; x < x1; x++ )
+				{
+					const int primaryX = x + shiftX - (x + shiftX >= textureWidth ? textureWidth : 0);
+					out[x] = ShadePixel( mainRow[x], primaryRow[primaryX], secondaryRow[x - 48], parameters );
+				}
+			}
+		} );
+	}
+}
+
+void SoftwareWater::RenderIndices( const Texture& texture, const WaterParameters& parameters,
+	const int& width, const int& height, uint8_t* outIndices, JobSystem* jobs )
+{
+	JobSystem& jobSystem = jobs != nullptr ? *jobs : JobSystem::Get();
+
+	// A texel per pixel across is what --cpu-water at the texture's size and the layout
+	// benchmarks do, anything else scales and goes through the column tables
+	const GuardBand& guardBand = texture.GetGuardBand();
+	if ( !guardBand.IsEmpty() && guardBand.GetGuard() >= MinGuard && width == int( texture.GetWidth() ) )
+	{
+		RenderIndicesGuarded( texture, parameters, width, height, outIndices, jobSystem );
+		return;
+	}
+
+	const int textureWidth = int( texture.GetWidth() );
+	const int textureHeight = int( texture.GetHeight() );
+	const uint8_t* texels = texture.GetBuffer().data();
+	// Works out where texels are for whatever layout the texture's in
+	const TextureSampler sampler( texture );
+
+	// TimeFraction in the shader
+	const int timeOffset = int( parameters.time * parameters.rippleRate );
+
+	// The offsets are the same for every row, so the wrapped columns are worked out once
+	// In any layout a texel is at its column's offset plus its row's, so rows just add theirs
+	if ( columnTables.size() < size_t( width ) * 3U )
+	{
+		columnTables.resize( size_t( width ) * 3U );
+	}
+	uint32_t* mainColumns = columnTables.data();
+	uint32_t* primaryColumns = mainColumns + width;
+	uint32_t* secondaryColumns = primaryColumns + width;
+	for ( int x = 0; x < width; x++ )
+	{
+		const int texelX = PixelToTexel( x, width, textureWidth );
+		mainColumns[x] = sampler.GetColumnOffset( Wrap( texelX, textureWidth ) );
+		primaryColumns[x] = sampler.GetColumnOffset( Wrap( texelX + timeOffset, textureWidth ) );
+		secondaryColumns[x] = sampler.GetColumnOffset( Wrap( texelX - 48, textureWidth ) );
+	}
+
+	jobSystem.ParallelFor2D( width, height, TileWidth, TileHeight, [&]( const int& x0, const int& y0, const int& x1, const int& y1 )
+	{
+		for ( int y = y0; y < y1; y++ )
+		{
+			const int texelY = PixelToTexel( y, height, textureHeight );
+			const uint8_t* mainRow = texels + sampler.GetRowOffset( Wrap( texelY, textureHeight ) );
+			const uint8_t* primaryRow = texels + sampler.GetRowOffset( Wrap( texelY + 32, textureHeight ) );
+			const uint8_t* secondaryRow = texels + sampler.GetRowOffset( Wrap( texelY + timeOffset, textureHeight ) );
+
+			uint8_t* out = outIndices + size_t( y ) * width;
+			for ( int x = x0; x < x1; x++ )
+			{
+				out[x] = ShadePixel( mainRow[mainColumns[x]], primaryRow[primaryColumns[x]], secondaryRow[secondaryColumns[x]], parameters );
+			}
+		}
+	} );
+}
+
+void SoftwareWater::ExpandPalette( const PaletteBuffer& palette, const uint8_t* indices,
+	const size_t& count, uint8_t* outRgb )
+{
+	for ( size_t i = 0; i < count; i++ )
+	{
+		const PaletteEntry& entry = palette[indices[i]];
+		outRgb[i * 3U + 0U] = entry[0];
+		outRgb[i * 3U + 1U] = entry[1];
+		outRgb[i * 3U + 2U] = entry[2];
+	}
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,58 @@
+
+#pragma once
+
+#include "TextureProvider.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+class JobSystem;
+
+// Everything pixelShader.glsl takes as uniforms or variant defines
+struct WaterParameters
+{
+    float time{ 0.0f };
+    int upperIndex{ 192 };
+    int lowerIndex{ 20 };
+    bool fixFogIndex{ true };
+    // Same as RIPPLE_RATE in the shader
+    float rippleRate{ 20.0f };
+};
+
+// CPU reference for pixelShader.glsl, used to check what the GPU draws
+// Output rows go bottom to top like glReadPixels, so the two can be compared as-is
+//
+// If you change the shader's maths, change it here too, --golden will tell you if you forgot
+class SoftwareWater final
+{
+public:
+    // Writes width * height palette indices, the same ones the OUTPUT_INDICES variant writes
+    // Tiles of the screen go out as jobs, on the shared job system unless it's given another
+    // The texture can be in any TextureLayout, the output's the same either way
+    // With a guard band of at least 48 and a texel per pixel across, it goes through that instead
+    static void RenderIndices( const Texture& texture, const WaterParameters& parameters,
+        const int& width, const int& height, uint8_t* outIndices, JobSystem* jobs = nullptr );
+
+    // Looks the indices up in the palette, writing count RGB triplets
+    static void ExpandPalette( const PaletteBuffer& palette, const uint8_t* indices,
+        const size_t& count, uint8_t* outRgb );
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
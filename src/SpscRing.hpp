@@ -0,0 +1,92 @@
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Fixed-size queue between exactly one producer thread and exactly one consumer thread
+// No locks: each side only ever writes its own index, and reads the other one's with
+// acquire so whatever went into a slot before its index moved is visible too
+//
+// The indices just count up and get masked, so all Capacity slots are usable, and each
+// side keeps a stale copy of the other's index so it only has to look at the real one
+// (and pull its cache line over) when the ring seems full or empty
+template<typename T, size_t Capacity>
+class SpscRing final
+{
+public:
+    static_assert( Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing: Capacity has to be a power of two" );
+
+    // Producer only; false if it's full, value is left alone then
+    bool Push( T& value )
+    {
+        const size_t currentTail = tail.load( std::memory_order_relaxed );
+        if ( currentTail - cachedHead == Capacity )
+        {
+            cachedHead = head.load( std::memory_order_acquire );
+            if ( currentTail - cachedHead == Capacity )
+            {
+                return false;
+            }
+        }
+
+        slots[currentTail & (Capacity - 1)] = std::move( value );
+        tail.store( currentTail + 1, std::memory_order_release );
+        return true;
+    }
+
+    // Consumer only; false if it's empty
+    bool Pop( T& outValue )
+    {
+        const size_t currentHead = head.load( std::memory_order_relaxed );
+        if ( currentHead == cachedTail )
+        {
+            cachedTail = tail.load( std::memory_order_acquire );
+            if ( currentHead == cachedTail )
+            {
+                return false;
+            }
+        }
+
+        outValue = std::move( slots[currentHead & (Capacity - 1)] );
+        head.store( currentHead + 1, std::memory_order_release );
+        return true;
+    }
+
+private:
+    // Producer and consumer each get a cache line to themselves, so they don't keep
+    // taking it off each other every time one of them moves
+    static constexpr size_t CacheLineSize = 64;
+
+    // Next slot to pop, only written by the consumer
+    alignas( CacheLineSize ) std::atomic<size_t> head{ 0 };
+    // The consumer's last look at tail
+    size_t cachedTail{ 0 };
+
+    // Next slot to push, only written by the producer
+    alignas( CacheLineSize ) std::atomic<size_t> tail{ 0 };
+    // The producer's last look at head
+    size_t cachedHead{ 0 };
+
+    alignas( CacheLineSize ) T slots[Capacity];
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,258 @@
+
+#include "TextureAtlas.hpp"
+#include "Trace.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// ImGui compiles its own copy with STBRP_STATIC, so this one doesn't clash with it
+// Not static itself, otherwise the heuristic setter nobody calls warns about being unused
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+
+int TextureAtlas::Add( const Texture& texture )
+{
+	textures.push_back( texture );
+	return int( textures.size() - 1 );
+}
+
+bool TextureAtlas::Build( const int& size, const int& padding )
+{
+	TRACE_SCOPE( "TextureAtlas::Build" );
+
+	pageSize = size;
+	pages.clear();
+	palettes.clear();
+	regions.assign( textures.size(), Region() );
+
+	std::vector<stbrp_rect> pending;
+	for ( size_t i = 0; i < textures.size(); i++ )
+	{
+		const Texture& texture = textures[i];
+
+		stbrp_rect rect{};
+		rect.id = int( i );
+		rect.w = stbrp_coord( texture.GetWidth() + padding * 2 );
+		rect.h = stbrp_coord( texture.GetHeight() + padding * 2 );
+		if ( int( rect.w ) > size || int( rect.h ) > size )
+		{
+			std::cout << "TextureAtlas::Build: texture " << i << " is " << texture.GetWidth() << "x" << texture.GetHeight()
+				<< ", that won't fit on a " << size << "x" << size << " page" << std::endl;
+			return false;
+		}
+		pending.push_back( rect );
+
+		// Textures from the same WAD tend to share their palette, those get one row between them
+		const PaletteBuffer palette = texture.GetPalette();
+		int paletteRow = -1;
+		for ( size_t row = 0; row < palettes.size(); row++ )
+		{
+			if ( !memcmp( palettes[row].data(), palette.data(), sizeof( PaletteBuffer ) ) )
+			{
+				paletteRow = int( row );
+				break;
+			}
+		}
+
+		if ( paletteRow < 0 )
+		{
+			paletteRow = int( palettes.size() );
+			palettes.push_back( palette );
+		}
+		regions[i].palette = paletteRow;
+	}
+
+	// Fill a page with as much as fits, then start another one with what's left
+	std::vector<stbrp_node> nodes( size );
+	std::vector<stbrp_rect> leftOver;
+	while ( !pending.empty() )
+	{
+		stbrp_context context;
+		stbrp_init_target( &context, size, size, nodes.data(), int( nodes.size() ) );
+		stbrp_pack_rects( &context, pending.data(), int( pending.size() ) );
+
+		const int pageIndex = int( pages.size() );
+		pages.emplace_back( size_t( size ) * size, uint8_t( 0 ) );
+		std::vector<uint8_t>& page = pages.back();
+
+		leftOver.clear();
+		for ( const stbrp_rect& rect : pending )
+		{
+			if ( !rect.was_packed )
+			{
+				leftOver.push_back( rect );
+				continue;
+			}
+
+			const Texture& texture = textures[rect.id];
+			const int width = int( texture.GetWidth() );
+			const int height = int( texture.GetHeight() );
+			const uint8_t* source = texture.GetBuffer().data();
+
+			Region& region = regions[rect.id];
+			region.x = rect.x + padding;
+			region.y = rect.y + padding;
+			region.width = width;
+			region.height = height;
+			region.page = pageIndex;
+
+			// The border is the texture wrapped around, like GL_REPEAT would see it
+			for ( int y = -padding; y < height + padding; y++ )
+			{
+				const int sourceY = ((y % height) + height) % height;
+				uint8_t* row = &page[size_t( region.y + y ) * size + region.x];
+
+				for ( int x = -padding; x < width + padding; x++ )
+				{
+					const int sourceX = ((x % width) + width) % width;
+					row[x] = source[sourceY * width + sourceX];
+				}
+			}
+		}
+
+		pending.swap( leftOver );
+	}
+
+	numPages = int( pages.size() );
+
+	// Everything's in the pages now
+	textures = {};
+	return true;
+}
+
+bool TextureAtlas::Upload()
+{
+	TRACE_SCOPE( "TextureAtlas::Upload" );
+
+	if ( pages.empty() )
+	{
+		std::cout << "TextureAtlas::Upload: nothing to upload, call Build first" << std::endl;
+		return false;
+	}
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+	glGenTextures( 1, &pageTextureHandle );
+	glBindTexture( GL_TEXTURE_2D_ARRAY, pageTextureHandle );
+	glTexImage3D( GL_TEXTURE_2D_ARRAY, 0, GL_R8, pageSize, pageSize, GLsizei( pages.size() ), 0, GL_RED, GL_UNSIGNED_BYTE, nullptr );
+	for ( size_t i = 0; i < pages.size(); i++ )
+	{
+		glTexSubImage3D( GL_TEXTURE_2D_ARRAY, 0, 0, 0, GLint( i ), pageSize, pageSize, 1, GL_RED, GL_UNSIGNED_BYTE, pages[i].data() );
+	}
+
+	// Indices again, so no filtering, and the shader does the wrapping
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0 );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+	std::vector<uint8_t> paletteTable;
+	paletteTable.reserve( palettes.size() * 256 * 3 );
+	for ( const PaletteBuffer& palette : palettes )
+	{
+		for ( const PaletteEntry& entry : palette )
+		{
+			paletteTable.insert( paletteTable.end(), entry, entry + 3 );
+		}
+	}
+
+	glGenTextures( 1, &paletteTextureHandle );
+	glBindTexture( GL_TEXTURE_2D, paletteTextureHandle );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB8, 256, GLsizei( palettes.size() ), 0, GL_RGB, GL_UNSIGNED_BYTE, paletteTable.data() );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+	if ( glGetError() != GL_NO_ERROR )
+	{
+		std::cout << "TextureAtlas::Upload: couldn't upload the pages" << std::endl;
+		return false;
+	}
+
+	printf( "TextureAtlas::Upload: %i textures on %i page(s) of %ix%i, %i palette(s), %.0f%% occupied\n",
+		int( regions.size() ), numPages, pageSize, pageSize, int( palettes.size() ), GetOccupancy() * 100.0f );
+
+	// The GPU has it now
+	pages = {};
+	return true;
+}
+
+void TextureAtlas::Destroy()
+{
+	if ( pageTextureHandle )
+	{
+		glDeleteTextures( 1, &pageTextureHandle );
+		glDeleteTextures( 1, &paletteTextureHandle );
+	}
+
+	pageTextureHandle = 0;
+	paletteTextureHandle = 0;
+}
+
+void TextureAtlas::Bind( const GLenum& pageUnit, const GLenum& paletteUnit ) const
+{
+	glActiveTexture( pageUnit );
+	glBindTexture( GL_TEXTURE_2D_ARRAY, pageTextureHandle );
+	glActiveTexture( paletteUnit );
+	glBindTexture( GL_TEXTURE_2D, paletteTextureHandle );
+}
+
+std::vector<TextureAtlas::Remap> TextureAtlas::GetRemapTable() const
+{
+	std::vector<Remap> table;
+	table.reserve( regions.size() );
+
+	const float texelSize = 1.0f / float( pageSize );
+	for ( const Region& region : regions )
+	{
+		Remap remap;
+		remap.offset[0] = region.x * texelSize;
+		remap.offset[1] = region.y * texelSize;
+		remap.scale[0] = region.width * texelSize;
+		remap.scale[1] = region.height * texelSize;
+		remap.page = float( region.page );
+		remap.palette = (region.palette + 0.5f) / float( palettes.size() );
+		table.push_back( remap );
+	}
+
+	return table;
+}
+
+float TextureAtlas::GetOccupancy() const
+{
+	if ( numPages == 0 )
+	{
+		return 0.0f;
+	}
+
+	size_t texels = 0;
+	for ( const Region& region : regions )
+	{
+		texels += size_t( region.width ) * region.height;
+	}
+
+	return float( double( texels ) / (double( numPages ) * pageSize * pageSize) );
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
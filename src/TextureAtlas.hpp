@@ -0,0 +1,124 @@
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include "TextureProvider.hpp"
+
+#include <vector>
+
+// Packs lots of small indexed textures into a few big R8 pages, so surfaces with
+// different textures can all be drawn without binding anything in between
+// The packing is stb_rect_pack's, which ImGui already brings along for its font atlas
+//
+// Pages go to the GPU as one texture array, and palettes as a table with a row for each
+// different palette, so textures that share a palette share a row too. GL_REPEAT only
+// works on whole textures, so the shader wraps inside each region by itself, and every
+// region gets a border of wrapped-around texels so anything that reads a little past
+// the edge still sees the right thing
+class TextureAtlas final
+{
+public:
+    struct Region
+    {
+        // Where the texture starts in its page, not counting the border, and its size, in texels
+        int x{ 0 };
+        int y{ 0 };
+        int width{ 0 };
+        int height{ 0 };
+        int page{ 0 };
+        // Row of the palette table
+        int palette{ 0 };
+    };
+
+    // For shaders that sample with normalised coordinates instead of texels:
+    // page UV = fract( texture UV ) * scale + offset, on layer page
+    struct Remap
+    {
+        float offset[2];
+        float scale[2];
+        float page;
+        // The palette row as a texture coordinate
+        float palette;
+    };
+
+    // Returns which region the texture will end up in, nothing's packed until Build
+    int Add( const Texture& texture );
+
+    // Fails if a texture doesn't fit on a page even by itself
+    bool Build( const int& pageSize = 512, const int& padding = 4 );
+
+    bool Upload();
+    void Destroy();
+
+    // The pages as a sampler2DArray and the palette table as a sampler2D
+    void Bind( const GLenum& pageUnit, const GLenum& paletteUnit ) const;
+
+    const Region& GetRegion( const int& index ) const
+    {
+        return regions[index];
+    }
+
+    // One entry per region, in the same order
+    std::vector<Remap> GetRemapTable() const;
+
+    size_t GetNumRegions() const
+    {
+        return regions.size();
+    }
+
+    int GetNumPages() const
+    {
+        return numPages;
+    }
+
+    int GetNumPalettes() const
+    {
+        return int( palettes.size() );
+    }
+
+    int GetPageSize() const
+    {
+        return pageSize;
+    }
+
+    // How much of the pages is texture, as opposed to borders and empty space
+    float GetOccupancy() const;
+
+    bool IsUploaded() const
+    {
+        return pageTextureHandle != 0;
+    }
+
+private:
+    std::vector<Texture> textures;
+    std::vector<Region> regions;
+    std::vector<PaletteBuffer> palettes;
+    // Only kept until they're uploaded
+    std::vector<std::vector<uint8_t>> pages;
+    int pageSize{ 0 };
+    int numPages{ 0 };
+
+    GLuint pageTextureHandle{ 0 };
+    GLuint paletteTextureHandle{ 0 };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
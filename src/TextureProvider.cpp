@@ -1,10 +1,13 @@
 
 #include "TextureProvider.hpp"
+#include "TextureSwizzle.hpp"
+#include "Trace.hpp"
 
 #define STBI_ONLY_BMP 1
 #define STB_IMAGE_IMPLEMENTATION 1
 #include "stb_image.h"
 
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 
@@ -62,8 +65,45 @@ private:
 	uint32_t position{ 0 };
 };
 
+bool Texture::SetGuardBand( const int& guard )
+{
+	if ( guard > 0 && layout != TextureLayout::RowMajor )
+	{
+		printf( "Texture::SetGuardBand: only row-major textures can have one, this one's %s\n", TextureSwizzle::GetName( layout ) );
+		return false;
+	}
+
+	guardBand.Build( buffer.data(), width, height, guard );
+	return true;
+}
+
+bool Texture::Update( const uint32_t& x, const uint32_t& y, const uint32_t& w, const uint32_t& h, const uint8_t* texels )
+{
+	if ( x > width || y > height || w > width - x || h > height - y )
+	{
+		printf( "Texture::Update: %ux%u at %u,%u doesn't fit in %ux%u\n", w, h, x, y, width, height );
+		return false;
+	}
+
+	// Row offsets and column offsets, so it's the same loop in every layout
+	const TextureSampler sampler( buffer.data(), width, height, layout );
+	for ( uint32_t row = 0; row < h; row++ )
+	{
+		uint8_t* destination = buffer.data() + sampler.GetRowOffset( int( y + row ) );
+		for ( uint32_t column = 0; column < w; column++ )
+		{
+			destination[sampler.GetColumnOffset( int( x + column ) )] = texels[size_t( row ) * w + column];
+		}
+	}
+
+	guardBand.UpdateRows( buffer.data(), y, h );
+	return true;
+}
+
 Texture TextureProvider::LoadTextureFromFile( const char* path )
 {
+	TRACE_SCOPE( "TextureProvider::LoadTextureFromFile" );
+
 	FileReader file( path );
 
 	if ( !file )
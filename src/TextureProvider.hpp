@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include "GuardBand.hpp"
+
 #include <vector>
 #include <array>
 #include <cstdint>
@@ -9,6 +11,15 @@ using PaletteEntry = uint8_t[3];
 using PaletteBuffer = std::array<PaletteEntry, 256U>;
 using TextureBuffer = std::vector<unsigned char>;
 
+// The order texels are in, in a texture's buffer; see TextureSwizzle for the other two
+// Only the CPU kernels take anything but RowMajor, everything that uploads or goes row by row expects it
+enum class TextureLayout : uint8_t
+{
+    RowMajor,   // Rows bottom to top, like the BMP and glTexImage2D
+    Tiled,      // 8x8 tiles of 64 bytes, a cache line each, rows of tiles bottom to top
+    Morton      // Z-order, so texels close in 2D are close in memory too; power-of-two sizes only
+};
+
 class Texture final
 {
 public:
@@ -18,10 +29,12 @@ public:
         height = 0;
         buffer = {};
         palette = {};
+        layout = TextureLayout::RowMajor;
     }
 
-    Texture( const uint32_t& w, const uint32_t& h, const TextureBuffer& b, const PaletteBuffer& pb )
-        : width(w), height(h), buffer(b), palette(pb)
+    Texture( const uint32_t& w, const uint32_t& h, const TextureBuffer& b, const PaletteBuffer& pb,
+        const TextureLayout& l = TextureLayout::RowMajor )
+        : width(w), height(h), buffer(b), palette(pb), layout(l)
     {
         
     }
@@ -46,6 +59,25 @@ public:
         return palette;
     }
 
+    TextureLayout GetLayout() const
+    {
+        return layout;
+    }
+
+    // Keeps a copy of the texels with guard texels of wrap-around all round, for the CPU kernels
+    // Only RowMajor textures can have one; 0 drops it
+    bool SetGuardBand( const int& guard );
+
+    // Empty unless SetGuardBand gave it something
+    const GuardBand& GetGuardBand() const
+    {
+        return guardBand;
+    }
+
+    // Overwrites a w * h rectangle from texels, which are row by row whatever the texture's layout
+    // The guard band follows along
+    bool Update( const uint32_t& x, const uint32_t& y, const uint32_t& w, const uint32_t& h, const uint8_t* texels );
+
     operator bool() const
     {
         return width != 0;
@@ -56,6 +88,8 @@ private:
     uint32_t height;
     TextureBuffer buffer;
     PaletteBuffer palette;
+    TextureLayout layout;
+    GuardBand guardBand;
 };
 
 class TextureProvider final
@@ -0,0 +1,336 @@
+
+#include "TextureResidency.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <utility>
+
+constexpr uint32_t TextureResidency::TailSize;
+constexpr size_t TextureResidency::MaxUploadBytesPerFrame;
+
+namespace
+{
+	// R8 levels, plus the 256x1 RGB palette that's always there
+	constexpr size_t PaletteBytes = 256 * 3;
+}
+
+int TextureResidency::Add( const Texture& texture, std::vector<Texture> mips )
+{
+	Entry entry;
+	entry.levels.reserve( mips.size() + 1 );
+	entry.levels.push_back( texture );
+	for ( Texture& mip : mips )
+	{
+		entry.levels.push_back( std::move( mip ) );
+	}
+
+	// The first level that fits in TailSize, or the last one if none do
+	entry.tailLevel = int( entry.levels.size() ) - 1;
+	for ( size_t level = 0; level < entry.levels.size(); level++ )
+	{
+		if ( entry.levels[level].GetWidth() <= TailSize && entry.levels[level].GetHeight() <= TailSize )
+		{
+			entry.tailLevel = int( level );
+			break;
+		}
+	}
+	entry.baseLevel = entry.tailLevel;
+	entry.wantedLevel = entry.tailLevel;
+
+	for ( size_t level = 0; level < entry.levels.size(); level++ )
+	{
+		totalBytes += GetLevelBytes( entry, int( level ) );
+	}
+	totalBytes += PaletteBytes;
+
+	entries.push_back( std::move( entry ) );
+	return int( entries.size() - 1 );
+}
+
+bool TextureResidency::Upload( const size_t& budgetBytes )
+{
+	TRACE_SCOPE( "TextureResidency::Upload" );
+
+	budget = budgetBytes;
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+	for ( Entry& entry : entries )
+	{
+		glGenTextures( 1, &entry.textureHandle );
+		glBindTexture( GL_TEXTURE_2D, entry.textureHandle );
+
+		// Levels above the tail are left unspecified, they're below the base level so GL doesn't mind
+		for ( int level = entry.tailLevel; level < int( entry.levels.size() ); level++ )
+		{
+			const Texture& texture = entry.levels[level];
+			glTexImage2D( GL_TEXTURE_2D, level, GL_R8, texture.GetWidth(), texture.GetHeight(), 0,
+				GL_RED, GL_UNSIGNED_BYTE, texture.GetBuffer().data() );
+			residentBytes += GetLevelBytes( entry, level );
+		}
+
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.baseLevel );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, int( entry.levels.size() ) - 1 );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST );
+
+		const PaletteBuffer palette = entry.levels[0].GetPalette();
+		glGenTextures( 1, &entry.paletteHandle );
+		glBindTexture( GL_TEXTURE_2D, entry.paletteHandle );
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB8, 256, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, palette.data() );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+		residentBytes += PaletteBytes;
+	}
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+	if ( glGetError() != GL_NO_ERROR )
+	{
+		std::cout << "TextureResidency::Upload: couldn't create the textures" << std::endl;
+		return false;
+	}
+
+	printf( "TextureResidency::Upload: %i textures, %i KB resident to start with, %i KB with everything, %i KB budget\n",
+		int( entries.size() ), int( residentBytes / 1024 ), int( totalBytes / 1024 ), int( budget / 1024 ) );
+	return true;
+}
+
+void TextureResidency::Destroy()
+{
+	for ( Entry& entry : entries )
+	{
+		if ( entry.textureHandle )
+		{
+			glDeleteTextures( 1, &entry.textureHandle );
+			glDeleteTextures( 1, &entry.paletteHandle );
+		}
+
+		entry.textureHandle = 0;
+		entry.paletteHandle = 0;
+		entry.baseLevel = entry.tailLevel;
+	}
+
+	residentBytes = 0;
+}
+
+void TextureResidency::Request( const int& index, const int& wantedLevel )
+{
+	Entry& entry = entries[index];
+	const int level = std::max( 0, std::min( wantedLevel, entry.tailLevel ) );
+
+	// Several surfaces can share a texture, the closest one decides
+	if ( entry.lastRequested != frame || level < entry.wantedLevel )
+	{
+		entry.wantedLevel = level;
+	}
+	entry.lastRequested = frame;
+}
+
+void TextureResidency::Update( LinearArena& frameArena )
+{
+	TRACE_SCOPE( "TextureResidency::Update" );
+
+	// The budget may have gone down since last frame
+	while ( residentBytes > budget && EvictOne( true ) )
+	{
+	}
+
+	// Smallest first, so as many surfaces as possible get sharper as soon as possible,
+	// one level per texture per round so nobody jumps ahead by several
+	ArenaVector<int> streaming{ ArenaAllocator<int>( frameArena ) };
+	streaming.reserve( entries.size() );
+	size_t uploadedBytes = 0;
+	bool uploaded = true;
+	bool stoppedByLimit = false;
+	while ( uploaded && uploadedBytes < MaxUploadBytesPerFrame )
+	{
+		uploaded = false;
+
+		streaming.clear();
+		for ( size_t i = 0; i < entries.size(); i++ )
+		{
+			if ( entries[i].lastRequested == frame && entries[i].baseLevel > entries[i].wantedLevel )
+			{
+				streaming.push_back( int( i ) );
+			}
+		}
+
+		// Ties go by index, the same order stable_sort would give, without its temporary buffer
+		std::sort( streaming.begin(), streaming.end(), [this]( const int& a, const int& b )
+		{
+			const size_t aBytes = GetLevelBytes( entries[a], entries[a].baseLevel - 1 );
+			const size_t bBytes = GetLevelBytes( entries[b], entries[b].baseLevel - 1 );
+			return aBytes < bBytes || (aBytes == bBytes && a < b);
+		} );
+
+		for ( const int& index : streaming )
+		{
+			Entry& entry = entries[index];
+			const size_t bytes = GetLevelBytes( entry, entry.baseLevel - 1 );
+			if ( uploadedBytes + bytes > MaxUploadBytesPerFrame && uploadedBytes > 0 )
+			{
+				stoppedByLimit = true;
+				break;
+			}
+
+			// Only textures that aren't needed right now make room, otherwise two
+			// visible ones would keep taking each other's levels every frame
+			while ( residentBytes + bytes > budget && EvictOne( false ) )
+			{
+			}
+
+			// Everything after this is bigger, so it won't fit either
+			if ( residentBytes + bytes > budget )
+			{
+				break;
+			}
+
+			UploadLevel( entry );
+			uploadedBytes += bytes;
+			uploaded = true;
+		}
+	}
+
+	// Running out of things to upload or room to put them ends the loop on a round that
+	// didn't upload anything, so if the last one did, it was the limit that stopped it
+	// A round can also hit the limit on its very first entry and upload nothing, hence the flag
+	pendingUploads = uploaded || stoppedByLimit;
+	frame++;
+}
+
+int TextureResidency::Bind( const int& index, const GLenum& textureUnit, const GLenum& paletteUnit ) const
+{
+	const Entry& entry = entries[index];
+
+	glActiveTexture( textureUnit );
+	glBindTexture( GL_TEXTURE_2D, entry.textureHandle );
+	glActiveTexture( paletteUnit );
+	glBindTexture( GL_TEXTURE_2D, entry.paletteHandle );
+
+	return entry.baseLevel;
+}
+
+int TextureResidency::GetNumSatisfied() const
+{
+	int satisfied = 0;
+	for ( const Entry& entry : entries )
+	{
+		if ( entry.baseLevel <= entry.wantedLevel )
+		{
+			satisfied++;
+		}
+	}
+
+	return satisfied;
+}
+
+size_t TextureResidency::GetLevelBytes( const Entry& entry, const int& level )
+{
+	return size_t( entry.levels[level].GetWidth() ) * entry.levels[level].GetHeight();
+}
+
+void TextureResidency::UploadLevel( Entry& entry )
+{
+	const int level = entry.baseLevel - 1;
+	const Texture& texture = entry.levels[level];
+
+	glBindTexture( GL_TEXTURE_2D, entry.textureHandle );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	glTexImage2D( GL_TEXTURE_2D, level, GL_R8, texture.GetWidth(), texture.GetHeight(), 0,
+		GL_RED, GL_UNSIGNED_BYTE, texture.GetBuffer().data() );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level );
+
+	entry.baseLevel = level;
+	residentBytes += GetLevelBytes( entry, level );
+	numUploads++;
+}
+
+void TextureResidency::EvictLevel( Entry& entry )
+{
+	const int level = entry.baseLevel;
+
+	// Move the base first, so the level being dropped is never part of the texture
+	glBindTexture( GL_TEXTURE_2D, entry.textureHandle );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1 );
+	glTexImage2D( GL_TEXTURE_2D, level, GL_R8, 0, 0, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr );
+
+	entry.baseLevel = level + 1;
+	residentBytes -= GetLevelBytes( entry, level );
+	numEvictions++;
+}
+
+bool TextureResidency::EvictOne( const bool& needed )
+{
+	// In order of preference: textures nobody's asked for, the longest ago first,
+	// then levels finer than what was asked for, then, only if it's unavoidable,
+	// the finest level anything has
+	Entry* victim = nullptr;
+	int victimRank = 0;
+	uint64_t victimAge = 0;
+	for ( Entry& entry : entries )
+	{
+		if ( entry.baseLevel >= entry.tailLevel )
+		{
+			continue;
+		}
+
+		int rank = 0;
+		uint64_t age = frame - entry.lastRequested;
+		if ( entry.lastRequested == frame )
+		{
+			if ( entry.baseLevel < entry.wantedLevel )
+			{
+				rank = 1;
+			}
+			else if ( needed )
+			{
+				rank = 2;
+				// Biggest level first, that's the most room for the least damage
+				age = GetLevelBytes( entry, entry.baseLevel );
+			}
+			else
+			{
+				continue;
+			}
+		}
+
+		if ( victim == nullptr || rank < victimRank || (rank == victimRank && age > victimAge) )
+		{
+			victim = &entry;
+			victimRank = rank;
+			victimAge = age;
+		}
+	}
+
+	if ( victim == nullptr )
+	{
+		return false;
+	}
+
+	EvictLevel( *victim );
+	return true;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,151 @@
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include "TextureProvider.hpp"
+#include "Arena.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Keeps a set of indexed textures on the GPU within a memory budget
+// All the levels stay on the CPU, and only what's been asked for gets uploaded: every
+// frame, visible surfaces say which level they'd like, the missing levels get streamed in
+// smallest first, and when there's no room, levels of textures that haven't been seen in
+// the longest time are thrown out, finest first
+//
+// Textures are mutable GL textures, so a level is uploaded with glTexImage2D and freed by
+// respecifying it as 0x0. GL_TEXTURE_BASE_LEVEL points at the finest one that's there,
+// and since texelFetch counts levels from the base, Bind hands that back for the shader
+class TextureResidency final
+{
+public:
+    // Levels this size and smaller go up right away and never leave, so there's always
+    // something to draw with, however tight the budget is
+    static constexpr uint32_t TailSize = 16;
+    // Streaming stops for the frame after this much, so turning around doesn't stall a frame
+    static constexpr size_t MaxUploadBytesPerFrame = 64 * 1024;
+
+    // mips are levels 1 and down, as PaletteMips::Build gives them
+    // Returns the index to Request and Bind it by
+    int Add( const Texture& texture, std::vector<Texture> mips );
+
+    // Creates the textures with just their tails
+    bool Upload( const size_t& budgetBytes );
+    void Destroy();
+
+    // A lower budget takes effect on the next Update
+    void SetBudget( const size_t& bytes )
+    {
+        budget = bytes;
+    }
+
+    // Something visible uses this texture this frame, and looks fine down to wantedLevel
+    void Request( const int& index, const int& wantedLevel );
+
+    // Once per frame, after the Requests and before drawing
+    // Gets back under budget, then streams in what was asked for
+    // Its bookkeeping goes in frameArena, so that has to last until the end of the call
+    void Update( LinearArena& frameArena );
+
+    // Binds the texture and its palette, and returns the finest level that's resident
+    int Bind( const int& index, const GLenum& textureUnit, const GLenum& paletteUnit ) const;
+
+    size_t GetNumTextures() const
+    {
+        return entries.size();
+    }
+
+    // Textures that have every level the last Requests asked for
+    int GetNumSatisfied() const;
+
+    size_t GetResidentBytes() const
+    {
+        return residentBytes;
+    }
+
+    // What it would take to have everything fully resident
+    size_t GetTotalBytes() const
+    {
+        return totalBytes;
+    }
+
+    size_t GetBudget() const
+    {
+        return budget;
+    }
+
+    // Levels uploaded and evicted since the start
+    int GetNumUploads() const
+    {
+        return numUploads;
+    }
+
+    int GetNumEvictions() const
+    {
+        return numEvictions;
+    }
+
+    // The last Update hit the per-frame limit and has more to upload next frame
+    bool HasPendingUploads() const
+    {
+        return pendingUploads;
+    }
+
+private:
+    struct Entry
+    {
+        // Level 0 first
+        std::vector<Texture> levels;
+        GLuint textureHandle{ 0 };
+        GLuint paletteHandle{ 0 };
+        // The finest level that's resident, and the first one that always is
+        int baseLevel{ 0 };
+        int tailLevel{ 0 };
+        // What the last Request asked for, and which frame that was in
+        int wantedLevel{ 0 };
+        uint64_t lastRequested{ 0 };
+    };
+
+    static size_t GetLevelBytes( const Entry& entry, const int& level );
+
+    void UploadLevel( Entry& entry );
+    void EvictLevel( Entry& entry );
+
+    // Evicts a level from whichever texture can best spare one
+    // Textures that are needed this frame only lose levels if needed is true
+    bool EvictOne( const bool& needed );
+
+private:
+    std::vector<Entry> entries;
+    size_t budget{ 0 };
+    size_t residentBytes{ 0 };
+    size_t totalBytes{ 0 };
+    // Starts at 1 so nothing counts as requested before the first frame
+    uint64_t frame{ 1 };
+    int numUploads{ 0 };
+    int numEvictions{ 0 };
+    bool pendingUploads{ false };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,293 @@
+
+#include "TextureSwizzle.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 2)
+#define SWATER_SSE2 1
+#include <emmintrin.h>
+#else
+#define SWATER_SSE2 0
+#endif
+
+constexpr int TextureSwizzle::BlockSize;
+
+namespace
+{
+	bool IsPowerOfTwo( const uint32_t& value )
+	{
+		return value != 0 && (value & (value - 1)) == 0;
+	}
+
+#if SWATER_SSE2
+	__m128i LoadRow( const uint8_t* row )
+	{
+		return _mm_loadl_epi64( reinterpret_cast<const __m128i*>( row ) );
+	}
+
+	void StoreRows( uint8_t* row, const size_t& stride, const __m128i& rows )
+	{
+		_mm_storel_epi64( reinterpret_cast<__m128i*>( row ), rows );
+		_mm_storel_epi64( reinterpret_cast<__m128i*>( row + stride ), _mm_unpackhi_epi64( rows, rows ) );
+	}
+
+	void SwizzleBlock( const uint8_t* source, const size_t& stride, const TextureLayout& layout, uint8_t* block )
+	{
+		__m128i rows[8];
+		for ( int y = 0; y < 8; y++ )
+		{
+			rows[y] = LoadRow( source + y * stride );
+		}
+
+		__m128i* out = reinterpret_cast<__m128i*>( block );
+		if ( layout == TextureLayout::Tiled )
+		{
+			for ( int i = 0; i < 4; i++ )
+			{
+				_mm_storeu_si128( out + i, _mm_unpacklo_epi64( rows[i * 2], rows[i * 2 + 1] ) );
+			}
+			return;
+		}
+
+		// Interleaving two rows 16 bits at a time gives the 2x2 quads Morton order starts with,
+		// four of them along, and two pairs of rows make four 4x4 quads
+		for ( int half = 0; half < 2; half++ )
+		{
+			const __m128i rows01 = _mm_unpacklo_epi16( rows[half * 4], rows[half * 4 + 1] );
+			const __m128i rows23 = _mm_unpacklo_epi16( rows[half * 4 + 2], rows[half * 4 + 3] );
+			_mm_storeu_si128( out + half * 2, _mm_unpacklo_epi64( rows01, rows23 ) );
+			_mm_storeu_si128( out + half * 2 + 1, _mm_unpackhi_epi64( rows01, rows23 ) );
+		}
+	}
+
+	void UnswizzleBlock( const uint8_t* block, const TextureLayout& layout, const size_t& stride, uint8_t* destination )
+	{
+		const __m128i* in = reinterpret_cast<const __m128i*>( block );
+		if ( layout == TextureLayout::Tiled )
+		{
+			for ( int i = 0; i < 4; i++ )
+			{
+				StoreRows( destination + i * 2 * stride, stride, _mm_loadu_si128( in + i ) );
+			}
+			return;
+		}
+
+		// Backwards from SwizzleBlock: put the quads of two rows back next to each other,
+		// then pull the two rows' 16-bit halves apart
+		for ( int half = 0; half < 2; half++ )
+		{
+			const __m128i left = _mm_loadu_si128( in + half * 2 );
+			const __m128i right = _mm_loadu_si128( in + half * 2 + 1 );
+			for ( int pair = 0; pair < 2; pair++ )
+			{
+				__m128i rows = pair == 0 ? _mm_unpacklo_epi64( left, right ) : _mm_unpackhi_epi64( left, right );
+				rows = _mm_shufflelo_epi16( rows, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+				rows = _mm_shufflehi_epi16( rows, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+				rows = _mm_shuffle_epi32( rows, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+				StoreRows( destination + (half * 4 + pair * 2) * stride, stride, rows );
+			}
+		}
+	}
+#else
+	// Where texel (x, y) of an 8x8 block goes inside its 64 bytes
+	uint32_t BlockOffset( const TextureLayout& layout, const int& x, const int& y )
+	{
+		if ( layout == TextureLayout::Morton )
+		{
+			return TextureSampler::SpreadBits( uint32_t( x ) ) | (TextureSampler::SpreadBits( uint32_t( y ) ) << 1);
+		}
+
+		return uint32_t( y * TextureSwizzle::BlockSize + x );
+	}
+
+	// One block, from rows that are stride bytes apart to 64 contiguous bytes, or back
+	void SwizzleBlock( const uint8_t* source, const size_t& stride, const TextureLayout& layout, uint8_t* block )
+	{
+		for ( int y = 0; y < TextureSwizzle::BlockSize; y++ )
+		{
+			for ( int x = 0; x < TextureSwizzle::BlockSize; x++ )
+			{
+				block[BlockOffset( layout, x, y )] = source[y * stride + x];
+			}
+		}
+	}
+
+	void UnswizzleBlock( const uint8_t* block, const TextureLayout& layout, const size_t& stride, uint8_t* destination )
+	{
+		for ( int y = 0; y < TextureSwizzle::BlockSize; y++ )
+		{
+			for ( int x = 0; x < TextureSwizzle::BlockSize; x++ )
+			{
+				destination[y * stride + x] = block[BlockOffset( layout, x, y )];
+			}
+		}
+	}
+#endif
+}
+
+bool TextureSwizzle::Supports( const TextureLayout& layout, const uint32_t& width, const uint32_t& height )
+{
+	switch ( layout )
+	{
+	case TextureLayout::Tiled:
+		return width >= BlockSize && height >= BlockSize && width % BlockSize == 0 && height % BlockSize == 0;
+	case TextureLayout::Morton:
+		return width >= BlockSize && height >= BlockSize && IsPowerOfTwo( width ) && IsPowerOfTwo( height );
+	default:
+		return true;
+	}
+}
+
+Texture TextureSwizzle::Convert( const Texture& texture, const TextureLayout& layout )
+{
+	if ( texture.GetLayout() == layout )
+	{
+		return texture;
+	}
+
+	const uint32_t width = texture.GetWidth();
+	const uint32_t height = texture.GetHeight();
+	if ( !Supports( layout, width, height ) )
+	{
+		printf( "TextureSwizzle::Convert: a %ux%u texture can't be %s\n", width, height, GetName( layout ) );
+		return Texture();
+	}
+
+	// Anything that isn't row-major goes through row-major first
+	TextureBuffer rowMajor;
+	const uint8_t* source = texture.GetBuffer().data();
+	if ( texture.GetLayout() != TextureLayout::RowMajor )
+	{
+		rowMajor.resize( size_t( width ) * height );
+		Unswizzle( source, width, height, texture.GetLayout(), rowMajor.data() );
+		source = rowMajor.data();
+	}
+
+	TextureBuffer buffer( size_t( width ) * height );
+	if ( layout == TextureLayout::RowMajor )
+	{
+		memcpy( buffer.data(), source, buffer.size() );
+	}
+	else
+	{
+		Swizzle( source, width, height, layout, buffer.data() );
+	}
+
+	return Texture( width, height, buffer, texture.GetPalette(), layout );
+}
+
+void TextureSwizzle::Swizzle( const uint8_t* rowMajor, const uint32_t& width, const uint32_t& height,
+	const TextureLayout& layout, uint8_t* outTexels )
+{
+	if ( layout == TextureLayout::RowMajor )
+	{
+		memcpy( outTexels, rowMajor, size_t( width ) * height );
+		return;
+	}
+
+	// Blocks are contiguous in both layouts, so only where each one starts depends on the layout
+	const TextureSampler sampler( outTexels, width, height, layout );
+	for ( uint32_t y = 0; y < height; y += BlockSize )
+	{
+		const uint32_t rowOffset = sampler.GetRowOffset( int( y ) );
+		for ( uint32_t x = 0; x < width; x += BlockSize )
+		{
+			const uint8_t* source = rowMajor + size_t( y ) * width + x;
+			uint8_t* block = outTexels + rowOffset + sampler.GetColumnOffset( int( x ) );
+			SwizzleBlock( source, width, layout, block );
+		}
+	}
+}
+
+void TextureSwizzle::Unswizzle( const uint8_t* texels, const uint32_t& width, const uint32_t& height,
+	const TextureLayout& layout, uint8_t* outRowMajor )
+{
+	if ( layout == TextureLayout::RowMajor )
+	{
+		memcpy( outRowMajor, texels, size_t( width ) * height );
+		return;
+	}
+
+	const TextureSampler sampler( texels, width, height, layout );
+	for ( uint32_t y = 0; y < height; y += BlockSize )
+	{
+		const uint32_t rowOffset = sampler.GetRowOffset( int( y ) );
+		for ( uint32_t x = 0; x < width; x += BlockSize )
+		{
+			const uint8_t* block = texels + rowOffset + sampler.GetColumnOffset( int( x ) );
+			uint8_t* destination = outRowMajor + size_t( y ) * width + x;
+			UnswizzleBlock( block, layout, width, destination );
+		}
+	}
+}
+
+const char* TextureSwizzle::GetName( const TextureLayout& layout )
+{
+	switch ( layout )
+	{
+	case TextureLayout::Tiled:
+		return "tiled";
+	case TextureLayout::Morton:
+		return "morton";
+	default:
+		return "row-major";
+	}
+}
+
+bool TextureSwizzle::FromName( const char* name, TextureLayout& outLayout )
+{
+	for ( const TextureLayout layout : { TextureLayout::RowMajor, TextureLayout::Tiled, TextureLayout::Morton } )
+	{
+		if ( !strcmp( name, GetName( layout ) ) )
+		{
+			outLayout = layout;
+			return true;
+		}
+	}
+
+	std::cout << "TextureSwizzle::FromName: unknown layout '" << name << "', it's row-major, tiled or morton" << std::endl;
+	return false;
+}
+
+TextureSampler::TextureSampler( const Texture& texture )
+	: TextureSampler( texture.GetBuffer().data(), texture.GetWidth(), texture.GetHeight(), texture.GetLayout() )
+{
+}
+
+TextureSampler::TextureSampler( const uint8_t* texels, const uint32_t& width, const uint32_t& height, const TextureLayout& layout )
+	: texels( texels ), width( int( width ) ), height( int( height ) ), layout( layout )
+{
+	if ( layout == TextureLayout::Morton )
+	{
+		const uint32_t side = std::min( width, height );
+		while ( (1U << squareBits) < side )
+		{
+			squareBits++;
+		}
+
+		squareMask = side - 1;
+		squaresAcross = width >> squareBits;
+	}
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,147 @@
+
+#pragma once
+
+#include "TextureProvider.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Reorders indexed textures from one TextureLayout to another
+//
+// Row-major is what everything loads and uploads, but walking it downwards goes a whole row
+// further with every texel, so a texture bigger than the cache gets a miss per texel that way.
+// In the Tiled and Morton layouts, a texel's vertical neighbours are a few bytes away instead,
+// and the price is that rows aren't contiguous any more, so kernels go through TextureSampler
+//
+// Both layouts are made of 8x8 blocks that are 64 contiguous bytes, so converting goes
+// a block at a time, and with SSE2 each block is a handful of loads, unpacks and stores
+class TextureSwizzle final
+{
+public:
+    static constexpr int BlockSize = 8;
+
+    // Tiled needs sides that are multiples of 8, Morton powers of two of at least 8
+    static bool Supports( const TextureLayout& layout, const uint32_t& width, const uint32_t& height );
+
+    // The same texture in another layout, or an empty one if it's a size that layout can't do
+    static Texture Convert( const Texture& texture, const TextureLayout& layout );
+
+    // Row-major into layout and back, width * height bytes, in and out can't overlap
+    static void Swizzle( const uint8_t* rowMajor, const uint32_t& width, const uint32_t& height,
+        const TextureLayout& layout, uint8_t* outTexels );
+    static void Unswizzle( const uint8_t* texels, const uint32_t& width, const uint32_t& height,
+        const TextureLayout& layout, uint8_t* outRowMajor );
+
+    // "row-major", "tiled" and "morton"
+    static const char* GetName( const TextureLayout& layout );
+    static bool FromName( const char* name, TextureLayout& outLayout );
+};
+
+// Finds texels in a buffer, whatever its layout
+// In all three, a texel's offset is a part that only depends on x plus a part that only
+// depends on y, so kernels can work out their columns once and each row once, like
+// SoftwareWater does, and then every fetch is a single add
+class TextureSampler final
+{
+public:
+    // The texture has to outlive the sampler
+    explicit TextureSampler( const Texture& texture );
+    TextureSampler( const uint8_t* texels, const uint32_t& width, const uint32_t& height, const TextureLayout& layout );
+
+    // x in [0, width)
+    uint32_t GetColumnOffset( const int& x ) const
+    {
+        switch ( layout )
+        {
+        case TextureLayout::Tiled:
+            return (uint32_t( x >> 3 ) << 6) + uint32_t( x & 7 );
+        case TextureLayout::Morton:
+            return SpreadBits( uint32_t( x ) & squareMask ) + (uint32_t( x >> squareBits ) << (squareBits * 2));
+        default:
+            return uint32_t( x );
+        }
+    }
+
+    // y in [0, height)
+    uint32_t GetRowOffset( const int& y ) const
+    {
+        switch ( layout )
+        {
+        case TextureLayout::Tiled:
+            return uint32_t( y >> 3 ) * uint32_t( width * 8 ) + (uint32_t( y & 7 ) << 3);
+        case TextureLayout::Morton:
+            return (SpreadBits( uint32_t( y ) & squareMask ) << 1) + ((uint32_t( y >> squareBits ) * squaresAcross) << (squareBits * 2));
+        default:
+            return uint32_t( y ) * uint32_t( width );
+        }
+    }
+
+    // Wraps like GL_REPEAT, negative coordinates included
+    uint8_t Fetch( const int& x, const int& y ) const
+    {
+        return texels[GetColumnOffset( Wrap( x, width ) ) + GetRowOffset( Wrap( y, height ) )];
+    }
+
+    const uint8_t* GetTexels() const
+    {
+        return texels;
+    }
+
+    int GetWidth() const
+    {
+        return width;
+    }
+
+    int GetHeight() const
+    {
+        return height;
+    }
+
+    static int Wrap( const int& coord, const int& size )
+    {
+        const int result = coord % size;
+        return result < 0 ? result + size : result;
+    }
+
+    // The low 16 bits of value, moved to the even bits
+    static uint32_t SpreadBits( uint32_t value )
+    {
+        value &= 0xFFFFU;
+        value = (value | (value << 8)) & 0x00FF00FFU;
+        value = (value | (value << 4)) & 0x0F0F0F0FU;
+        value = (value | (value << 2)) & 0x33333333U;
+        value = (value | (value << 1)) & 0x55555555U;
+        return value;
+    }
+
+private:
+    const uint8_t* texels;
+    int width;
+    int height;
+    TextureLayout layout;
+
+    // Morton only: squares as big as the shorter side are Z-ordered, and
+    // a non-square texture is a row or column of those
+    int squareBits{ 0 };
+    uint32_t squareMask{ 0 };
+    uint32_t squaresAcross{ 0 };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
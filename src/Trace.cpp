@@ -0,0 +1,158 @@
+
+#include "Trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace Trace
+{
+	namespace
+	{
+		// 64k events per thread, a bit over a megabyte and a half
+		// Once it's full, the oldest events get overwritten
+		constexpr uint32_t BufferCapacity = 1U << 16U;
+		// The exporter skips this many of the oldest events, since the owning
+		// thread might be overwriting them while we read
+		constexpr uint32_t ExportSafetyMargin = BufferCapacity / 8U;
+
+		struct ThreadBuffer
+		{
+			uint32_t threadId{ 0 };
+			char name[32]{};
+
+			// Only ever incremented by the owning thread
+			std::atomic<uint32_t> head{ 0 };
+			Event events[BufferCapacity];
+		};
+
+		// Buffers are never freed, so threads that have exited still show up in the trace
+		std::mutex buffersMutex;
+		std::vector<ThreadBuffer*> buffers;
+
+		thread_local ThreadBuffer* threadBuffer{ nullptr };
+
+		ThreadBuffer& GetThreadBuffer()
+		{
+			if ( threadBuffer == nullptr )
+			{
+				// Only happens once per thread, so the lock is fine here
+				std::lock_guard<std::mutex> lock( buffersMutex );
+				threadBuffer = new ThreadBuffer();
+				threadBuffer->threadId = uint32_t( buffers.size() + 1U );
+				snprintf( threadBuffer->name, sizeof( threadBuffer->name ), "Thread %u", threadBuffer->threadId );
+				buffers.push_back( threadBuffer );
+			}
+
+			return *threadBuffer;
+		}
+
+		const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+		void WriteEscaped( FILE* file, const char* string )
+		{
+			for ( ; *string; string++ )
+			{
+				if ( *string == '"' || *string == '\\' )
+				{
+					fputc( '\\', file );
+				}
+				fputc( *string, file );
+			}
+		}
+	}
+
+	int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - epoch ).count();
+	}
+
+	void Record( const char* name, const int64_t& start, const int64_t& end )
+	{
+		ThreadBuffer& buffer = GetThreadBuffer();
+
+		const uint32_t head = buffer.head.load( std::memory_order_relaxed );
+		buffer.events[head % BufferCapacity] = { name, start, end - start };
+		// Publish the event, the exporter reads head with acquire
+		buffer.head.store( head + 1U, std::memory_order_release );
+	}
+
+	void SetThreadName( const char* name )
+	{
+		ThreadBuffer& buffer = GetThreadBuffer();
+
+		std::lock_guard<std::mutex> lock( buffersMutex );
+		strncpy( buffer.name, name, sizeof( buffer.name ) - 1U );
+	}
+
+	bool Export( const char* path )
+	{
+		FILE* file = fopen( path, "wb" );
+		if ( file == nullptr )
+		{
+			std::cout << "Trace::Export: could not open '" << path << "' for writing" << std::endl;
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock( buffersMutex );
+
+		fputs( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file );
+
+		bool first = true;
+		size_t numEvents = 0U;
+		for ( const ThreadBuffer* buffer : buffers )
+		{
+			fprintf( file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+				first ? "" : ",\n", buffer->threadId );
+			WriteEscaped( file, buffer->name );
+			fputs( "\"}}", file );
+			first = false;
+
+			const uint32_t head = buffer->head.load( std::memory_order_acquire );
+			const uint32_t available = head < BufferCapacity ? head : BufferCapacity - ExportSafetyMargin;
+
+			for ( uint32_t i = head - available; i != head; i++ )
+			{
+				const Event& event = buffer->events[i % BufferCapacity];
+
+				// Chrome wants microseconds, fractions are allowed
+				fputs( ",\n{\"ph\":\"X\",\"name\":\"", file );
+				WriteEscaped( file, event.name );
+				fprintf( file, "\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					buffer->threadId, event.startNanoseconds / 1000.0, event.durationNanoseconds / 1000.0 );
+			}
+
+			numEvents += available;
+		}
+
+		fputs( "\n]}\n", file );
+		fclose( file );
+
+		std::cout << "Trace::Export: wrote " << numEvents << " events from "
+			<< buffers.size() << " thread(s) to '" << path << "'" << std::endl;
+		return true;
+	}
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
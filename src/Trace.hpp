@@ -0,0 +1,85 @@
+
+#pragma once
+
+#include <cstdint>
+
+// A tiny instrumentation layer that records scopes per thread and writes them out
+// as Chrome trace JSON, which chrome://tracing and ui.perfetto.dev can open
+//
+// Every thread gets its own ring of events the first time it records something,
+// and only that thread ever writes to it, so recording is a couple of stores and no locks
+// Build with SWATER_TRACING=0 and all of the macros below compile to nothing
+#ifndef SWATER_TRACING
+#define SWATER_TRACING 1
+#endif
+
+namespace Trace
+{
+    struct Event
+    {
+        // Must be a string literal or otherwise outlive the trace
+        const char* name;
+        int64_t startNanoseconds;
+        int64_t durationNanoseconds;
+    };
+
+    // Nanoseconds since the first call
+    int64_t Now();
+
+    void Record( const char* name, const int64_t& start, const int64_t& end );
+
+    // Shows up as the thread's name in the trace viewer
+    void SetThreadName( const char* name );
+
+    // Writes everything recorded so far, returns false if the file couldn't be written
+    // Events that are being recorded while this runs might end up cut off, which is fine for a profiler
+    bool Export( const char* path );
+
+    class Scope final
+    {
+    public:
+        Scope( const char* scopeName )
+            : name( scopeName ), start( Now() )
+        {
+        }
+
+        ~Scope()
+        {
+            Record( name, start, Now() );
+        }
+
+    private:
+        const char* name;
+        int64_t start;
+    };
+}
+
+#define TRACE_CONCAT_INNER( a, b ) a##b
+#define TRACE_CONCAT( a, b ) TRACE_CONCAT_INNER( a, b )
+
+#if SWATER_TRACING
+#define TRACE_SCOPE( name ) Trace::Scope TRACE_CONCAT( traceScope, __LINE__ )( name )
+#define TRACE_THREAD_NAME( name ) Trace::SetThreadName( name )
+#else
+#define TRACE_SCOPE( name ) ((void)0)
+#define TRACE_THREAD_NAME( name ) ((void)0)
+#endif
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
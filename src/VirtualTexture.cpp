@@ -0,0 +1,596 @@
+
+#include "VirtualTexture.hpp"
+#include "PaletteMips.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+constexpr int VirtualTexture::PageSize;
+constexpr int VirtualTexture::CacheSlots;
+constexpr int VirtualTexture::FeedbackScale;
+constexpr int VirtualTexture::RingSize;
+constexpr int VirtualTexture::MaxUploadsPerFrame;
+constexpr uint32_t VirtualTexture::KeepFrames;
+
+namespace
+{
+	// Page files start with the magic and version, then width, height, page size, pages across
+	// and pages down, all little-endian, then the palette as RGB. The pages follow, row by row
+	// from the bottom left, and last there's the average index of every page, in the same order
+	constexpr char Magic[4] = { 'S', 'W', 'V', 'T' };
+	constexpr uint32_t Version = 1;
+	constexpr size_t HeaderSize = sizeof( Magic ) + 6 * sizeof( uint32_t ) + 256 * 3;
+	constexpr size_t PageBytes = size_t( VirtualTexture::PageSize ) * VirtualTexture::PageSize;
+
+	uint16_t ReadU16( const uint8_t* bytes )
+	{
+		return uint16_t( bytes[0] | (bytes[1] << 8) );
+	}
+
+	uint32_t ReadU32( const uint8_t* bytes )
+	{
+		return uint32_t( bytes[0] ) | (uint32_t( bytes[1] ) << 8) | (uint32_t( bytes[2] ) << 16) | (uint32_t( bytes[3] ) << 24);
+	}
+
+	void WriteU32( std::ofstream& out, const uint32_t& value )
+	{
+		const uint8_t bytes[4] = { uint8_t( value ), uint8_t( value >> 8 ), uint8_t( value >> 16 ), uint8_t( value >> 24 ) };
+		out.write( reinterpret_cast<const char*>( bytes ), sizeof( bytes ) );
+	}
+}
+
+bool VirtualTexture::Convert( const char* bmpPath, const char* pagePath )
+{
+	TRACE_SCOPE( "VirtualTexture::Convert" );
+	const auto start = std::chrono::steady_clock::now();
+
+	std::ifstream bmp( bmpPath, std::ifstream::binary );
+	if ( !bmp )
+	{
+		std::cout << "VirtualTexture::Convert: could not open '" << bmpPath << "'" << std::endl;
+		return false;
+	}
+
+	uint8_t header[54]{};
+	if ( !bmp.read( reinterpret_cast<char*>( header ), sizeof( header ) ) || header[0] != 'B' || header[1] != 'M' )
+	{
+		std::cout << "VirtualTexture::Convert: '" << bmpPath << "' isn't a BMP" << std::endl;
+		return false;
+	}
+
+	const uint32_t dataOffset = ReadU32( header + 10 );
+	const uint32_t infoSize = ReadU32( header + 14 );
+	const int32_t fileWidth = int32_t( ReadU32( header + 18 ) );
+	const int32_t fileHeight = int32_t( ReadU32( header + 22 ) );
+	const uint16_t bitsPerPixel = ReadU16( header + 28 );
+	const uint32_t compression = ReadU32( header + 30 );
+	const uint32_t coloursUsed = ReadU32( header + 46 );
+
+	// Rows go bottom to top, like the texture's, unless the height is negative
+	const bool topDown = fileHeight < 0;
+	const int64_t imageWidth = fileWidth;
+	const int64_t imageHeight = topDown ? -int64_t( fileHeight ) : int64_t( fileHeight );
+
+	// Anything smaller fits in a texture just fine, and the shader's wrap
+	// needs the texture to be bigger than the ripples' offsets anyway
+	if ( bitsPerPixel != 8 || compression != 0 || imageWidth < PageSize || imageHeight < PageSize )
+	{
+		std::cout << "VirtualTexture::Convert: '" << bmpPath << "' has to be an uncompressed 8-bit BMP, at least "
+			<< PageSize << " texels each way" << std::endl;
+		return false;
+	}
+
+	PaletteBuffer palette{};
+	{
+		const uint32_t numColours = (coloursUsed == 0 || coloursUsed > 256) ? 256 : coloursUsed;
+		uint8_t entries[256 * 4]{};
+		bmp.seekg( std::streamoff( 14 ) + infoSize );
+		if ( !bmp.read( reinterpret_cast<char*>( entries ), numColours * 4 ) )
+		{
+			std::cout << "VirtualTexture::Convert: the palette of '" << bmpPath << "' is cut short" << std::endl;
+			return false;
+		}
+
+		// BGRA in the file
+		for ( uint32_t i = 0; i < numColours; i++ )
+		{
+			palette[i][0] = entries[i * 4 + 2];
+			palette[i][1] = entries[i * 4 + 1];
+			palette[i][2] = entries[i * 4];
+		}
+	}
+
+	std::ofstream out( pagePath, std::ofstream::binary );
+	if ( !out )
+	{
+		std::cout << "VirtualTexture::Convert: could not open '" << pagePath << "' for writing" << std::endl;
+		return false;
+	}
+
+	const int numPagesX = int( (imageWidth + PageSize - 1) / PageSize );
+	const int numPagesY = int( (imageHeight + PageSize - 1) / PageSize );
+
+	out.write( Magic, sizeof( Magic ) );
+	WriteU32( out, Version );
+	WriteU32( out, uint32_t( imageWidth ) );
+	WriteU32( out, uint32_t( imageHeight ) );
+	WriteU32( out, PageSize );
+	WriteU32( out, uint32_t( numPagesX ) );
+	WriteU32( out, uint32_t( numPagesY ) );
+	out.write( reinterpret_cast<const char*>( palette.data() ), 256 * 3 );
+
+	// A row of pages at a time, so only PageSize rows of the image are ever in memory
+	// Past the right and top edges stays 0, the shader wraps before it gets there
+	const int64_t rowStride = (imageWidth + 3) & ~int64_t( 3 );
+	const size_t bandWidth = size_t( numPagesX ) * PageSize;
+	std::vector<uint8_t> band( bandWidth * PageSize );
+	std::vector<uint8_t> page( PageBytes );
+	// Colour sums for the averages, and which indices are used at all, so
+	// the averages don't land on one that isn't, like PaletteMips does
+	std::vector<uint32_t> sums( size_t( numPagesX ) * numPagesY * 3 );
+	std::array<bool, 256U> usable{};
+
+	for ( int pageY = 0; pageY < numPagesY; pageY++ )
+	{
+		std::fill( band.begin(), band.end(), uint8_t( 0 ) );
+
+		const int64_t firstRow = int64_t( pageY ) * PageSize;
+		const int rows = int( std::min<int64_t>( PageSize, imageHeight - firstRow ) );
+		for ( int row = 0; row < rows; row++ )
+		{
+			const int64_t fileRow = topDown ? imageHeight - 1 - (firstRow + row) : firstRow + row;
+			bmp.seekg( std::streamoff( dataOffset ) + fileRow * rowStride );
+			if ( !bmp.read( reinterpret_cast<char*>( &band[size_t( row ) * bandWidth] ), imageWidth ) )
+			{
+				std::cout << "VirtualTexture::Convert: '" << bmpPath << "' is cut short" << std::endl;
+				return false;
+			}
+		}
+
+		for ( int pageX = 0; pageX < numPagesX; pageX++ )
+		{
+			const int columns = int( std::min<int64_t>( PageSize, imageWidth - int64_t( pageX ) * PageSize ) );
+			uint32_t* sum = &sums[(size_t( pageY ) * numPagesX + pageX) * 3];
+
+			for ( int y = 0; y < PageSize; y++ )
+			{
+				const uint8_t* source = &band[size_t( y ) * bandWidth + size_t( pageX ) * PageSize];
+				std::copy( source, source + PageSize, &page[size_t( y ) * PageSize] );
+
+				for ( int x = 0; y < rows && x < columns; x++ )
+				{
+					const PaletteEntry& colour = palette[source[x]];
+					usable[source[x]] = true;
+					sum[0] += colour[0];
+					sum[1] += colour[1];
+					sum[2] += colour[2];
+				}
+			}
+
+			out.write( reinterpret_cast<const char*>( page.data() ), std::streamsize( page.size() ) );
+		}
+	}
+
+	const std::shared_ptr<const PaletteLookup> lookup = PaletteLookup::Get( palette, usable );
+	std::vector<uint8_t> averages( size_t( numPagesX ) * numPagesY );
+	for ( int pageY = 0; pageY < numPagesY; pageY++ )
+	{
+		for ( int pageX = 0; pageX < numPagesX; pageX++ )
+		{
+			const int64_t texels = std::min<int64_t>( PageSize, imageWidth - int64_t( pageX ) * PageSize )
+				* std::min<int64_t>( PageSize, imageHeight - int64_t( pageY ) * PageSize );
+			const size_t index = size_t( pageY ) * numPagesX + pageX;
+			const uint32_t* sum = &sums[index * 3];
+			averages[index] = lookup->Find( uint8_t( sum[0] / texels ), uint8_t( sum[1] / texels ), uint8_t( sum[2] / texels ) );
+		}
+	}
+	out.write( reinterpret_cast<const char*>( averages.data() ), std::streamsize( averages.size() ) );
+
+	out.close();
+	if ( !out )
+	{
+		std::cout << "VirtualTexture::Convert: could not write all of '" << pagePath << "'" << std::endl;
+		return false;
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	printf( "VirtualTexture::Convert: %lldx%lld into %ix%i pages of %i, %.1f MB in '%s', took %.2f s\n",
+		(long long)imageWidth, (long long)imageHeight, numPagesX, numPagesY, PageSize,
+		double( HeaderSize + averages.size() * (PageBytes + 1) ) / (1024.0 * 1024.0), pagePath, elapsed.count() );
+	return true;
+}
+
+bool VirtualTexture::Open( const char* pagePath, const int& screenWidth, const int& screenHeight )
+{
+	TRACE_SCOPE( "VirtualTexture::Open" );
+
+	path = pagePath;
+	file.open( pagePath, std::ifstream::binary );
+	if ( !file )
+	{
+		std::cout << "VirtualTexture::Open: could not open '" << pagePath << "', --make-virtual makes one" << std::endl;
+		return false;
+	}
+
+	uint8_t header[HeaderSize]{};
+	if ( !file.read( reinterpret_cast<char*>( header ), sizeof( header ) ) || memcmp( header, Magic, sizeof( Magic ) )
+		|| ReadU32( header + 4 ) != Version )
+	{
+		std::cout << "VirtualTexture::Open: '" << pagePath << "' isn't a page file, or it's from an older version" << std::endl;
+		return false;
+	}
+
+	width = ReadU32( header + 8 );
+	height = ReadU32( header + 12 );
+	const int pageSize = int( ReadU32( header + 16 ) );
+	pagesX = int( ReadU32( header + 20 ) );
+	pagesY = int( ReadU32( header + 24 ) );
+	memcpy( palette.data(), header + 28, 256 * 3 );
+
+	if ( pageSize != PageSize )
+	{
+		printf( "VirtualTexture::Open: '%s' has pages of %i, they have to be %i, convert it again\n", pagePath, pageSize, PageSize );
+		return false;
+	}
+
+	GLint maxTextureSize = 0;
+	glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxTextureSize );
+	if ( pagesX > maxTextureSize || pagesY > maxTextureSize )
+	{
+		printf( "VirtualTexture::Open: %ix%i pages is too many for even the page table\n", pagesX, pagesY );
+		return false;
+	}
+
+	const size_t numPages = size_t( pagesX ) * pagesY;
+	std::vector<uint8_t> averages( numPages );
+	file.seekg( std::streamoff( HeaderSize ) + std::streamoff( numPages * PageBytes ) );
+	if ( !file.read( reinterpret_cast<char*>( averages.data() ), std::streamsize( averages.size() ) ) )
+	{
+		std::cout << "VirtualTexture::Open: '" << pagePath << "' is cut short" << std::endl;
+		return false;
+	}
+
+	// Nothing's in the cache to start with, everything is its average
+	pageTable.assign( numPages * 4, 0 );
+	for ( size_t i = 0; i < numPages; i++ )
+	{
+		pageTable[i * 4 + 3] = averages[i];
+	}
+	pageRequested.assign( numPages, 0 );
+	slots.assign( CacheSlots * CacheSlots, Slot() );
+	pageBuffer.resize( PageBytes );
+
+	glGenTextures( 1, &cacheHandle );
+	glBindTexture( GL_TEXTURE_2D, cacheHandle );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_R8, CacheSlots * PageSize, CacheSlots * PageSize, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+
+	glGenTextures( 1, &pageTableHandle );
+	glBindTexture( GL_TEXTURE_2D, pageTableHandle );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, pagesX, pagesY, 0, GL_RGBA, GL_UNSIGNED_BYTE, pageTable.data() );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+
+	glGenTextures( 1, &paletteHandle );
+	glBindTexture( GL_TEXTURE_2D, paletteHandle );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB8, 256, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, palette.data() );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+
+	// Two bytes of page x and two of page y per pixel
+	feedbackWidth = (screenWidth + FeedbackScale - 1) / FeedbackScale;
+	feedbackHeight = (screenHeight + FeedbackScale - 1) / FeedbackScale;
+	glGenTextures( 1, &feedbackTextureHandle );
+	glBindTexture( GL_TEXTURE_2D, feedbackTextureHandle );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, feedbackWidth, feedbackHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv( GL_FRAMEBUFFER_BINDING, &previousFramebuffer );
+	glGenFramebuffers( 1, &feedbackFramebufferHandle );
+	glBindFramebuffer( GL_FRAMEBUFFER, feedbackFramebufferHandle );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedbackTextureHandle, 0 );
+	const bool complete = glCheckFramebufferStatus( GL_FRAMEBUFFER ) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer( GL_FRAMEBUFFER, GLuint( previousFramebuffer ) );
+
+	for ( PendingReadback& readback : readbacks )
+	{
+		glGenBuffers( 1, &readback.bufferHandle );
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.bufferHandle );
+		glBufferData( GL_PIXEL_PACK_BUFFER, GLsizeiptr( size_t( feedbackWidth ) * feedbackHeight * 4U ), nullptr, GL_STREAM_READ );
+		readback.fence = nullptr;
+	}
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	if ( !complete || glGetError() != GL_NO_ERROR )
+	{
+		std::cout << "VirtualTexture::Open: couldn't create the textures" << std::endl;
+		return false;
+	}
+
+	printf( "VirtualTexture::Open: %ux%u in %ix%i pages, %i KB on the GPU for %.1f MB of texture\n",
+		width, height, pagesX, pagesY, int( GetResidentBytes() / 1024 ), double( numPages * PageBytes ) / (1024.0 * 1024.0) );
+	return true;
+}
+
+void VirtualTexture::Destroy()
+{
+	// Never opened, so there might not even be a context
+	if ( path.empty() )
+	{
+		return;
+	}
+
+	printf( "VirtualTexture: streamed in %i pages, evicted %i, %i of %i resident at the end, %i feedback frame(s) dropped\n",
+		numUploads, numEvictions, numResident, GetNumPages(), numDroppedFeedbacks );
+
+	for ( PendingReadback& readback : readbacks )
+	{
+		if ( readback.fence != nullptr )
+		{
+			glDeleteSync( readback.fence );
+			readback.fence = nullptr;
+		}
+
+		glDeleteBuffers( 1, &readback.bufferHandle );
+		readback.bufferHandle = 0;
+	}
+	readbacksInFlight = 0;
+
+	glDeleteFramebuffers( 1, &feedbackFramebufferHandle );
+	glDeleteTextures( 1, &feedbackTextureHandle );
+	glDeleteTextures( 1, &paletteHandle );
+	glDeleteTextures( 1, &pageTableHandle );
+	glDeleteTextures( 1, &cacheHandle );
+	feedbackFramebufferHandle = 0;
+	feedbackTextureHandle = 0;
+	paletteHandle = 0;
+	pageTableHandle = 0;
+	cacheHandle = 0;
+
+	file.close();
+}
+
+void VirtualTexture::BeginFeedback()
+{
+	glGetIntegerv( GL_DRAW_FRAMEBUFFER_BINDING, &savedDrawFramebuffer );
+	glGetIntegerv( GL_READ_FRAMEBUFFER_BINDING, &savedReadFramebuffer );
+	glGetIntegerv( GL_VIEWPORT, savedViewport );
+
+	glBindFramebuffer( GL_FRAMEBUFFER, feedbackFramebufferHandle );
+	glViewport( 0, 0, feedbackWidth, feedbackHeight );
+
+	// All ones is page 65535, 65535, which CollectPages skips
+	glClearColor( 1.0f, 1.0f, 1.0f, 1.0f );
+	glClear( GL_COLOR_BUFFER_BIT );
+}
+
+void VirtualTexture::EndFeedback()
+{
+	// Rather than wait for the GPU, this frame's feedback just doesn't happen
+	if ( readbacksInFlight == RingSize )
+	{
+		numDroppedFeedbacks++;
+	}
+	else
+	{
+		PendingReadback& readback = readbacks[(readbackHead + readbacksInFlight) % RingSize];
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.bufferHandle );
+		glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+		glReadPixels( 0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+		readback.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+		readbacksInFlight++;
+	}
+
+	glBindFramebuffer( GL_DRAW_FRAMEBUFFER, GLuint( savedDrawFramebuffer ) );
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, GLuint( savedReadFramebuffer ) );
+	glViewport( savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3] );
+}
+
+void VirtualTexture::Update()
+{
+	TRACE_SCOPE( "VirtualTexture::Update" );
+
+	frame++;
+
+	int missing[MaxUploadsPerFrame];
+	int numMissingListed = 0;
+	bool collected = false;
+	while ( readbacksInFlight > 0 )
+	{
+		PendingReadback& readback = readbacks[readbackHead];
+		const GLenum status = glClientWaitSync( readback.fence, 0, 0 );
+		if ( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED )
+		{
+			break;
+		}
+
+		glDeleteSync( readback.fence );
+		readback.fence = nullptr;
+
+		// Whatever was missing before gets counted again if it still is
+		if ( !collected )
+		{
+			numMissing = 0;
+			collected = true;
+		}
+
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.bufferHandle );
+		const void* pixels = glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0,
+			GLsizeiptr( size_t( feedbackWidth ) * feedbackHeight * 4U ), GL_MAP_READ_BIT );
+		if ( pixels != nullptr )
+		{
+			CollectPages( static_cast<const uint8_t*>( pixels ), missing, numMissingListed );
+			glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+		}
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+		readbackHead = (readbackHead + 1) % RingSize;
+		readbacksInFlight--;
+	}
+
+	for ( int i = 0; i < numMissingListed && !readFailed; i++ )
+	{
+		// Everything in the cache is on screen, so the rest stay their average colour
+		const int slot = FindSlot();
+		if ( slot < 0 || !LoadPage( missing[i], slot ) )
+		{
+			break;
+		}
+
+		numMissing--;
+	}
+}
+
+void VirtualTexture::CollectPages( const uint8_t* pixels, int* missing, int& numMissingListed )
+{
+	const size_t numPixels = size_t( feedbackWidth ) * feedbackHeight;
+	for ( size_t i = 0; i < numPixels; i++ )
+	{
+		const uint8_t* pixel = pixels + i * 4;
+		const int pageX = pixel[0] | (pixel[1] << 8);
+		const int pageY = pixel[2] | (pixel[3] << 8);
+		// Nothing was drawn there
+		if ( pageX >= pagesX || pageY >= pagesY )
+		{
+			continue;
+		}
+
+		// Neighbouring pixels mostly want the same page
+		const int page = pageY * pagesX + pageX;
+		if ( pageRequested[page] == frame )
+		{
+			continue;
+		}
+		pageRequested[page] = frame;
+
+		const uint8_t* entry = &pageTable[size_t( page ) * 4];
+		if ( entry[2] != 0 )
+		{
+			slots[entry[1] * CacheSlots + entry[0]].lastUsed = frame;
+			continue;
+		}
+
+		numMissing++;
+		if ( numMissingListed < MaxUploadsPerFrame )
+		{
+			missing[numMissingListed++] = page;
+		}
+	}
+}
+
+int VirtualTexture::FindSlot() const
+{
+	int oldest = -1;
+	for ( int i = 0; i < int( slots.size() ); i++ )
+	{
+		const Slot& slot = slots[i];
+		if ( slot.page < 0 )
+		{
+			return i;
+		}
+
+		if ( slot.lastUsed + KeepFrames <= frame && (oldest < 0 || slot.lastUsed < slots[oldest].lastUsed) )
+		{
+			oldest = i;
+		}
+	}
+
+	return oldest;
+}
+
+bool VirtualTexture::LoadPage( const int& page, const int& slot )
+{
+	TRACE_SCOPE( "VirtualTexture::LoadPage" );
+
+	file.seekg( std::streamoff( HeaderSize ) + std::streamoff( page ) * std::streamoff( PageBytes ) );
+	if ( !file.read( reinterpret_cast<char*>( pageBuffer.data() ), std::streamsize( pageBuffer.size() ) ) )
+	{
+		std::cout << "VirtualTexture::LoadPage: could not read page " << page << " of '" << path
+			<< "', nothing more gets streamed in" << std::endl;
+		readFailed = true;
+		return false;
+	}
+
+	Slot& target = slots[slot];
+	if ( target.page >= 0 )
+	{
+		pageTable[size_t( target.page ) * 4 + 2] = 0;
+		UploadPageTableEntry( target.page );
+		numResident--;
+		numEvictions++;
+	}
+
+	const int slotX = slot % CacheSlots;
+	const int slotY = slot / CacheSlots;
+	glBindTexture( GL_TEXTURE_2D, cacheHandle );
+	glTexSubImage2D( GL_TEXTURE_2D, 0, slotX * PageSize, slotY * PageSize, PageSize, PageSize,
+		GL_RED, GL_UNSIGNED_BYTE, pageBuffer.data() );
+
+	uint8_t* entry = &pageTable[size_t( page ) * 4];
+	entry[0] = uint8_t( slotX );
+	entry[1] = uint8_t( slotY );
+	entry[2] = 255;
+	UploadPageTableEntry( page );
+
+	target.page = page;
+	target.lastUsed = frame;
+	numResident++;
+	numUploads++;
+	return true;
+}
+
+void VirtualTexture::UploadPageTableEntry( const int& page )
+{
+	glBindTexture( GL_TEXTURE_2D, pageTableHandle );
+	glTexSubImage2D( GL_TEXTURE_2D, 0, page % pagesX, page / pagesX, 1, 1,
+		GL_RGBA, GL_UNSIGNED_BYTE, &pageTable[size_t( page ) * 4] );
+}
+
+void VirtualTexture::Bind( const GLenum& cacheUnit, const GLenum& paletteUnit, const GLenum& pageTableUnit ) const
+{
+	glActiveTexture( cacheUnit );
+	glBindTexture( GL_TEXTURE_2D, cacheHandle );
+	glActiveTexture( paletteUnit );
+	glBindTexture( GL_TEXTURE_2D, paletteHandle );
+	glActiveTexture( pageTableUnit );
+	glBindTexture( GL_TEXTURE_2D, pageTableHandle );
+}
+
+size_t VirtualTexture::GetResidentBytes() const
+{
+	const size_t cacheBytes = size_t( CacheSlots ) * CacheSlots * PageBytes;
+	const size_t pageTableBytes = size_t( pagesX ) * pagesY * 4U;
+	const size_t feedbackBytes = size_t( feedbackWidth ) * feedbackHeight * 4U * (RingSize + 1);
+	return cacheBytes + pageTableBytes + feedbackBytes + 256 * 3;
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
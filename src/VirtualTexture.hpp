@@ -0,0 +1,195 @@
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include "TextureProvider.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// An indexed texture too big to load in one go, or to fit in a GL texture at all,
+// drawn from fixed-size pages that get streamed in from disk as they're needed
+//
+// Convert chops an 8-bit BMP into PageSize by PageSize pages in a page file, a row of pages
+// at a time, so not even that needs the whole image in memory. When drawing, only
+// CacheSlots by CacheSlots pages are on the GPU, all in one physical cache texture, and a
+// page table texture with a texel per page says where in the cache each one is. Pages that
+// aren't in yet are drawn as their average colour until they are
+//
+// Which pages are needed comes from the GPU: a feedback pass draws the page each pixel reads
+// at 1/FeedbackScale of the resolution, and that's read back through pixel pack buffers a
+// frame or two later, like FrameCapture does. Update streams in what's missing, and throws
+// out the pages that haven't been asked for in the longest time to make room
+class VirtualTexture final
+{
+public:
+    static constexpr int PageSize = 128;
+    // The cache is 2048x2048 texels, 4 MB whatever the size of the texture
+    static constexpr int CacheSlots = 16;
+    // The feedback pass is this many times smaller than the screen each way
+    static constexpr int FeedbackScale = 8;
+    // Feedback readbacks in flight
+    static constexpr int RingSize = 3;
+    // Streaming stops for the frame after this many pages, 256 KB
+    static constexpr int MaxUploadsPerFrame = 16;
+    // Pages asked for this many frames ago or less stay, the feedback only has
+    // one of a pixel's three samples per frame, so a page can skip a frame or two
+    static constexpr uint32_t KeepFrames = 3;
+
+    // Writes the page file, no GL needed
+    static bool Convert( const char* bmpPath, const char* pagePath );
+
+    // Reads the page file's header and creates the textures, for a screen of screenWidth by screenHeight
+    bool Open( const char* path, const int& screenWidth, const int& screenHeight );
+    void Destroy();
+
+    // Everything drawn in between goes into the feedback framebuffer, at the feedback size,
+    // and EndFeedback starts reading it back and puts the old framebuffer and viewport back
+    void BeginFeedback();
+    void EndFeedback();
+
+    // Once per frame, before drawing: goes through whichever readbacks have landed, and streams
+    // in the pages they asked for. Never waits for the GPU, a readback that isn't done is left for later
+    void Update();
+
+    void Bind( const GLenum& cacheUnit, const GLenum& paletteUnit, const GLenum& pageTableUnit ) const;
+
+    uint32_t GetWidth() const
+    {
+        return width;
+    }
+
+    uint32_t GetHeight() const
+    {
+        return height;
+    }
+
+    int GetNumPages() const
+    {
+        return pagesX * pagesY;
+    }
+
+    int GetNumResidentPages() const
+    {
+        return numResident;
+    }
+
+    // Pages the last feedback asked for that weren't in the cache
+    int GetNumMissingPages() const
+    {
+        return numMissing;
+    }
+
+    int GetNumUploads() const
+    {
+        return numUploads;
+    }
+
+    int GetNumEvictions() const
+    {
+        return numEvictions;
+    }
+
+    // Feedback frames that were skipped since the GPU was still busy with all the older ones
+    int GetNumDroppedFeedbacks() const
+    {
+        return numDroppedFeedbacks;
+    }
+
+    // Missing pages, or feedback that hasn't been looked at yet
+    bool HasPendingUploads() const
+    {
+        return numMissing > 0 || readbacksInFlight > 0;
+    }
+
+    // Cache, page table and feedback, what's on the GPU
+    size_t GetResidentBytes() const;
+
+private:
+    struct Slot
+    {
+        // -1 while it's free
+        int page{ -1 };
+        uint32_t lastUsed{ 0 };
+    };
+
+    struct PendingReadback
+    {
+        GLuint bufferHandle{ 0 };
+        GLsync fence{ nullptr };
+    };
+
+    // Marks the pages a readback asks for as used this frame, and notes the ones
+    // that aren't in the cache, up to MaxUploadsPerFrame of them
+    void CollectPages( const uint8_t* pixels, int* missing, int& numMissingListed );
+    // A free slot, or the one that was used the longest ago if it's old enough, -1 if none are
+    int FindSlot() const;
+    bool LoadPage( const int& page, const int& slot );
+    void UploadPageTableEntry( const int& page );
+
+private:
+    std::string path;
+    std::ifstream file;
+    bool readFailed{ false };
+
+    uint32_t width{ 0 };
+    uint32_t height{ 0 };
+    int pagesX{ 0 };
+    int pagesY{ 0 };
+    PaletteBuffer palette{};
+
+    // RGBA per page, same as on the GPU: slot x and y, 255 if it's in the cache, and its average index
+    std::vector<uint8_t> pageTable;
+    // The last frame a feedback asked for each page
+    std::vector<uint32_t> pageRequested;
+    std::vector<Slot> slots;
+    // One page on its way from the file to the cache
+    std::vector<uint8_t> pageBuffer;
+    uint32_t frame{ 0 };
+
+    GLuint cacheHandle{ 0 };
+    GLuint pageTableHandle{ 0 };
+    GLuint paletteHandle{ 0 };
+    GLuint feedbackTextureHandle{ 0 };
+    GLuint feedbackFramebufferHandle{ 0 };
+    int feedbackWidth{ 0 };
+    int feedbackHeight{ 0 };
+
+    PendingReadback readbacks[RingSize];
+    int readbackHead{ 0 };
+    int readbacksInFlight{ 0 };
+
+    // What BeginFeedback replaced, for EndFeedback to put back
+    GLint savedDrawFramebuffer{ 0 };
+    GLint savedReadFramebuffer{ 0 };
+    GLint savedViewport[4]{};
+
+    int numResident{ 0 };
+    int numMissing{ 0 };
+    int numUploads{ 0 };
+    int numEvictions{ 0 };
+    int numDroppedFeedbacks{ 0 };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
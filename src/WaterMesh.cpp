@@ -0,0 +1,372 @@
+
+#include "WaterMesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace
+{
+	// GLQuake won't cut off pieces thinner than this, they'd just be slivers
+	constexpr float MinPieceSize = 8.0f;
+
+	void SetAxis( Vec3& v, const int& axis, const float& value )
+	{
+		(axis == 0 ? v.x : (axis == 1 ? v.y : v.z)) = value;
+	}
+
+	void FanPolygon( const std::vector<Vec3>& polygon, std::vector<Vec3>& outTriangles )
+	{
+		for ( size_t i = 2; i < polygon.size(); i++ )
+		{
+			outTriangles.push_back( polygon[0] );
+			outTriangles.push_back( polygon[i - 1] );
+			outTriangles.push_back( polygon[i] );
+		}
+	}
+
+	void SubdividePolygon( const std::vector<Vec3>& polygon, const float& subdivideSize, std::vector<Vec3>& outTriangles )
+	{
+		Aabb bounds;
+		for ( const Vec3& v : polygon )
+		{
+			bounds.Add( Aabb( v, v ) );
+		}
+
+		for ( int axis = 0; axis < 3; axis++ )
+		{
+			// Cut on the grid line closest to the middle
+			const float middle = (bounds.mins[axis] + bounds.maxs[axis]) * 0.5f;
+			const float cut = subdivideSize * std::floor( middle / subdivideSize + 0.5f );
+			if ( bounds.maxs[axis] - cut < MinPieceSize || cut - bounds.mins[axis] < MinPieceSize )
+			{
+				continue;
+			}
+
+			std::vector<Vec3> front;
+			std::vector<Vec3> back;
+			const size_t numVertices = polygon.size();
+			for ( size_t i = 0; i < numVertices; i++ )
+			{
+				const Vec3& v = polygon[i];
+				const Vec3& next = polygon[(i + 1) % numVertices];
+				const float distance = v[axis] - cut;
+				const float nextDistance = next[axis] - cut;
+
+				if ( distance >= 0.0f )
+				{
+					front.push_back( v );
+				}
+				if ( distance <= 0.0f )
+				{
+					back.push_back( v );
+				}
+
+				if ( distance == 0.0f || nextDistance == 0.0f || (distance > 0.0f) == (nextDistance > 0.0f) )
+				{
+					continue;
+				}
+
+				// The edge crosses the cut, both halves get the crossing point
+				// It's snapped onto the cut exactly, so neighbouring pieces end up with identical vertices
+				Vec3 middlePoint = v + (next - v) * (distance / (distance - nextDistance));
+				SetAxis( middlePoint, axis, cut );
+				front.push_back( middlePoint );
+				back.push_back( middlePoint );
+			}
+
+			SubdividePolygon( front, subdivideSize, outTriangles );
+			SubdividePolygon( back, subdivideSize, outTriangles );
+			return;
+		}
+
+		// Small enough, fan it out
+		FanPolygon( polygon, outTriangles );
+	}
+
+	struct WeldKey
+	{
+		int64_t x;
+		int64_t y;
+		int64_t z;
+
+		bool operator==( const WeldKey& other ) const
+		{
+			return x == other.x && y == other.y && z == other.z;
+		}
+	};
+
+	struct WeldKeyHash
+	{
+		size_t operator()( const WeldKey& key ) const
+		{
+			uint64_t hash = uint64_t( key.x ) * 0x9E3779B97F4A7C15ull;
+			hash ^= uint64_t( key.y ) * 0xC2B2AE3D27D4EB4Full + (hash << 6) + (hash >> 2);
+			hash ^= uint64_t( key.z ) * 0x165667B19E3779F9ull + (hash << 6) + (hash >> 2);
+			return size_t( hash );
+		}
+	};
+
+	// Forsyth's tuning, straight from the article
+	constexpr int CacheSize = 32;
+	constexpr float CacheDecayPower = 1.5f;
+	constexpr float LastTriangleScore = 0.75f;
+	constexpr float ValenceBoostScale = 2.0f;
+	constexpr float ValenceBoostPower = 0.5f;
+
+	float ScoreVertex( const int& cachePosition, const int& remainingTriangles )
+	{
+		if ( remainingTriangles == 0 )
+		{
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if ( cachePosition >= 0 )
+		{
+			// The triangle that was just drawn gets a fixed score, so the next one doesn't
+			// prefer any particular edge of it. Further back in the cache, the score drops off
+			if ( cachePosition < 3 )
+			{
+				score = LastTriangleScore;
+			}
+			else
+			{
+				const float scaler = 1.0f / float( CacheSize - 3 );
+				score = std::pow( 1.0f - float( cachePosition - 3 ) * scaler, CacheDecayPower );
+			}
+		}
+
+		// Vertices with few triangles left get a boost, so they get finished off instead of left lonely
+		score += ValenceBoostScale * std::pow( float( remainingTriangles ), -ValenceBoostPower );
+		return score;
+	}
+}
+
+void WaterMesh::Subdivide( const std::vector<Vec3>& polygon, const float& subdivideSize, std::vector<Vec3>& outTriangles )
+{
+	if ( polygon.size() < 3 )
+	{
+		return;
+	}
+
+	if ( subdivideSize <= 0.0f )
+	{
+		FanPolygon( polygon, outTriangles );
+		return;
+	}
+
+	SubdividePolygon( polygon, subdivideSize, outTriangles );
+}
+
+void WaterMesh::Weld( const std::vector<Vec3>& triangles, std::vector<Vec3>& outVertices, std::vector<uint32_t>& outIndices )
+{
+	std::unordered_map<WeldKey, uint32_t, WeldKeyHash> vertexMap;
+	vertexMap.reserve( triangles.size() );
+
+	for ( const Vec3& v : triangles )
+	{
+		const WeldKey key{ std::llround( v.x * 64.0f ), std::llround( v.y * 64.0f ), std::llround( v.z * 64.0f ) };
+		const auto result = vertexMap.emplace( key, uint32_t( outVertices.size() ) );
+		if ( result.second )
+		{
+			outVertices.push_back( v );
+		}
+		outIndices.push_back( result.first->second );
+	}
+}
+
+void WaterMesh::OptimiseVertexCache( std::vector<uint32_t>& indices, const size_t& numVertices )
+{
+	const size_t numTriangles = indices.size() / 3;
+	if ( numTriangles == 0 )
+	{
+		return;
+	}
+
+	// Which triangles use each vertex, packed into one array
+	// The first remainingTriangles[v] of a vertex's slice are the ones not drawn yet
+	std::vector<int> remainingTriangles( numVertices, 0 );
+	for ( const uint32_t& index : indices )
+	{
+		remainingTriangles[index]++;
+	}
+
+	std::vector<int> triangleListStart( numVertices + 1, 0 );
+	for ( size_t v = 0; v < numVertices; v++ )
+	{
+		triangleListStart[v + 1] = triangleListStart[v] + remainingTriangles[v];
+	}
+
+	std::vector<int> triangleLists( indices.size() );
+	std::vector<int> fill( triangleListStart.begin(), triangleListStart.end() - 1 );
+	for ( size_t i = 0; i < indices.size(); i++ )
+	{
+		triangleLists[fill[indices[i]]++] = int( i / 3 );
+	}
+
+	std::vector<int> cachePosition( numVertices, -1 );
+	std::vector<float> vertexScore( numVertices );
+	for ( size_t v = 0; v < numVertices; v++ )
+	{
+		vertexScore[v] = ScoreVertex( -1, remainingTriangles[v] );
+	}
+
+	std::vector<float> triangleScore( numTriangles );
+	std::vector<bool> triangleDrawn( numTriangles, false );
+	int bestTriangle = 0;
+	for ( size_t t = 0; t < numTriangles; t++ )
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		if ( triangleScore[t] > triangleScore[bestTriangle] )
+		{
+			bestTriangle = int( t );
+		}
+	}
+
+	// The cache briefly holds 3 more than it can, so the ones that fall out get rescored too
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve( CacheSize + 3 );
+	newCache.reserve( CacheSize + 3 );
+
+	std::vector<uint32_t> outIndices;
+	outIndices.reserve( indices.size() );
+	size_t nextUndrawn = 0;
+
+	for ( size_t drawn = 0; drawn < numTriangles; drawn++ )
+	{
+		// Dead end, nothing in the cache has anything left, so start somewhere new
+		if ( bestTriangle < 0 )
+		{
+			while ( triangleDrawn[nextUndrawn] )
+			{
+				nextUndrawn++;
+			}
+			bestTriangle = int( nextUndrawn );
+		}
+
+		const uint32_t* triangle = &indices[bestTriangle * 3];
+		triangleDrawn[bestTriangle] = true;
+		newCache.clear();
+
+		for ( int corner = 0; corner < 3; corner++ )
+		{
+			const uint32_t v = triangle[corner];
+			outIndices.push_back( v );
+			newCache.push_back( v );
+
+			// Take the triangle out of this vertex's remaining list
+			int* list = &triangleLists[triangleListStart[v]];
+			int& remaining = remainingTriangles[v];
+			for ( int i = 0; i < remaining; i++ )
+			{
+				if ( list[i] == bestTriangle )
+				{
+					std::swap( list[i], list[remaining - 1] );
+					remaining--;
+					break;
+				}
+			}
+		}
+
+		for ( const uint32_t& v : cache )
+		{
+			if ( v != triangle[0] && v != triangle[1] && v != triangle[2] )
+			{
+				newCache.push_back( v );
+			}
+		}
+
+		for ( size_t i = 0; i < newCache.size(); i++ )
+		{
+			const uint32_t v = newCache[i];
+			cachePosition[v] = int( i ) < CacheSize ? int( i ) : -1;
+			vertexScore[v] = ScoreVertex( cachePosition[v], remainingTriangles[v] );
+		}
+
+		// Only triangles touching the cache changed, so only they can be the next best
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for ( const uint32_t& v : newCache )
+		{
+			const int* list = &triangleLists[triangleListStart[v]];
+			for ( int i = 0; i < remainingTriangles[v]; i++ )
+			{
+				const int t = list[i];
+				triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				if ( triangleScore[t] > bestScore )
+				{
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		newCache.resize( std::min( newCache.size(), size_t( CacheSize ) ) );
+		std::swap( cache, newCache );
+	}
+
+	indices.swap( outIndices );
+}
+
+void WaterMesh::OptimiseVertexFetch( std::vector<Vec3>& vertices, std::vector<uint32_t>& indices )
+{
+	constexpr uint32_t Unused = ~0u;
+	std::vector<uint32_t> remap( vertices.size(), Unused );
+	std::vector<Vec3> newVertices;
+	newVertices.reserve( vertices.size() );
+
+	for ( uint32_t& index : indices )
+	{
+		if ( remap[index] == Unused )
+		{
+			remap[index] = uint32_t( newVertices.size() );
+			newVertices.push_back( vertices[index] );
+		}
+		index = remap[index];
+	}
+
+	vertices.swap( newVertices );
+}
+
+float WaterMesh::GetAverageCacheMissRatio( const std::vector<uint32_t>& indices, const size_t& numVertices, const int& cacheSize )
+{
+	if ( indices.size() < 3 )
+	{
+		return 0.0f;
+	}
+
+	// A FIFO cache only needs to remember when each vertex went in
+	std::vector<int64_t> insertedAt( numVertices, INT64_MIN / 2 );
+	int64_t misses = 0;
+	for ( const uint32_t& index : indices )
+	{
+		if ( misses - insertedAt[index] >= cacheSize )
+		{
+			insertedAt[index] = misses;
+			misses++;
+		}
+	}
+
+	return float( misses ) / float( indices.size() / 3 );
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,55 @@
+
+#pragma once
+
+#include "Math.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Turns convex water faces into meshes the way GLQuake and GoldSrc's GL renderer do:
+// chop them up along a grid so the texture coordinates can be warped per vertex
+//
+// Polygons go in one at a time and come out welded, with the triangles reordered so
+// the GPU's post-transform cache gets reused, and the vertices in the order they're used
+class WaterMesh final
+{
+public:
+    // Splits a convex polygon along axis-aligned planes every subdivideSize units,
+    // GLQuake's SubdividePolygon, and appends the pieces as a triangle list
+    // A subdivideSize of 0 means don't split, the polygon just gets fanned
+    static void Subdivide( const std::vector<Vec3>& polygon, const float& subdivideSize, std::vector<Vec3>& outTriangles );
+
+    // Merges vertices that are within 1/64 of a unit of each other
+    static void Weld( const std::vector<Vec3>& triangles, std::vector<Vec3>& outVertices, std::vector<uint32_t>& outIndices );
+
+    // Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+    // Reorders triangles so recently used vertices get used again while they're still cached
+    static void OptimiseVertexCache( std::vector<uint32_t>& indices, const size_t& numVertices );
+
+    // Renumbers vertices in the order the triangles first use them, so fetching them walks memory forwards
+    static void OptimiseVertexFetch( std::vector<Vec3>& vertices, std::vector<uint32_t>& indices );
+
+    // Average cache miss ratio, i.e. transformed vertices per triangle, with a FIFO cache like most GPUs have
+    // 0.5 is the best a regular grid can do, 3 means nothing is ever reused
+    static float GetAverageCacheMissRatio( const std::vector<uint32_t>& indices, const size_t& numVertices, const int& cacheSize = 16 );
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
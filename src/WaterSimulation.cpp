@@ -0,0 +1,225 @@
+
+#include "WaterSimulation.hpp"
+#include "Trace.hpp"
+
+#include <chrono>
+#include <utility>
+
+constexpr int WaterSimulation::NumFrames;
+
+void WaterSimulation::Start( const Texture& simulationTexture, const int& frameWidth, const int& frameHeight, std::function<void()> onFrameReady )
+{
+	Stop();
+
+	texture = &simulationTexture;
+	width = frameWidth;
+	height = frameHeight;
+	frameReady = std::move( onFrameReady );
+
+	// All the allocating happens here, after this the frames just get passed around
+	for ( int i = 0; i < NumFrames; i++ )
+	{
+		SimulationFrame frame;
+		frame.indices.resize( size_t( width ) * height );
+		freeFrames.Push( frame );
+	}
+
+	hasFrame = false;
+	postedAny = false;
+	wakeUpPending = false;
+	stopThread.store( false, std::memory_order_relaxed );
+	thread = std::thread( &WaterSimulation::ThreadMain, this );
+}
+
+void WaterSimulation::Stop()
+{
+	if ( !thread.joinable() )
+	{
+		return;
+	}
+
+	stopThread.store( true, std::memory_order_release );
+	WakeUp();
+	thread.join();
+
+	// The thread's gone, so this side can empty both rings for the next Start
+	SimulationFrame frame;
+	while ( readyFrames.Pop( frame ) )
+	{
+	}
+	while ( freeFrames.Pop( frame ) )
+	{
+	}
+
+	currentFrame = SimulationFrame();
+	hasFrame = false;
+}
+
+void WaterSimulation::SetParameters( const WaterParameters& parameters )
+{
+	parameterBlock.Write( parameters );
+
+	// Most frames land between two ripple steps, no need to bother the thread for those
+	if ( !postedAny || !ShowSameFrame( parameters, postedParameters ) )
+	{
+		postedParameters = parameters;
+		postedAny = true;
+		WakeUp();
+	}
+}
+
+bool WaterSimulation::Update()
+{
+	bool newFrame = false;
+	bool returnedFrame = false;
+
+	SimulationFrame frame;
+	while ( readyFrames.Pop( frame ) )
+	{
+		// Something newer came in before this one got shown
+		if ( newFrame )
+		{
+			framesDropped++;
+		}
+
+		if ( hasFrame )
+		{
+			freeFrames.Push( currentFrame );
+			returnedFrame = true;
+		}
+
+		currentFrame = std::move( frame );
+		hasFrame = true;
+		newFrame = true;
+	}
+
+	// The thread might've been waiting for a buffer to simulate into
+	if ( returnedFrame )
+	{
+		WakeUp();
+	}
+
+	return newFrame;
+}
+
+void WaterSimulation::WakeUp()
+{
+	{
+		std::lock_guard<std::mutex> lock( wakeUpMutex );
+		wakeUpPending = true;
+	}
+	wakeUpCondition.notify_one();
+}
+
+bool WaterSimulation::ShowSameFrame( const WaterParameters& a, const WaterParameters& b )
+{
+	// Between ripple steps, nothing moves
+	return int( a.time * a.rippleRate ) == int( b.time * b.rippleRate )
+		&& a.upperIndex == b.upperIndex
+		&& a.lowerIndex == b.lowerIndex
+		&& a.fixFogIndex == b.fixFogIndex;
+}
+
+void WaterSimulation::ParameterBlock::Write( const WaterParameters& parameters )
+{
+	const uint32_t start = sequence.load( std::memory_order_relaxed );
+	sequence.store( start + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+
+	time.store( parameters.time, std::memory_order_relaxed );
+	rippleRate.store( parameters.rippleRate, std::memory_order_relaxed );
+	upperIndex.store( parameters.upperIndex, std::memory_order_relaxed );
+	lowerIndex.store( parameters.lowerIndex, std::memory_order_relaxed );
+	fixFogIndex.store( parameters.fixFogIndex, std::memory_order_relaxed );
+
+	sequence.store( start + 2, std::memory_order_release );
+}
+
+WaterParameters WaterSimulation::ParameterBlock::Read() const
+{
+	WaterParameters parameters;
+	while ( true )
+	{
+		const uint32_t before = sequence.load( std::memory_order_acquire );
+		parameters.time = time.load( std::memory_order_relaxed );
+		parameters.rippleRate = rippleRate.load( std::memory_order_relaxed );
+		parameters.upperIndex = upperIndex.load( std::memory_order_relaxed );
+		parameters.lowerIndex = lowerIndex.load( std::memory_order_relaxed );
+		parameters.fixFogIndex = fixFogIndex.load( std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_acquire );
+
+		if ( (before & 1) == 0 && sequence.load( std::memory_order_relaxed ) == before )
+		{
+			return parameters;
+		}
+	}
+}
+
+void WaterSimulation::ThreadMain()
+{
+	TRACE_THREAD_NAME( "Simulation" );
+
+	WaterParameters lastParameters;
+	bool simulatedAny = false;
+	while ( !stopThread.load( std::memory_order_acquire ) )
+	{
+		const WaterParameters parameters = parameterBlock.Read();
+
+		// Same picture as last time, or the render thread still has every buffer,
+		// either way there's nothing to do until SetParameters or Update says otherwise
+		// Anything that happened since the last look left wakeUpPending set, so nothing's missed
+		SimulationFrame frame;
+		if ( (simulatedAny && ShowSameFrame( parameters, lastParameters )) || !freeFrames.Pop( frame ) )
+		{
+			std::unique_lock<std::mutex> lock( wakeUpMutex );
+			wakeUpCondition.wait( lock, [this]()
+			{
+				return wakeUpPending || stopThread.load( std::memory_order_acquire );
+			} );
+			wakeUpPending = false;
+			continue;
+		}
+
+		{
+			TRACE_SCOPE( "SimulationStep" );
+			const auto start = std::chrono::steady_clock::now();
+
+			SoftwareWater::RenderIndices( *texture, parameters, width, height, frame.indices.data() );
+
+			const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			stepMilliseconds.store( elapsed.count(), std::memory_order_relaxed );
+		}
+
+		frame.parameters = parameters;
+		// There are fewer frames than slots, so this always fits
+		readyFrames.Push( frame );
+		framesSimulated.fetch_add( 1, std::memory_order_relaxed );
+
+		lastParameters = parameters;
+		simulatedAny = true;
+
+		if ( frameReady )
+		{
+			frameReady();
+		}
+	}
+}
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,152 @@
+
+#pragma once
+
+#include "SoftwareWater.hpp"
+#include "SpscRing.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One step's worth of output, palette indices for the whole screen
+struct SimulationFrame
+{
+    WaterParameters parameters;
+    // Rows bottom to top, like SoftwareWater writes them
+    std::vector<uint8_t> indices;
+};
+
+// Runs SoftwareWater on a thread of its own, so a slow step never holds up presenting
+//
+// The render thread posts what it wants to see through an atomic parameter block, and
+// the simulation steps whenever that would give a different picture, i.e. when the
+// ripples move or the thresholds change. Finished frames go to the render thread through
+// a lock-free ring, and the render thread shows the newest one it's got and hands the
+// rest back through another ring, so the buffers just go round and round
+// With nothing to do, the thread sleeps until new parameters or a returned buffer wake it
+class WaterSimulation final
+{
+public:
+    // Frame buffers in circulation: one being shown, one being simulated, one spare
+    static constexpr int NumFrames = 3;
+
+    // onFrameReady gets called on the simulation thread after every step, keep it short
+    // The texture has to stay around until Stop
+    void Start( const Texture& texture, const int& width, const int& height, std::function<void()> onFrameReady = nullptr );
+    void Stop();
+
+    bool IsRunning() const
+    {
+        return thread.joinable();
+    }
+
+    // Render thread: what the simulation should be working on
+    void SetParameters( const WaterParameters& parameters );
+
+    // Render thread: takes the newest finished frame, if there's been one since the last call
+    bool Update();
+
+    // The frame Update last took, only valid once one's come in
+    const SimulationFrame& GetFrame() const
+    {
+        return currentFrame;
+    }
+
+    bool HasFrame() const
+    {
+        return hasFrame;
+    }
+
+    // Whether two sets of parameters give exactly the same picture
+    static bool ShowSameFrame( const WaterParameters& a, const WaterParameters& b );
+
+    int GetNumFramesSimulated() const
+    {
+        return framesSimulated.load( std::memory_order_relaxed );
+    }
+
+    // Frames that were already out of date by the time the render thread got to them
+    int GetNumFramesDropped() const
+    {
+        return framesDropped;
+    }
+
+    float GetStepMilliseconds() const
+    {
+        return stepMilliseconds.load( std::memory_order_relaxed );
+    }
+
+private:
+    // A seqlock: the writer makes the sequence odd while it's writing, and readers
+    // go again if it was odd or moved while they were reading, so they never see half an update
+    class ParameterBlock final
+    {
+    public:
+        void Write( const WaterParameters& parameters );
+        WaterParameters Read() const;
+
+    private:
+        std::atomic<uint32_t> sequence{ 0 };
+        std::atomic<float> time{ 0.0f };
+        std::atomic<float> rippleRate{ WaterParameters().rippleRate };
+        std::atomic<int> upperIndex{ 0 };
+        std::atomic<int> lowerIndex{ 0 };
+        std::atomic<bool> fixFogIndex{ false };
+    };
+
+    void ThreadMain();
+    void WakeUp();
+
+private:
+    const Texture* texture{ nullptr };
+    int width{ 0 };
+    int height{ 0 };
+    std::function<void()> frameReady;
+
+    std::thread thread;
+    std::atomic<bool> stopThread{ false };
+
+    // What the thread sleeps on, set whenever there might be something new for it
+    std::mutex wakeUpMutex;
+    std::condition_variable wakeUpCondition;
+    bool wakeUpPending{ false };
+
+    ParameterBlock parameterBlock;
+    // Simulation to render thread, and back
+    SpscRing<SimulationFrame, 4> readyFrames;
+    SpscRing<SimulationFrame, 4> freeFrames;
+
+    // Render thread only
+    SimulationFrame currentFrame;
+    // What SetParameters last woke the thread up for, so it only does when the picture changes
+    WaterParameters postedParameters;
+    bool postedAny{ false };
+    bool hasFrame{ false };
+    int framesDropped{ 0 };
+
+    std::atomic<int> framesSimulated{ 0 };
+    std::atomic<float> stepMilliseconds{ 0.0f };
+};
+
+/*
+Copyright (c) 2022 Admer456
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/